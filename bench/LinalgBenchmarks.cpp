@@ -0,0 +1,515 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Arena.h"
+#include "BatchedSolver.h"
+#include "FixedMatrix.h"
+#include "IterativeSolvers.h"
+#include "LUFactorization.h"
+#include "Matrix.h"
+#include "MatrixAnalysis.h"
+#include "MatrixIO.h"
+#include "OutOfCore.h"
+#include "ParametricSolution.h"
+#include "QRCPFactorization.h"
+#include "Simd.h"
+#include "SparseLU.h"
+#include "Strassen.h"
+
+typedef linalg::Matrix<double> Md;
+
+// every benchmark reports
+// - GFLOP/s: (approximate) floating point operations of the algorithm per second,
+// - bytes/element: minimum memory traffic (inputs read + output written) per element of the input,
+// - bytes_per_second: the same traffic as a rate.
+// run with --benchmark_out=results.json --benchmark_out_format=json and compare two runs
+// with bench/compare.py.
+
+namespace {
+
+Md random_matrix(int rows, int cols, bool diagonally_dominant=false, unsigned seed=42) {
+  std::mt19937_64 gen {seed};
+  std::uniform_real_distribution<double> dist {-1, 1};
+  Md m (rows, cols);
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      m(i, j) = dist(gen);
+    }
+    if (diagonally_dominant && i < cols) {
+      // keeps square inputs comfortably invertible
+      m(i, i) += cols;
+    }
+  }
+  return m;
+}
+
+void report(benchmark::State& state, double flops, double bytes, double elements) {
+  state.counters["GFLOP/s"] = benchmark::Counter(flops / 1e9, benchmark::Counter::kIsIterationInvariantRate);
+  state.counters["bytes/element"] = bytes / elements;
+  state.SetBytesProcessed(static_cast<int64_t>(bytes) * state.iterations());
+}
+
+// flops of eliminating the leading min(m, n) columns of an m x n matrix
+double elimination_flops(double m, double n) {
+  double k = std::min(m, n);
+  return 2 * (m * n * k - (m + n) * k * k / 2 + k * k * k / 3);
+}
+
+// flops of Householder QR of an m x n matrix (the reflectors, not Q)
+double qr_flops(double m, double n) {
+  double k = std::min(m, n);
+  return 2 * m * n * k - (m + n) * k * k + 2 * k * k * k / 3;
+}
+
+constexpr double WORD = sizeof(double);
+
+// square n x n
+void square_sizes(benchmark::internal::Benchmark* b) {
+  for (int n: {8, 32, 128, 512, 1024, 4096}) {
+    b->Args({n, n});
+  }
+}
+
+// tall and wide shapes with 8 on the short side
+void skinny_sizes(benchmark::internal::Benchmark* b) {
+  for (int n: {64, 512, 4096}) {
+    b->Args({n, 8});
+    b->Args({8, n});
+  }
+}
+
+void all_sizes(benchmark::internal::Benchmark* b) {
+  square_sizes(b);
+  skinny_sizes(b);
+}
+
+void BM_Add(benchmark::State& state) {
+  int rows = state.range(0), cols = state.range(1);
+  Md A = random_matrix(rows, cols), B = random_matrix(rows, cols, false, 7);
+  for (auto _: state) {
+    Md C = A + B;
+    benchmark::DoNotOptimize(C.data());
+  }
+  double elements = static_cast<double>(rows) * cols;
+  report(state, elements, 3 * WORD * elements, elements);
+}
+
+void BM_ScalarMultiply(benchmark::State& state) {
+  int rows = state.range(0), cols = state.range(1);
+  Md A = random_matrix(rows, cols);
+  for (auto _: state) {
+    Md C = A * 3;
+    benchmark::DoNotOptimize(C.data());
+  }
+  double elements = static_cast<double>(rows) * cols;
+  report(state, elements, 2 * WORD * elements, elements);
+}
+
+// (rows x cols) * (cols x rows): skinny shapes give both an outer and an inner product
+void BM_Multiply(benchmark::State& state) {
+  int rows = state.range(0), cols = state.range(1);
+  Md A = random_matrix(rows, cols), B = random_matrix(cols, rows, false, 7);
+  for (auto _: state) {
+    Md C = A * B;
+    benchmark::DoNotOptimize(C.data());
+  }
+  double m = rows, k = cols;
+  report(state, 2 * m * k * m, WORD * (2 * m * k + m * m), m * k);
+}
+
+// n x n product on range(1) threads of the default pool (size it with set_num_threads)
+void BM_MultiplyThreads(benchmark::State& state) {
+  int n = state.range(0), threads = state.range(1);
+  Md A = random_matrix(n, n), B = random_matrix(n, n, false, 7);
+  for (auto _: state) {
+    Md C = linalg::multiply(A, B, {.num_threads = threads});
+    benchmark::DoNotOptimize(C.data());
+  }
+  double size = n;
+  report(state, 2 * size * size * size, WORD * 3 * size * size, size * size);
+}
+
+// n x n Strassen-Winograd product with crossover range(1), compare with BM_MultiplyThreads.
+// flops are counted as for the classical product so the rates are comparable
+void BM_Strassen(benchmark::State& state) {
+  int n = state.range(0), crossover = state.range(1);
+  Md A = random_matrix(n, n), B = random_matrix(n, n, false, 7);
+  for (auto _: state) {
+    Md C = linalg::strassen_multiply(A, B, {.crossover = crossover});
+    benchmark::DoNotOptimize(C.data());
+  }
+  double size = n;
+  report(state, 2 * size * size * size, WORD * 3 * size * size, size * size);
+}
+
+// opening an n x n matrix file: 0 -> load_binary (copy and checksum), 1 -> MappedMatrix and
+// reading one element per page, 2 -> MappedMatrix and verify(). the page cache is warm after the first run
+void BM_LoadBinary(benchmark::State& state) {
+  int n = state.range(0), mode = state.range(1);
+  const std::string path = "/tmp/linalg_bench_" + std::to_string(n) + ".mat";
+  linalg::save_binary(random_matrix(n, n), path);
+  for (auto _: state) {
+    if (mode == 0) {
+      Md A = linalg::load_binary<double>(path);
+      benchmark::DoNotOptimize(A.data());
+    } else {
+      linalg::MappedMatrix<double> A (path);
+      double sum = 0;
+      if (mode == 1) {
+        for (int i = 0; i < n; i += std::max(1, 512 / n)) {
+          sum += A.view().coeff(i, 0);
+        }
+      } else {
+        sum = A.verify();
+      }
+      benchmark::DoNotOptimize(sum);
+    }
+  }
+  std::remove(path.c_str());
+  double size = n;
+  report(state, 0, WORD * size * size, size * size);
+}
+
+void BM_Transpose(benchmark::State& state) {
+  int rows = state.range(0), cols = state.range(1);
+  Md A = random_matrix(rows, cols);
+  for (auto _: state) {
+    Md T = A.transpose();
+    benchmark::DoNotOptimize(T.data());
+  }
+  double elements = static_cast<double>(rows) * cols;
+  report(state, 0, 2 * WORD * elements, elements);
+}
+
+void BM_TransposeInPlace(benchmark::State& state) {
+  int rows = state.range(0), cols = state.range(1);
+  Md A = random_matrix(rows, cols);
+  for (auto _: state) {
+    A.transpose_inplace();
+    benchmark::DoNotOptimize(A.data());
+  }
+  double elements = static_cast<double>(rows) * cols;
+  report(state, 0, 2 * WORD * elements, elements);
+}
+
+void BM_GaussianElimination(benchmark::State& state) {
+  int rows = state.range(0), cols = state.range(1);
+  Md A = random_matrix(rows, cols, true);
+  for (auto _: state) {
+    Md REF = linalg::gaussian_elimination(A);
+    benchmark::DoNotOptimize(REF.data());
+  }
+  double elements = static_cast<double>(rows) * cols;
+  report(state, elimination_flops(rows, cols), 2 * WORD * elements, elements);
+}
+
+void BM_GaussJordanElimination(benchmark::State& state) {
+  int rows = state.range(0), cols = state.range(1);
+  Md A = random_matrix(rows, cols, true);
+  for (auto _: state) {
+    Md RREF = linalg::gauss_jordan_elimination(A);
+    benchmark::DoNotOptimize(RREF.data());
+  }
+  double elements = static_cast<double>(rows) * cols;
+  // the backward pass costs about as much as the forward one
+  report(state, 2 * elimination_flops(rows, cols), 2 * WORD * elements, elements);
+}
+
+void BM_Rank(benchmark::State& state) {
+  int rows = state.range(0), cols = state.range(1);
+  Md A = random_matrix(rows, cols);
+  for (auto _: state) {
+    benchmark::DoNotOptimize(linalg::get_rank(A));
+  }
+  double elements = static_cast<double>(rows) * cols;
+  report(state, elimination_flops(rows, cols), WORD * elements, elements);
+}
+
+// n x n QRCP of a matrix of rank range(1): the rank only version stops after range(1) columns
+void BM_QRCP(benchmark::State& state) {
+  int n = state.range(0), rank = state.range(1), rank_only = state.range(2);
+  Md A = random_matrix(n, rank) * random_matrix(rank, n, false, 7);
+  for (auto _: state) {
+    linalg::QRCPFactorization qr {A, {.rank_only = rank_only != 0}};
+    benchmark::DoNotOptimize(qr.rank());
+  }
+  double elements = static_cast<double>(n) * n;
+  report(state, qr_flops(n, n), WORD * elements, elements);
+}
+
+// row space, column space and solution type: range(2) = 0 eliminates once per query,
+// 1 shares one elimination through analyze(). counted as the flops of a single RREF
+void BM_Analysis(benchmark::State& state) {
+  int rows = state.range(0), cols = state.range(1), shared = state.range(2);
+  Md A = random_matrix(rows, cols, true);
+  for (auto _: state) {
+    if (shared) {
+      auto analysis = linalg::analyze(A);
+      benchmark::DoNotOptimize(analysis.row_space().data());
+      benchmark::DoNotOptimize(analysis.col_space().data());
+      benchmark::DoNotOptimize(analysis.solution_type());
+    } else {
+      benchmark::DoNotOptimize(linalg::get_row_space(A).data());
+      benchmark::DoNotOptimize(linalg::get_col_space(A).data());
+      benchmark::DoNotOptimize(linalg::get_solution_type(linalg::gauss_jordan_elimination(A)));
+    }
+  }
+  double elements = static_cast<double>(rows) * cols;
+  report(state, 2 * elimination_flops(rows, cols), 2 * WORD * elements, elements);
+}
+
+void BM_Inverse(benchmark::State& state) {
+  int n = state.range(0);
+  Md A = random_matrix(n, n, true);
+  for (auto _: state) {
+    Md inv = linalg::inverse(A);
+    benchmark::DoNotOptimize(inv.data());
+  }
+  double elements = static_cast<double>(n) * n;
+  report(state, 2.0 * n * n * n, 2 * WORD * elements, elements);
+}
+
+void BM_SolveLinearSystem(benchmark::State& state) {
+  int n = state.range(0);
+  Md A = random_matrix(n, n, true), b = random_matrix(n, 1, false, 7);
+  for (auto _: state) {
+    auto solution = linalg::solve_linear_system(A, b);
+    benchmark::DoNotOptimize(solution.m_solutions.data());
+  }
+  double elements = static_cast<double>(n) * n;
+  report(state, 2 * elimination_flops(n, n + 1), WORD * (elements + 2 * n), elements);
+}
+
+// 1024 parameter vectors of a 256 x (256 + range(0)) system with range(0) free variables,
+// range(1) = 0 evaluates them one at a time, 1 as one batch into a reused output
+void BM_EvaluateSolution(benchmark::State& state) {
+  int free = state.range(0), batched = state.range(1), rows = 256, count = 1024;
+  int n = rows + free;
+  linalg::ParametricSolution x {linalg::solve_linear_system(random_matrix(rows, n, true), random_matrix(rows, 1, false, 7))};
+  Md params = random_matrix(count, free, false, 11), X (count, n);
+  for (auto _: state) {
+    if (batched) {
+      x.evaluate(params.view(), X.view());
+      benchmark::DoNotOptimize(X.data());
+    } else {
+      for (int i = 0; i < count; ++i) {
+        benchmark::DoNotOptimize(x(std::span<const double>{params.data() + static_cast<std::size_t>(i) * free, static_cast<std::size_t>(free)}).data());
+      }
+    }
+  }
+  double elements = static_cast<double>(count) * n;
+  report(state, 2.0 * count * n * free, WORD * (elements + static_cast<double>(count) * free), elements);
+}
+
+void BM_LUFactorization(benchmark::State& state) {
+  int n = state.range(0);
+  Md A = random_matrix(n, n, true);
+  for (auto _: state) {
+    linalg::LUFactorization lu {A};
+    benchmark::DoNotOptimize(lu.packed().data());
+  }
+  double elements = static_cast<double>(n) * n;
+  report(state, elimination_flops(n, n), 2 * WORD * elements, elements);
+}
+
+// n x n LU from a matrix file in panels of range(1) columns, compare with BM_LUFactorization.
+// bytes are the measured disk traffic, stall is the read time the prefetch did not hide
+void BM_OutOfCoreLU(benchmark::State& state) {
+  int n = state.range(0), panel_cols = state.range(1);
+  const std::string path = "/tmp/linalg_bench_lu_" + std::to_string(n) + ".mat";
+  linalg::save_binary(random_matrix(n, n, true), path);
+  linalg::IOStats io;
+  for (auto _: state) {
+    linalg::OutOfCoreLU lu (path, {.panel_cols = panel_cols});
+    io = lu.io_stats();
+  }
+  std::remove(path.c_str());
+  double elements = static_cast<double>(n) * n;
+  report(state, elimination_flops(n, n), io.bytes_read + io.bytes_written, elements);
+  state.counters["stall_ms"] = io.stall_seconds * 1e3;
+}
+
+void BM_LUSolve(benchmark::State& state) {
+  int n = state.range(0);
+  linalg::LUFactorization lu {random_matrix(n, n, true)};
+  std::vector<double> b = random_matrix(n, 1, false, 7).flatten();
+  for (auto _: state) {
+    auto x = lu.solve(b);
+    benchmark::DoNotOptimize(x.data());
+  }
+  double elements = static_cast<double>(n) * n;
+  report(state, 2.0 * n * n, WORD * (elements + 2 * n), elements);
+}
+
+// condition estimate from an existing factorization: a handful of solves, compare with BM_Inverse.
+// the flops counted are those of a single solve, so GFLOP/s / 2 is about the number of solves
+void BM_Rcond(benchmark::State& state) {
+  int n = state.range(0);
+  linalg::LUFactorization lu {random_matrix(n, n, true)};
+  for (auto _: state) {
+    benchmark::DoNotOptimize(lu.rcond());
+  }
+  double elements = static_cast<double>(n) * n;
+  report(state, 2.0 * n * n, WORD * elements, elements);
+}
+
+// N x N solve with a FixedMatrix, compare with BM_LUSolve / BM_SolveLinearSystem at small sizes
+template <int N>
+void BM_FixedSolve(benchmark::State& state) {
+  Md dense = random_matrix(N, N, true);
+  linalg::FixedMatrix<double, N, N> A {dense};
+  linalg::FixedMatrix<double, N, 1> b {random_matrix(N, 1, false, 7)};
+  for (auto _: state) {
+    benchmark::DoNotOptimize(A);
+    auto x = linalg::solve(A, b);
+    benchmark::DoNotOptimize(x);
+  }
+  report(state, 2.0 * N * N * N / 3, WORD * (N * N + 2 * N), N * N);
+}
+
+// a "request" of small operations that each allocate a result: range(1) selects where the
+// temporaries come from, 0 = heap, 1 = a MonotonicArena released per request, 2 = a PoolArena
+template <class M>
+int request(const M& A, const M& B) {
+  M sum {A + B, A.get_allocator()};
+  auto product = sum * A;
+  auto joined = product.transpose().concat(B, 1);
+  return linalg::gaussian_elimination(joined).getRows() + linalg::inverse(product + A).getRows();
+}
+
+void BM_Temporaries(benchmark::State& state) {
+  int n = state.range(0);
+  Md A = random_matrix(n, n, true), B = random_matrix(n, n, true, 7);
+  linalg::MonotonicArena arena;
+  linalg::PoolArena pool;
+  std::pmr::memory_resource* resource = state.range(1) == 1 ? static_cast<std::pmr::memory_resource*>(&arena) : &pool;
+  for (auto _: state) {
+    // the inputs are copied in as part of the request
+    if (state.range(1) == 0) {
+      Md a = A, b = B;
+      benchmark::DoNotOptimize(request(a, b));
+    } else {
+      linalg::pmr::Matrix<double> a {A, resource}, b {B, resource};
+      benchmark::DoNotOptimize(request(a, b));
+    }
+    arena.release();
+  }
+  report(state, 2.0 * n * n * n * 2, WORD * 2 * n * n, 2 * n * n);
+}
+
+// 10000 independent N x N systems at once, compare with BM_FixedSolve<N> per system
+template <int N>
+void BM_BatchedSolve(benchmark::State& state) {
+  const int count = 10000;
+  linalg::BatchedSystems systems {N, count};
+  std::mt19937 gen {42};
+  std::uniform_real_distribution<double> dist {-1, 1};
+  for (auto& v: systems.A_data()) {
+    v = dist(gen);
+  }
+  for (auto& v: systems.b_data()) {
+    v = dist(gen);
+  }
+  for (auto _: state) {
+    auto solutions = linalg::solve_batched(systems);
+    benchmark::DoNotOptimize(solutions.x.data());
+  }
+  report(state, 2.0 * N * N * N / 3 * count, WORD * (N * N + 2 * N) * count, N * N * count);
+  state.counters["systems/s"] = benchmark::Counter(double(count), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// 5-point laplacian on a g x g grid, n = g^2 unknowns
+linalg::SparseMatrix<double> grid_laplacian(int g) {
+  std::vector<linalg::Triplet<double>> entries;
+  for (int i = 0; i < g; ++i) {
+    for (int j = 0; j < g; ++j) {
+      int k = i * g + j;
+      entries.push_back({k, k, 4});
+      if (i > 0) entries.push_back({k, k - g, -1});
+      if (i < g - 1) entries.push_back({k, k + g, -1});
+      if (j > 0) entries.push_back({k, k - 1, -1});
+      if (j < g - 1) entries.push_back({k, k + 1, -1});
+    }
+  }
+  return linalg::SparseMatrix<double>{g * g, g * g, entries};
+}
+
+void BM_SparseLU(benchmark::State& state) {
+  linalg::SparseMatrix<double> A = grid_laplacian(state.range(0));
+  int factor_nonzeros = 0;
+  for (auto _: state) {
+    linalg::SparseLUFactorization lu {A};
+    factor_nonzeros = lu.nonZerosL() + lu.nonZerosU();
+    benchmark::DoNotOptimize(factor_nonzeros);
+  }
+  state.counters["nnz(L+U)"] = factor_nonzeros;
+  double elements = A.nonZeros();
+  report(state, 0, (WORD + sizeof(int)) * elements, elements);
+}
+
+// preconditioned CG on the same problem, to tolerance 1e-8
+void BM_ConjugateGradient(benchmark::State& state) {
+  linalg::SparseMatrix<double> A = grid_laplacian(state.range(0));
+  std::vector<double> b (A.getRows(), 1);
+  linalg::ILU0Preconditioner ilu {A};
+  linalg::IterativeReport iterations;
+  for (auto _: state) {
+    auto x = linalg::conjugate_gradient(linalg::SparseMatrixOperator{A}, b, {.tolerance = 1e-8, .preconditioner = &ilu}, &iterations);
+    benchmark::DoNotOptimize(x.m_solutions.data());
+  }
+  state.counters["iterations"] = iterations.iterations;
+  double elements = A.nonZeros();
+  // per iteration: one product with A and one ilu solve, each reading about nnz values
+  double flops = 4.0 * elements * iterations.iterations;
+  report(state, flops, 2 * (WORD + sizeof(int)) * elements * iterations.iterations, elements);
+}
+
+}
+
+BENCHMARK(BM_Add)->Apply(all_sizes);
+BENCHMARK(BM_ScalarMultiply)->Apply(all_sizes);
+BENCHMARK(BM_Multiply)->Apply(all_sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_MultiplyThreads)->ArgsProduct({{1024, 4096}, {1, 2, 4, 8, 16, 32}})->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Strassen)->ArgsProduct({{1024, 2048, 4096}, {128, 256, 512}})->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LoadBinary)->ArgsProduct({{256, 2048}, {0, 1, 2}})->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Transpose)->Apply(all_sizes);
+BENCHMARK(BM_TransposeInPlace)->Apply(all_sizes);
+BENCHMARK(BM_GaussianElimination)->Apply(all_sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_GaussJordanElimination)->Apply(all_sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Rank)->Apply(all_sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_QRCP)->ArgsProduct({{512, 1024}, {32, 512}, {0, 1}})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Analysis)->ArgsProduct({{256, 512}, {257}, {0, 1}})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Inverse)->Apply(square_sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SolveLinearSystem)->Apply(square_sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_EvaluateSolution)->ArgsProduct({{2, 256}, {0, 1}})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LUFactorization)->Apply(square_sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_OutOfCoreLU)->ArgsProduct({{1024, 2048}, {64, 256}})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LUSolve)->Apply(square_sizes);
+BENCHMARK(BM_Rcond)->Apply(square_sizes);
+BENCHMARK(BM_FixedSolve<3>);
+BENCHMARK(BM_FixedSolve<4>);
+BENCHMARK(BM_FixedSolve<6>);
+BENCHMARK(BM_Temporaries)->ArgsProduct({{4, 16, 64}, {0, 1, 2}});
+BENCHMARK(BM_BatchedSolve<3>)->UseRealTime();
+BENCHMARK(BM_BatchedSolve<4>)->UseRealTime();
+BENCHMARK(BM_BatchedSolve<6>)->UseRealTime();
+BENCHMARK(BM_SparseLU)->Arg(32)->Arg(128)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ConjugateGradient)->Arg(32)->Arg(128)->Unit(benchmark::kMillisecond);
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  // recorded in the JSON context so runs on different machines are not mixed up blindly
+  benchmark::AddCustomContext("simd", linalg::simd::kernel_set_name(linalg::simd::active_kernel_set()));
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""Compares two Google Benchmark JSON files and flags regressions.
+
+usage:
+  ./benchmarks --benchmark_out=baseline.json --benchmark_out_format=json   # once, on the reference build
+  ./benchmarks --benchmark_out=current.json --benchmark_out_format=json
+  python3 bench/compare.py baseline.json current.json [--threshold 0.10] [--metric real_time]
+
+exits with status 1 if any benchmark got slower than the threshold allows.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    results = {}
+    for bench in data.get("benchmarks", []):
+        # skip aggregates (mean/median/stddev) unless they are all there is
+        if bench.get("run_type") == "aggregate" and bench.get("aggregate_name") != "mean":
+            continue
+        name = bench.get("run_name", bench["name"])
+        results[name] = bench
+    return data.get("context", {}), results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="allowed relative slowdown before a benchmark is flagged (default 0.10)")
+    parser.add_argument("--metric", default="real_time", choices=["real_time", "cpu_time"])
+    args = parser.parse_args()
+
+    base_context, baseline = load(args.baseline)
+    curr_context, current = load(args.current)
+    for key in ("host_name", "num_cpus", "simd"):
+        if base_context.get(key) != curr_context.get(key):
+            print(f"warning: {key} differs ({base_context.get(key)} vs {curr_context.get(key)})")
+
+    regressions = 0
+    print(f"{'benchmark':<48} {'baseline':>12} {'current':>12} {'change':>8}")
+    for name, bench in current.items():
+        if name not in baseline:
+            print(f"{name:<48} {'-':>12} {bench[args.metric]:>12.4g} {'new':>8}")
+            continue
+        before = baseline[name][args.metric] * unit_scale(baseline[name])
+        after = bench[args.metric] * unit_scale(bench)
+        change = (after - before) / before if before else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{name:<48} {before:>12.4g} {after:>12.4g} {change:>+8.1%}{flag}")
+    for name in baseline.keys() - current.keys():
+        print(f"{name:<48} missing from current run")
+
+    if regressions:
+        print(f"\n{regressions} regression(s) above {args.threshold:.0%}")
+        return 1
+    print("\nno regressions")
+    return 0
+
+
+def unit_scale(bench):
+    """times in nanoseconds, whatever time_unit the benchmark used"""
+    return {"ns": 1, "us": 1e3, "ms": 1e6, "s": 1e9}[bench.get("time_unit", "ns")]
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,111 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+#include "Matrix.h"
+
+// memory resources for short lived matrices. a request handler creates an arena, does all its
+// work with pmr::Matrix on it and drops everything at once:
+//
+// MonotonicArena arena;
+// pmr::Matrix<double> A ({{1, 2}, {3, 4}}, &arena);
+// auto B = inverse(A * A.transpose());   // every temporary and B live in the arena
+// arena.release();                       // or let it go out of scope
+//
+// neither resource is thread safe, use one per thread (or per request).
+namespace linalg {
+
+// bump allocation in blocks taken from upstream, each twice the size of the previous one.
+// deallocate does nothing, memory only comes back on release() / destruction.
+class MonotonicArena: public std::pmr::memory_resource {
+  public:
+    explicit MonotonicArena(std::size_t initial_size=1 << 16,
+                            std::pmr::memory_resource* upstream=std::pmr::new_delete_resource());
+    ~MonotonicArena() override;
+
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+    // frees everything allocated so far. the largest block is kept, so an arena reused
+    // for request after request stops going upstream once it has seen the largest one
+    void release();
+
+    // bytes handed out since construction / the last release()
+    std::size_t bytes_allocated() const {return m_allocated;}
+    // bytes held from upstream
+    std::size_t bytes_reserved() const;
+
+  private:
+    struct Block {
+      std::byte* data;
+      std::size_t size;
+    };
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void*, std::size_t, std::size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {return this == &other;}
+
+    std::pmr::memory_resource* m_upstream;
+    std::size_t m_next_size;
+    std::vector<Block> m_blocks;
+    // free part of the last block
+    std::byte* m_current = nullptr;
+    std::size_t m_remaining = 0;
+    std::size_t m_allocated = 0;
+};
+
+// free lists of power of two size classes from 64 bytes up to max_pooled, carved out of
+// blocks taken from upstream. freed memory is reused by the next allocation of its class,
+// so repeatedly creating matrices of similar shapes stops allocating after the first round.
+// larger requests go straight to upstream.
+class PoolArena: public std::pmr::memory_resource {
+  public:
+    explicit PoolArena(std::size_t max_pooled=1 << 20,
+                       std::pmr::memory_resource* upstream=std::pmr::new_delete_resource());
+    ~PoolArena() override;
+
+    PoolArena(const PoolArena&) = delete;
+    PoolArena& operator=(const PoolArena&) = delete;
+
+    // returns every block to upstream. nothing allocated from the pool may be used afterwards
+    // (memory of requests above max_pooled is not affected)
+    void release();
+
+    std::size_t bytes_reserved() const;
+
+  private:
+    struct Node {
+      Node* next;
+    };
+    struct Block {
+      std::byte* data;
+      std::size_t size;
+    };
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {return this == &other;}
+
+    // index of the smallest class holding bytes, m_free.size() if none does
+    std::size_t size_class(std::size_t bytes) const;
+
+    std::pmr::memory_resource* m_upstream;
+    std::size_t m_max_pooled;
+    std::vector<Node*> m_free;
+    std::vector<Block> m_blocks;
+};
+
+namespace pmr {
+
+// a Matrix whose storage comes from a memory resource, e.g. pmr::Matrix<double> A (3, 3, 0, &arena)
+template <class T>
+using Matrix = linalg::Matrix<T, std::pmr::polymorphic_allocator<T>>;
+
+}
+
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef BATCHED_SOLVER_H
+#define BATCHED_SOLVER_H
+
+#include <span>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// many small independent square systems A_s x_s = b_s of the same size, solved together.
+// the systems are stored structure of arrays: the same element of consecutive systems is
+// contiguous, so one SIMD lane works on one system and every instruction serves several systems.
+namespace linalg {
+
+enum class BatchStatus : unsigned char {
+  OK,
+  // some pivot was below THRESHOLD, the system has no unique solution
+  SINGULAR
+};
+
+// count systems of size x size. element (i, j) of A_s is A_data()[(i * size + j) * count + s]
+// and entry i of b_s is b_data()[i * count + s].
+class BatchedSystems {
+  public:
+    BatchedSystems(int size, int count);
+
+    int size() const {return m_size;}
+    int count() const {return m_count;}
+
+    double& A(int system, int r, int c) {return m_A[(static_cast<std::size_t>(r) * m_size + c) * m_count + system];}
+    double A(int system, int r, int c) const {return m_A[(static_cast<std::size_t>(r) * m_size + c) * m_count + system];}
+    double& b(int system, int r) {return m_b[static_cast<std::size_t>(r) * m_count + system];}
+    double b(int system, int r) const {return m_b[static_cast<std::size_t>(r) * m_count + system];}
+
+    std::vector<double>& A_data() {return m_A;}
+    const std::vector<double>& A_data() const {return m_A;}
+    std::vector<double>& b_data() {return m_b;}
+    const std::vector<double>& b_data() const {return m_b;}
+
+  private:
+    int m_size;
+    int m_count;
+    std::vector<double> m_A;
+    std::vector<double> m_b;
+};
+
+struct BatchedSolutions {
+  int size;
+  int count;
+  // same layout as b: entry i of x_s is x[i * count + s], NaN for singular systems
+  std::vector<double> x;
+  std::vector<BatchStatus> status;
+
+  double operator()(int system, int i) const {return x[static_cast<std::size_t>(i) * count + system];}
+
+  // x_s as one vector
+  std::vector<double> solution(int system) const;
+};
+
+// gaussian elimination with partial pivoting on every system. pool: nullptr -> default_thread_pool()
+BatchedSolutions solve_batched(const BatchedSystems& systems, ThreadPool* pool=nullptr);
+
+// same on caller owned buffers in the layout above (A: size^2 * count, b and x: size * count)
+void solve_batched(int size, int count, std::span<const double> A, std::span<const double> b,
+                   std::span<double> x, std::span<BatchStatus> status, ThreadPool* pool=nullptr);
+
+}
+
+#endif
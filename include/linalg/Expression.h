@@ -0,0 +1,219 @@
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+#include <concepts>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// expression templates for element-wise Matrix arithmetic.
+// A + C - D * 2 builds a tree of small expression objects instead of temporaries, and the
+// whole tree is evaluated in one fused loop when it is assigned to (or used as) a Matrix.
+//
+// note: leaves are held by reference, so an expression must not outlive its operands,
+// e.g. auto e = A + B; is fine while A and B are alive; call .eval() to get a Matrix.
+//
+// building with LINALG_EAGER_EXPRESSIONS defined makes every operator evaluate right away,
+// which is handy when debugging. it changes return types, so it must be set for the whole build.
+
+namespace linalg {
+
+template <class T, class Alloc = std::allocator<T>>
+class Matrix;
+
+namespace expr {
+
+// a Matrix with any allocator, or a class derived from one
+template <class E>
+concept MatrixType = requires(const E& e) {
+  []<class T, class Alloc>(const Matrix<T, Alloc>&) {}(e);
+};
+
+// anything that can take part in an element-wise expression
+template <class E>
+concept Expression = requires(const E& e, int i) {
+  typename E::value_type;
+  { E::is_leaf } -> std::convertible_to<bool>;
+  { e.getRows() } -> std::convertible_to<int>;
+  { e.getCols() } -> std::convertible_to<int>;
+  e.coeff(i, i);
+};
+
+// leaves refer to storage (e.g. a Matrix) and are captured by reference,
+// interior nodes are a couple of references/values and are captured by copy
+template <class E>
+concept Leaf = Expression<E> && E::is_leaf;
+
+template <class E>
+using stored_t = std::conditional_t<Leaf<E>, const E&, const E>;
+
+// the allocator of the first Matrix leaf of an expression: results computed from an expression
+// take their storage from it, so e.g. A + B * 2 of arena matrices lands in the arena (Arena.h).
+// views and other leaves without an allocator give std::allocator
+template <class E>
+auto allocator_of(const E& e) {
+  if constexpr (requires {e.get_allocator();}) {
+    return e.get_allocator();
+  } else {
+    return std::allocator<typename E::value_type>{};
+  }
+}
+
+template <class E>
+using allocator_t = decltype(allocator_of(std::declval<const E&>()));
+
+// what Matrix<T, Alloc>(e) allocates with: the expression's allocator if it is an Alloc, else Alloc()
+template <class Alloc, class E>
+Alloc result_allocator(const E& e) {
+  if constexpr (std::is_convertible_v<allocator_t<E>, Alloc>) {
+    return Alloc(allocator_of(e));
+  } else {
+    return Alloc();
+  }
+}
+
+// whether an expression could read an element of the buffer [begin, end), laid out with the given
+// strides, after it was overwritten while the expression is written into that buffer element by
+// element. only a view into the buffer with another origin or other strides (e.g. the transpose
+// or a shifted block) can; a matrix is either the buffer itself or separate storage
+template <class E, class T>
+bool reads_shifted(const E& e, const T* begin, const T* end, int row_stride, int col_stride) {
+  if constexpr (requires {e.reads_shifted(begin, end, row_stride, col_stride);}) {
+    return e.reads_shifted(begin, end, row_stride, col_stride);
+  } else {
+    return false;
+  }
+}
+
+template <class L, class R>
+concept Compatible = Expression<L> && Expression<R> && std::same_as<typename L::value_type, typename R::value_type>;
+
+struct Add {
+  template <class T>
+  static T apply(const T& a, const T& b) {return a + b;}
+};
+
+struct Sub {
+  template <class T>
+  static T apply(const T& a, const T& b) {return a - b;}
+};
+
+template <class Op, class L, class R>
+class Binary {
+  public:
+    using value_type = typename L::value_type;
+    static constexpr bool is_leaf = false;
+
+    Binary(const L& lhs, const R& rhs)
+      : m_lhs{lhs}, m_rhs{rhs}
+    {
+      if (lhs.getRows() != rhs.getRows()) {
+        throw std::runtime_error("Number of rows must be equal!");
+      }
+      if (lhs.getCols() != rhs.getCols()) {
+        throw std::runtime_error("Number of columns must be equal!");
+      }
+    }
+
+    int getRows() const {return m_lhs.getRows();}
+    int getCols() const {return m_lhs.getCols();}
+
+    value_type coeff(int r, int c) const {
+      return Op::apply(m_lhs.coeff(r, c), m_rhs.coeff(r, c));
+    }
+
+    auto get_allocator() const {return allocator_of(m_lhs);}
+
+    bool reads_shifted(const value_type* begin, const value_type* end, int row_stride, int col_stride) const {
+      return expr::reads_shifted(m_lhs, begin, end, row_stride, col_stride)
+             || expr::reads_shifted(m_rhs, begin, end, row_stride, col_stride);
+    }
+
+    auto eval() const {return Matrix<value_type, allocator_t<Binary>>(*this, get_allocator());}
+
+  private:
+    stored_t<L> m_lhs;
+    stored_t<R> m_rhs;
+};
+
+// multiplication by an int scalar, same as Matrix::operator*=(int)
+template <class E>
+class Scaled {
+  public:
+    using value_type = typename E::value_type;
+    static constexpr bool is_leaf = false;
+
+    Scaled(const E& expr, int factor)
+      : m_expr{expr}, m_factor{factor}
+    {}
+
+    int getRows() const {return m_expr.getRows();}
+    int getCols() const {return m_expr.getCols();}
+
+    value_type coeff(int r, int c) const {
+      return m_expr.coeff(r, c) * m_factor;
+    }
+
+    auto get_allocator() const {return allocator_of(m_expr);}
+
+    bool reads_shifted(const value_type* begin, const value_type* end, int row_stride, int col_stride) const {
+      return expr::reads_shifted(m_expr, begin, end, row_stride, col_stride);
+    }
+
+    auto eval() const {return Matrix<value_type, allocator_t<Scaled>>(*this, get_allocator());}
+
+  private:
+    stored_t<E> m_expr;
+    int m_factor;
+};
+
+// lazy by default, eager when debugging
+template <class E>
+auto finish(const E& e) {
+#ifdef LINALG_EAGER_EXPRESSIONS
+  return e.eval();
+#else
+  return e;
+#endif
+}
+
+// matrices pass through untouched, anything else is evaluated into one
+template <class T, class Alloc>
+const Matrix<T, Alloc>& materialize(const Matrix<T, Alloc>& m) {
+  return m;
+}
+
+template <Expression E>
+  requires (!MatrixType<E>)
+Matrix<typename E::value_type, allocator_t<E>> materialize(const E& e) {
+  return Matrix<typename E::value_type, allocator_t<E>>(e, allocator_of(e));
+}
+
+}
+
+template <class L, class R>
+  requires expr::Compatible<L, R>
+auto operator+(const L& lhs, const R& rhs) {
+  return expr::finish(expr::Binary<expr::Add, L, R>{lhs, rhs});
+}
+
+template <class L, class R>
+  requires expr::Compatible<L, R>
+auto operator-(const L& lhs, const R& rhs) {
+  return expr::finish(expr::Binary<expr::Sub, L, R>{lhs, rhs});
+}
+
+template <expr::Expression E>
+auto operator*(const E& lhs, const int rhs) {
+  return expr::finish(expr::Scaled<E>{lhs, rhs});
+}
+
+template <expr::Expression E>
+auto operator*(const int lhs, const E& rhs) {
+  return expr::finish(expr::Scaled<E>{rhs, lhs});
+}
+
+}
+
+#endif
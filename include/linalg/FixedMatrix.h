@@ -0,0 +1,358 @@
+#ifndef FIXED_MATRIX_H
+#define FIXED_MATRIX_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "FloatingPoint.h"
+#include "Matrix.h"
+
+namespace linalg {
+
+// R x C matrix with its size in the type: no heap allocation and no runtime shape checks.
+// combining matrices of incompatible sizes does not compile.
+// meant for small sizes (transforms, 3x3 / 4x4 solves), everything is unrolled by the compiler.
+//
+// FixedMatrix<double, 2, 2> A ({{1, 2}, {3, 4}});
+//
+// converts to a Matrix<T> implicitly, so it can be passed to the general routines
+// (gaussian_elimination, solve_linear_system, ...).
+template <class T, int R, int C>
+  requires (R > 0 && C > 0)
+class FixedMatrix {
+  public:
+    using value_type = T;
+    static constexpr int rows = R;
+    static constexpr int cols = C;
+
+    // all zero
+    constexpr FixedMatrix() : m_data{} {}
+
+    // missing trailing entries are 0, too many entries is a compile error
+    constexpr FixedMatrix(const T (&values)[R][C]) : m_data{} {
+      for (int i = 0; i < R; ++i) {
+        for (int j = 0; j < C; ++j) {
+          m_data[i * C + j] = values[i][j];
+        }
+      }
+    }
+
+    // the shape is only known at runtime here, so it is checked
+    explicit FixedMatrix(const Matrix<T>& m) {
+      if (m.getRows() != R) {
+        throw std::runtime_error("Number of rows must be equal!");
+      }
+      if (m.getCols() != C) {
+        throw std::runtime_error("Number of columns must be equal!");
+      }
+      for (int i = 0; i < R; ++i) {
+        for (int j = 0; j < C; ++j) {
+          m_data[i * C + j] = m.coeff(i, j);
+        }
+      }
+    }
+
+    static constexpr FixedMatrix identity() requires (R == C) {
+      FixedMatrix result;
+      for (int i = 0; i < R; ++i) {
+        result(i, i) = 1;
+      }
+      return result;
+    }
+
+    operator Matrix<T>() const {
+      Matrix<T> result {R, C};
+      std::copy(m_data.begin(), m_data.end(), result.data());
+      return result;
+    }
+
+    constexpr int getRows() const {return R;}
+    constexpr int getCols() const {return C;}
+
+    // unchecked
+    constexpr T& operator()(int r, int c) {return m_data[r * C + c];}
+    constexpr const T& operator()(int r, int c) const {return m_data[r * C + c];}
+
+    constexpr T* data() {return m_data.data();}
+    constexpr const T* data() const {return m_data.data();}
+
+    constexpr FixedMatrix& operator+=(const FixedMatrix& rhs) {
+      for (int i = 0; i < R * C; ++i) {
+        m_data[i] += rhs.m_data[i];
+      }
+      return *this;
+    }
+
+    constexpr FixedMatrix& operator-=(const FixedMatrix& rhs) {
+      for (int i = 0; i < R * C; ++i) {
+        m_data[i] -= rhs.m_data[i];
+      }
+      return *this;
+    }
+
+    constexpr FixedMatrix& operator*=(const T rhs) {
+      for (auto& v: m_data) {
+        v *= rhs;
+      }
+      return *this;
+    }
+
+    constexpr FixedMatrix<T, C, R> transpose() const {
+      FixedMatrix<T, C, R> result;
+      for (int i = 0; i < R; ++i) {
+        for (int j = 0; j < C; ++j) {
+          result(j, i) = (*this)(i, j);
+        }
+      }
+      return result;
+    }
+
+    // same tolerance for doubles as Matrix::operator==
+    bool operator==(const FixedMatrix& other) const {
+      for (int i = 0; i < R * C; ++i) {
+        if constexpr (std::floating_point<T>) {
+          if (std::abs(m_data[i] - other.m_data[i]) >= THRESHOLD) {
+            return false;
+          }
+        } else if (m_data[i] != other.m_data[i]) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+  private:
+    std::array<T, static_cast<std::size_t>(R) * C> m_data;
+};
+
+template <class T, int R, int C>
+constexpr FixedMatrix<T, R, C> operator+(FixedMatrix<T, R, C> lhs, const FixedMatrix<T, R, C>& rhs) {
+  return lhs += rhs;
+}
+
+template <class T, int R, int C>
+constexpr FixedMatrix<T, R, C> operator-(FixedMatrix<T, R, C> lhs, const FixedMatrix<T, R, C>& rhs) {
+  return lhs -= rhs;
+}
+
+template <class T, int R, int C>
+constexpr FixedMatrix<T, R, C> operator*(FixedMatrix<T, R, C> lhs, const std::type_identity_t<T> rhs) {
+  return lhs *= rhs;
+}
+
+template <class T, int R, int C>
+constexpr FixedMatrix<T, R, C> operator*(const std::type_identity_t<T> lhs, FixedMatrix<T, R, C> rhs) {
+  return rhs *= lhs;
+}
+
+template <class T, int R, int K, int C>
+constexpr FixedMatrix<T, R, C> operator*(const FixedMatrix<T, R, K>& lhs, const FixedMatrix<T, K, C>& rhs) {
+  FixedMatrix<T, R, C> result;
+  for (int i = 0; i < R; ++i) {
+    for (int k = 0; k < K; ++k) {
+      const T a = lhs(i, k);
+      for (int j = 0; j < C; ++j) {
+        result(i, j) += a * rhs(k, j);
+      }
+    }
+  }
+  return result;
+}
+
+template <class T, int R, int C>
+std::ostream& operator<<(std::ostream& out, const FixedMatrix<T, R, C>& m) {
+  for (int i = 0; i < R; ++i) {
+    for (int j = 0; j < C; ++j) {
+      out << m(i, j) << " ";
+    }
+    out << "\n";
+  }
+  return out;
+}
+
+namespace fixed {
+
+// std::abs is not constexpr before C++23
+template <class T>
+constexpr T magnitude(T v) {
+  return v < 0 ? -v : v;
+}
+
+// true if partial pivoting meets a pivot below THRESHOLD, the test eliminate and
+// LUFactorization use. A is taken by value, only the pivots are needed
+template <class T, int N>
+constexpr bool has_small_pivot(FixedMatrix<T, N, N> A) {
+  for (int c = 0; c < N; ++c) {
+    int pivot = c;
+    for (int i = c + 1; i < N; ++i) {
+      if (fixed::magnitude(A(i, c)) > fixed::magnitude(A(pivot, c))) {
+        pivot = i;
+      }
+    }
+    if (fixed::magnitude(A(pivot, c)) < THRESHOLD) {
+      return true;
+    }
+    for (int j = c; j < N; ++j) {
+      std::swap(A(c, j), A(pivot, j));
+    }
+    for (int i = c + 1; i < N; ++i) {
+      const T factor = A(i, c) / A(c, c);
+      for (int j = c + 1; j < N; ++j) {
+        A(i, j) -= factor * A(c, j);
+      }
+    }
+  }
+  return false;
+}
+
+// solves A X = B in place with partial pivoting (B is overwritten by X, A by its LU).
+// returns false if a pivot is below THRESHOLD
+template <class T, int N, int K>
+constexpr bool eliminate(FixedMatrix<T, N, N>& A, FixedMatrix<T, N, K>& B) {
+  for (int c = 0; c < N; ++c) {
+    int pivot = c;
+    for (int i = c + 1; i < N; ++i) {
+      if (fixed::magnitude(A(i, c)) > fixed::magnitude(A(pivot, c))) {
+        pivot = i;
+      }
+    }
+    if (fixed::magnitude(A(pivot, c)) < THRESHOLD) {
+      return false;
+    }
+    if (pivot != c) {
+      for (int j = 0; j < N; ++j) {
+        std::swap(A(c, j), A(pivot, j));
+      }
+      for (int j = 0; j < K; ++j) {
+        std::swap(B(c, j), B(pivot, j));
+      }
+    }
+    for (int i = c + 1; i < N; ++i) {
+      const T factor = A(i, c) / A(c, c);
+      for (int j = c + 1; j < N; ++j) {
+        A(i, j) -= factor * A(c, j);
+      }
+      for (int j = 0; j < K; ++j) {
+        B(i, j) -= factor * B(c, j);
+      }
+    }
+  }
+  for (int i = N - 1; i >= 0; --i) {
+    for (int j = 0; j < K; ++j) {
+      T sum = B(i, j);
+      for (int k = i + 1; k < N; ++k) {
+        sum -= A(i, k) * B(k, j);
+      }
+      B(i, j) = sum / A(i, i);
+    }
+  }
+  return true;
+}
+
+}
+
+// closed forms up to 3x3, elimination above
+template <class T, int N>
+constexpr T determinant(const FixedMatrix<T, N, N>& A) {
+  if constexpr (N == 1) {
+    return A(0, 0);
+  } else if constexpr (N == 2) {
+    return A(0, 0) * A(1, 1) - A(0, 1) * A(1, 0);
+  } else if constexpr (N == 3) {
+    return A(0, 0) * (A(1, 1) * A(2, 2) - A(1, 2) * A(2, 1))
+         - A(0, 1) * (A(1, 0) * A(2, 2) - A(1, 2) * A(2, 0))
+         + A(0, 2) * (A(1, 0) * A(2, 1) - A(1, 1) * A(2, 0));
+  } else {
+    static_assert(std::floating_point<T>, "determinant of a matrix larger than 3x3 needs a floating point type");
+    FixedMatrix<T, N, N> lu = A;
+    T det = 1;
+    for (int c = 0; c < N; ++c) {
+      int pivot = c;
+      for (int i = c + 1; i < N; ++i) {
+        if (fixed::magnitude(lu(i, c)) > fixed::magnitude(lu(pivot, c))) {
+          pivot = i;
+        }
+      }
+      if (lu(pivot, c) == 0) {
+        return 0;
+      }
+      if (pivot != c) {
+        for (int j = 0; j < N; ++j) {
+          std::swap(lu(c, j), lu(pivot, j));
+        }
+        det = -det;
+      }
+      det *= lu(c, c);
+      for (int i = c + 1; i < N; ++i) {
+        const T factor = lu(i, c) / lu(c, c);
+        for (int j = c + 1; j < N; ++j) {
+          lu(i, j) -= factor * lu(c, j);
+        }
+      }
+    }
+    return det;
+  }
+}
+
+// adjugate / determinant up to 3x3, elimination above. throws like inverse(Matrix): singular
+// means a pivot below THRESHOLD, not a small determinant, so diag(1e-4) is invertible at any size
+template <std::floating_point T, int N>
+constexpr FixedMatrix<T, N, N> inverse(const FixedMatrix<T, N, N>& A) {
+  if constexpr (N <= 3) {
+    if (fixed::has_small_pivot(A)) {
+      throw std::runtime_error("Matrix is not invertible!");
+    }
+    const T det = determinant(A);
+    const T inv = 1 / det;
+    FixedMatrix<T, N, N> result;
+    if constexpr (N == 1) {
+      result(0, 0) = inv;
+    } else if constexpr (N == 2) {
+      result(0, 0) = A(1, 1) * inv;
+      result(0, 1) = -A(0, 1) * inv;
+      result(1, 0) = -A(1, 0) * inv;
+      result(1, 1) = A(0, 0) * inv;
+    } else {
+      result(0, 0) = (A(1, 1) * A(2, 2) - A(1, 2) * A(2, 1)) * inv;
+      result(0, 1) = (A(0, 2) * A(2, 1) - A(0, 1) * A(2, 2)) * inv;
+      result(0, 2) = (A(0, 1) * A(1, 2) - A(0, 2) * A(1, 1)) * inv;
+      result(1, 0) = (A(1, 2) * A(2, 0) - A(1, 0) * A(2, 2)) * inv;
+      result(1, 1) = (A(0, 0) * A(2, 2) - A(0, 2) * A(2, 0)) * inv;
+      result(1, 2) = (A(0, 2) * A(1, 0) - A(0, 0) * A(1, 2)) * inv;
+      result(2, 0) = (A(1, 0) * A(2, 1) - A(1, 1) * A(2, 0)) * inv;
+      result(2, 1) = (A(0, 1) * A(2, 0) - A(0, 0) * A(2, 1)) * inv;
+      result(2, 2) = (A(0, 0) * A(1, 1) - A(0, 1) * A(1, 0)) * inv;
+    }
+    return result;
+  } else {
+    FixedMatrix<T, N, N> lu = A;
+    auto result = FixedMatrix<T, N, N>::identity();
+    if (!fixed::eliminate(lu, result)) {
+      throw std::runtime_error("Matrix is not invertible!");
+    }
+    return result;
+  }
+}
+
+// solves A X = B for a square nonsingular A, throws if A is (numerically) singular.
+// for singular systems convert to Matrix and use solve_linear_system
+template <std::floating_point T, int N, int K>
+constexpr FixedMatrix<T, N, K> solve(const FixedMatrix<T, N, N>& A, const FixedMatrix<T, N, K>& B) {
+  FixedMatrix<T, N, N> lu = A;
+  FixedMatrix<T, N, K> X = B;
+  if (!fixed::eliminate(lu, X)) {
+    throw std::runtime_error("Matrix is not invertible!");
+  }
+  return X;
+}
+
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+// low level matrix multiply kernels working on raw row-major buffers.
+// lda/ldb/ldc are the row strides (see Matrix::stride()).
+namespace linalg {
+
+class ThreadPool;
+
+namespace kernels {
+
+struct GemmOptions {
+  // 0 -> every thread of the pool, 1 -> serial
+  int num_threads = 0;
+  // nullptr -> default_thread_pool(), which set_num_threads resizes (ThreadPool.h)
+  ThreadPool* pool = nullptr;
+  // products with fewer multiply-adds run serially
+  long parallel_threshold = 1L << 21;
+};
+
+// C (m x n) += A (m x k) * B (k x n).
+// large products are split into tiles of C that the pool's threads work through (and steal
+// from each other). the result is bit identical to the serial one, except when C has too few
+// tiles to keep every thread busy: then k is split as well and the partial products are added
+// up at the end, in a different order than the serial loop.
+void gemm(int m, int n, int k, const double* A, int lda, const double* B, int ldb, double* C, int ldc,
+          const GemmOptions& options={});
+void gemm(int m, int n, int k, const float* A, int lda, const float* B, int ldb, float* C, int ldc,
+          const GemmOptions& options={});
+
+}
+
+}
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef ITERATIVE_SOLVERS_H
+#define ITERATIVE_SOLVERS_H
+
+#include <functional>
+#include <vector>
+
+#include "Matrix.h"
+#include "Solution.h"
+#include "SparseMatrix.h"
+
+// Krylov solvers for large square systems Ax = b, when a solution accurate to a tolerance
+// is enough. they only need y = Ax, so A can be a Matrix, a SparseMatrix or matrix-free.
+namespace linalg {
+
+// a square n x n matrix, seen only through products with vectors
+class LinearOperator {
+  public:
+    virtual ~LinearOperator() = default;
+    virtual int size() const = 0;
+    // y = A x, y already has size() entries
+    virtual void apply(const std::vector<double>& x, std::vector<double>& y) const = 0;
+};
+
+class MatrixOperator: public LinearOperator {
+  public:
+    explicit MatrixOperator(const Matrix<double>& A);
+    int size() const override {return m_A.getRows();}
+    void apply(const std::vector<double>& x, std::vector<double>& y) const override;
+
+  private:
+    const Matrix<double>& m_A;
+};
+
+class SparseMatrixOperator: public LinearOperator {
+  public:
+    explicit SparseMatrixOperator(const SparseMatrix<double>& A);
+    int size() const override {return m_A.getRows();}
+    void apply(const std::vector<double>& x, std::vector<double>& y) const override;
+
+  private:
+    const SparseMatrix<double>& m_A;
+};
+
+// matrix-free: apply(x, y) computes y = A x however it likes
+class FunctionOperator: public LinearOperator {
+  public:
+    using Function = std::function<void(const std::vector<double>&, std::vector<double>&)>;
+    FunctionOperator(int size, Function apply);
+    int size() const override {return m_size;}
+    void apply(const std::vector<double>& x, std::vector<double>& y) const override {m_apply(x, y);}
+
+  private:
+    int m_size;
+    Function m_apply;
+};
+
+// M ~ A, cheap to invert. apply(r, z) computes z = M^-1 r
+class Preconditioner {
+  public:
+    virtual ~Preconditioner() = default;
+    virtual void apply(const std::vector<double>& r, std::vector<double>& z) const = 0;
+};
+
+// M = diag(A)
+class JacobiPreconditioner: public Preconditioner {
+  public:
+    explicit JacobiPreconditioner(const Matrix<double>& A);
+    explicit JacobiPreconditioner(const SparseMatrix<double>& A);
+    void apply(const std::vector<double>& r, std::vector<double>& z) const override;
+
+  private:
+    std::vector<double> m_inv_diagonal;
+};
+
+// M = LU where L and U are only allowed nonzeros where A has them
+class ILU0Preconditioner: public Preconditioner {
+  public:
+    explicit ILU0Preconditioner(const SparseMatrix<double>& A);
+    explicit ILU0Preconditioner(const Matrix<double>& A);
+    void apply(const std::vector<double>& r, std::vector<double>& z) const override;
+
+  private:
+    // L (unit diagonal, not stored) and U share the pattern of A
+    SparseMatrix<double> m_lu;
+    // position of the diagonal entry of every row in m_lu.values()
+    std::vector<int> m_diagonal;
+};
+
+struct IterativeOptions {
+  // stops once ||b - Ax|| <= tolerance * ||b||
+  double tolerance = 1e-10;
+  // matrix-vector products for CG and GMRES, iterations (two products each) for BiCGSTAB
+  int max_iterations = 1000;
+  // GMRES restarts after this many iterations, bounding memory to restart + 1 vectors
+  int restart = 30;
+  // nullptr -> none
+  const Preconditioner* preconditioner = nullptr;
+};
+
+struct IterativeReport {
+  int iterations = 0;
+  bool converged = false;
+  // ||b - Ax|| / ||b||, starting with the initial guess x = 0 (so residuals[0] == 1)
+  std::vector<double> residuals;
+};
+
+// every solver returns a ONE_SOLUTION SystemSolution just like solve_linear_system, and throws if
+// the tolerance is not reached within max_iterations. report (optional) is filled either way.
+
+// A symmetric positive definite (and M too)
+Solution::SystemSolution conjugate_gradient(const LinearOperator& A, const std::vector<double>& b,
+                                            const IterativeOptions& options={}, IterativeReport* report=nullptr);
+Solution::SystemSolution conjugate_gradient(const Matrix<double>& A, const Matrix<double>& b,
+                                            const IterativeOptions& options={}, IterativeReport* report=nullptr);
+
+// any nonsingular A. right preconditioned, so the residuals are those of the original system
+Solution::SystemSolution gmres(const LinearOperator& A, const std::vector<double>& b,
+                               const IterativeOptions& options={}, IterativeReport* report=nullptr);
+Solution::SystemSolution gmres(const Matrix<double>& A, const Matrix<double>& b,
+                               const IterativeOptions& options={}, IterativeReport* report=nullptr);
+
+// any nonsingular A, short recurrences (constant memory) but a less smooth convergence than GMRES
+Solution::SystemSolution bicgstab(const LinearOperator& A, const std::vector<double>& b,
+                                  const IterativeOptions& options={}, IterativeReport* report=nullptr);
+Solution::SystemSolution bicgstab(const Matrix<double>& A, const Matrix<double>& b,
+                                  const IterativeOptions& options={}, IterativeReport* report=nullptr);
+
+}
+
+#endif
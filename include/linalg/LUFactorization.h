@@ -0,0 +1,79 @@
+#ifndef LU_FACTORIZATION_H
+#define LU_FACTORIZATION_H
+
+#include <vector>
+
+#include "Matrix.h"
+
+namespace linalg {
+
+// det = sign * exp(log_abs), which does not overflow when det itself would.
+// singular: sign 0, log_abs -infinity
+struct LogDeterminant {
+  int sign;
+  double log_abs;
+};
+
+// PA = LU with partial pivoting, computed once and reused for any number of solves.
+// pivots are chosen like compute_max_in_col (largest absolute value in the column).
+// U is kept in row echelon form: a column whose candidates are all below THRESHOLD is
+// skipped without using up a row, exactly as gaussian_elimination does, so rank() also
+// works for singular and non square matrices.
+class LUFactorization {
+  public:
+    // block_size: number of columns factored as one panel before the trailing matrix
+    // is updated with a single matrix multiply
+    explicit LUFactorization(const Matrix<double>& A, int block_size=64);
+
+    int getRows() const {return m_lu.getRows();}
+    int getCols() const {return m_lu.getCols();}
+
+    int rank() const {return m_pivot_cols.size();}
+
+    // square and full rank
+    bool is_invertible() const;
+
+    double determinant() const;
+    LogDeterminant log_determinant() const;
+
+    // 1 / (||A||_1 ||A^-1||_1) for a square A, 0 if singular. ||A^-1||_1 is estimated (Hager's
+    // method as refined by Higham, LAPACK's dlacn2) from a few solves with A and A^T, O(n^2)
+    // instead of the O(n^3) inverse. the estimate of ||A^-1||_1 is a lower bound, almost always
+    // within a factor of 3, so rcond() may come out somewhat larger than the true value
+    double rcond() const;
+
+    // solves Ax = b, b has getRows() entries
+    std::vector<double> solve(const std::vector<double>& b) const;
+
+    // solves AX = B for every column of B at once
+    Matrix<double> solve(const Matrix<double>& B) const;
+
+    Matrix<double> inverse() const;
+
+    // L (unit diagonal, stored below the pivots) and U packed into one matrix
+    const Matrix<double>& packed() const {return m_lu;}
+
+    // row i of PA is row permutation()[i] of A
+    const std::vector<int>& permutation() const {return m_perm;}
+
+    // column of the pivot of every nonzero row of U
+    const std::vector<int>& pivot_columns() const {return m_pivot_cols;}
+
+  private:
+    void require_invertible() const;
+    // X (n x k, row major) <- U^-1 L^-1 X, X already permuted
+    void substitute(double* X, int k) const;
+    // x <- A^-T x
+    void solve_transposed(std::vector<double>& x) const;
+
+    Matrix<double> m_lu;
+    std::vector<int> m_perm;
+    std::vector<int> m_pivot_cols;
+    int m_swaps = 0;
+    // ||A||_1, for rcond()
+    double m_norm1 = 0;
+};
+
+}
+
+#endif
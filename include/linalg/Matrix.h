@@ -1,14 +1,24 @@
 #ifndef MATRIX_H
 #define MATRIX_H
 
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
 #include <iostream>
 #include <initializer_list>
-#include <set>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "Expression.h"
+#include "Gemm.h"
+#include "MatrixView.h"
+#include "Simd.h"
 #include "Solution.h"
+#include "Transpose.h"
 #include "Vectors.h"
 
 namespace linalg {
@@ -16,68 +26,121 @@ namespace linalg {
 template <typename T> 
 using TwoDList = std::initializer_list<std::initializer_list<T>>;
 
-//forward declare class
-template <class T> 
+//forward declare class (the default allocator is given in Expression.h)
+template <class T, class Alloc> 
 class Matrix; 
 
 //predeclare friend templates
-template <class T> 
-std::ostream& operator<<(std::ostream& out, const Matrix<T>& m);
+template <class T, class Alloc> 
+std::ostream& operator<<(std::ostream& out, const Matrix<T, Alloc>& m);
 
-template <class T> 
-Matrix<T> operator+(const Matrix<T>& lhs, const Matrix<T>& rhs);
+template <class T, class Alloc>
+Matrix<T, Alloc> operator*(const Matrix<T, Alloc>& lhs, const Matrix<T, Alloc>& rhs);
 
-template <class T> 
-Matrix<T> operator*(const Matrix<T>& lhs, const int rhs);
-
-template <class T> 
-Matrix<T> operator*(const int lhs, const Matrix<T>& rhs);
-
-template <class T>
-Matrix<T> operator*(const Matrix<T>& lhs, const Matrix<T>& rhs);
-
-template <class T>
-Matrix<T> operator-(const Matrix<T>& lhs, const Matrix<T>& rhs);
-
-template <class T> 
+// Alloc provides the element buffer. matrices computed from a matrix (copies, sums and other
+// lazy expressions, products, transposes, concat, eliminations, inverse) get their buffer from
+// its allocator, so with an arena (see Arena.h) all the temporaries of a computation come out of
+// the arena. expressions use their first matrix; views carry no allocator and give std::allocator.
+template <class T, class Alloc> 
 class Matrix {
   protected:
     int m_rows;
     int m_cols;
-    TwoDVector<T> m_matrix;
+    // single row-major buffer, element (r,c) lives at m_data[r * stride() + c]
+    std::vector<T, Alloc> m_data;
 
   public: 
-    Matrix(int rows, int cols, T init=0);
-    Matrix(const TwoDVector<T>& matrix);
-    Matrix(const TwoDList<T>& list);
+    // lets a Matrix take part in the lazy element-wise expressions of Expression.h
+    using value_type = T;
+    using allocator_type = Alloc;
+    static constexpr bool is_leaf = true;
+
+    Matrix(int rows, int cols, T init=0, const Alloc& alloc=Alloc());
+    Matrix(const TwoDVector<T>& matrix, const Alloc& alloc=Alloc());
+    // rows are released as soon as they are copied, so peak memory stays close to one matrix
+    Matrix(TwoDVector<T>&& matrix, const Alloc& alloc=Alloc());
+    Matrix(const TwoDList<T>& list, const Alloc& alloc=Alloc());
+
+    // copy into the storage of alloc
+    Matrix(const Matrix& other, const Alloc& alloc)
+      : m_rows{other.m_rows}, m_cols{other.m_cols}, m_data(other.m_data, alloc)
+    {}
+
+    // copies keep the allocator of other. std::vector would ask
+    // select_on_container_copy_construction, which for std::pmr is the default resource
+    Matrix(const Matrix& other)
+      : Matrix{other, other.get_allocator()}
+    {}
+    Matrix(Matrix&&) = default;
+    Matrix& operator=(const Matrix&) = default;
+    Matrix& operator=(Matrix&&) = default;
+
+    // evaluates an element-wise expression such as A + C - D * 2 in a single pass.
+    // the storage comes from the allocator of its first matrix when that is an Alloc (Expression.h)
+    template <expr::Expression E>
+      requires (!std::is_base_of_v<Matrix, E>)
+    Matrix(const E& expr)
+      : Matrix(expr, expr::result_allocator<Alloc>(expr))
+    {}
+    template <expr::Expression E>
+      requires (!std::is_base_of_v<Matrix, E>)
+    Matrix(const E& expr, const Alloc& alloc);
+
+    template <expr::Expression E>
+      requires (!std::is_base_of_v<Matrix, E>)
+    Matrix& operator=(const E& expr);
 
     // why need <>? : https://isocpp.org/wiki/faq/templates#template-friends
-    friend std::ostream& operator<< <>(std::ostream& out, const Matrix<T>& m);
+    friend std::ostream& operator<< <>(std::ostream& out, const Matrix& m);
 
     // https://stackoverflow.com/questions/4421706/what-are-the-basic-rules-and-idioms-for-operator-overloading
+    // +, - and * by a scalar are lazy, see Expression.h
     //addition
-    Matrix& operator+=(const Matrix<T>& rhs);
-    friend Matrix operator+ <>(const Matrix<T>& lhs, const Matrix<T>& rhs);
+    Matrix& operator+=(const Matrix& rhs);
+    template <expr::Expression E>
+    Matrix& operator+=(const E& rhs);
 
     //scalar multiplication
     Matrix& operator*=(const int rhs);
-    friend Matrix operator* <>(const Matrix<T>& lhs, const int rhs);
-    friend Matrix operator* <>(const int lhs, const Matrix<T>& rhs);
 
     //matrix multiplication
-    Matrix& operator*=(const Matrix<T>& rhs);
-    friend Matrix operator* <>(const Matrix<T>& lhs, const Matrix<T>& rhs);
+    Matrix& operator*=(const Matrix& rhs);
+    friend Matrix operator* <>(const Matrix& lhs, const Matrix& rhs);
 
     //subtraction
-    Matrix& operator-=(const Matrix<T>& rhs);
-    friend Matrix operator- <>(const Matrix<T>& lhs, const Matrix<T>& rhs);
+    Matrix& operator-=(const Matrix& rhs);
+    template <expr::Expression E>
+    Matrix& operator-=(const E& rhs);
 
     //transpose
-    Matrix transpose() const;
+    Matrix transpose() const&;
+    // a temporary (or std::move'd) matrix is transposed in its own storage
+    Matrix transpose() &&;
+
+    // transposes this matrix without allocating a second one: tiled swaps for square
+    // matrices, cycle following (one extra bit per element) for rectangular ones
+    Matrix& transpose_inplace();
 
     //concat 
     //axis = 0 -> horizontal; 1 -> vertical
-    Matrix concat(const Matrix<T>& rhs, int axis=0) const;
+    //rhs can be a Matrix, a view or any element-wise expression
+    template <expr::Expression E>
+      requires std::is_same_v<typename E::value_type, T>
+    Matrix concat(const E& rhs, int axis=0) const;
+
+    // zero-copy views of this matrix, see MatrixView.h
+    MatrixView<T> view() {return MatrixView<T>{data(), m_rows, m_cols, stride()};}
+    ConstMatrixView<T> view() const {return ConstMatrixView<T>{data(), m_rows, m_cols, stride()};}
+
+    // rows [r, r + rows) and cols [c, c + cols)
+    MatrixView<T> block(int r, int c, int rows, int cols) {return view().block(r, c, rows, cols);}
+    ConstMatrixView<T> block(int r, int c, int rows, int cols) const {return view().block(r, c, rows, cols);}
+
+    MatrixView<T> row(int r) {return view().row(r);}
+    ConstMatrixView<T> row(int r) const {return view().row(r);}
+
+    MatrixView<T> col(int c) {return view().col(c);}
+    ConstMatrixView<T> col(int c) const {return view().col(c);}
 
     //flatten 1D
     std::vector<T> flatten() const;
@@ -85,14 +148,40 @@ class Matrix {
     int getRows() const {return m_rows;}
     int getCols() const {return m_cols;}
 
+    Alloc get_allocator() const {return m_data.get_allocator();}
+
+    // raw access to the contiguous buffer, e.g. for handing rows to kernels
+    T* data() {return m_data.data();}
+    const T* data() const {return m_data.data();}
+
+    // distance (in elements) between the starts of two consecutive rows
+    int stride() const {return m_cols;}
+
     // get element at (r,c)
     const T& operator()(int r, int c) const;
 
     // set element at (r,c)
     T& operator()(int r, int c);
 
+    // unchecked element access used by expression evaluation
+    const T& coeff(int r, int c) const {return m_data[static_cast<std::size_t>(r) * m_cols + c];}
+
+    // no-op, so eval() can be called on any expression including a plain Matrix
+    const Matrix& eval() const {return *this;}
+
     bool operator==(const Matrix& other) const{
-      return m_matrix == other.m_matrix;
+      if (m_rows != other.m_rows || m_cols != other.m_cols) {
+        return false;
+      }
+      // doubles are compared with a tolerance, see Vectors.h
+      if constexpr (std::is_same_v<T, double> && std::is_same_v<Alloc, std::allocator<T>>) {
+        return ::operator==(m_data, other.m_data);
+      } else if constexpr (std::is_same_v<T, double>) {
+        return std::equal(m_data.begin(), m_data.end(), other.m_data.begin(),
+                          [](double a, double b) {return std::fabs(a - b) < THRESHOLD;});
+      } else {
+        return m_data == other.m_data;
+      }
     }
 
     //friend non member functions below:
@@ -104,8 +193,6 @@ class Matrix {
     //produces a matrix of Reduced Row Echelon Form (RREF). note: RREF is unique while REF is not. 
     friend Matrix<double> gauss_jordan_elimination(const Matrix<double>& matrix);
 
-    friend int get_rank(const Matrix<double>& m);
-
     // row space and col space are obtained from RREF for simplicity. 
     friend TwoDVector<double> get_row_space(const Matrix<double>& m);
     friend TwoDVector<double> get_col_space(const Matrix<double>& m);
@@ -119,11 +206,59 @@ class Matrix {
 
 int compute_max_in_col(int r, int c, const Matrix<double>& matrix);
 
+class ThreadPool;
+
+// controls how the elimination routines spread the row updates of a pivot step over threads
+struct EliminationOptions {
+  // a pivot step runs in parallel only if it updates at least this many elements
+  long parallel_threshold = 1L << 16;
+  // nullptr -> default_thread_pool() (ThreadPool.h)
+  ThreadPool* pool = nullptr;
+  // every row is updated independently from the pivot row, so the result is bit identical
+  // to the serial one either way. deterministic additionally pins each row to the same
+  // thread (static partitioning) instead of handing out chunks on demand.
+  bool deterministic = true;
+};
+
 Matrix<double> gaussian_elimination(const Matrix<double>& matrix);
+Matrix<double> gaussian_elimination(const Matrix<double>& matrix, const EliminationOptions& options);
+// reuses the storage of a temporary (or std::move'd) matrix for the result
+Matrix<double> gaussian_elimination(Matrix<double>&& matrix, const EliminationOptions& options={});
 
 Matrix<double> gauss_jordan_elimination(const Matrix<double>& matrix);
+Matrix<double> gauss_jordan_elimination(const Matrix<double>& matrix, const EliminationOptions& options);
+Matrix<double> gauss_jordan_elimination(Matrix<double>&& matrix, const EliminationOptions& options={});
+
+// same as above, but overwrite matrix with its REF / RREF
+void gaussian_elimination_inplace(Matrix<double>& matrix, const EliminationOptions& options={});
+void gauss_jordan_elimination_inplace(Matrix<double>& matrix, const EliminationOptions& options={});
+
+// the same routines on (part of) a matrix, e.g. gaussian_elimination_inplace(A.block(0, 0, k, n)).
+// views with contiguous rows are eliminated where they are; others (e.g. transposed views)
+// go through a temporary copy.
+Matrix<double> gaussian_elimination(ConstMatrixView<double> matrix, const EliminationOptions& options={});
+Matrix<double> gauss_jordan_elimination(ConstMatrixView<double> matrix, const EliminationOptions& options={});
+void gaussian_elimination_inplace(MatrixView<double> matrix, const EliminationOptions& options={});
+void gauss_jordan_elimination_inplace(MatrixView<double> matrix, const EliminationOptions& options={});
+
+// without these a MatrixView<double> would be equally convertible to a Matrix and a ConstMatrixView
+inline Matrix<double> gaussian_elimination(MatrixView<double> matrix, const EliminationOptions& options={}) {
+  return gaussian_elimination(ConstMatrixView<double>{matrix}, options);
+}
 
-int get_rank(const Matrix<double>& m);
+inline Matrix<double> gauss_jordan_elimination(MatrixView<double> matrix, const EliminationOptions& options={}) {
+  return gauss_jordan_elimination(ConstMatrixView<double>{matrix}, options);
+}
+
+enum class RankMethod {
+  // pivots of the elimination, judged against THRESHOLD like inverse, LUFactorization and analyze
+  ELIMINATION,
+  // column pivoted QR (QRCPFactorization.h) with a tolerance relative to the largest column
+  QRCP
+};
+
+// QRCP gives a rank that does not change when m is scaled
+int get_rank(const Matrix<double>& m, RankMethod method=RankMethod::ELIMINATION);
 
 TwoDVector<double> get_row_space(const Matrix<double>& m);
 
@@ -131,24 +266,99 @@ TwoDVector<double> get_col_space(const Matrix<double>& m);
 
 Matrix<double> inverse(const Matrix<double>& m);
 
+// from an LU factorization, 0 for singular matrices. overflows for large matrices long before
+// the factorization has any trouble, LUFactorization::log_determinant does not
+double determinant(const Matrix<double>& m);
+
+enum class NormType {
+  // largest column sum of |a_ij|
+  ONE,
+  // largest row sum of |a_ij|
+  INF,
+  // square root of the sum of a_ij^2
+  FROBENIUS
+};
+
+double norm(ConstMatrixView<double> m, NormType type);
+
+inline double norm(const Matrix<double>& m, NormType type) {
+  return norm(m.view(), type);
+}
+
+// without this a MatrixView<double> would be equally convertible to a Matrix and a ConstMatrixView
+inline double norm(MatrixView<double> m, NormType type) {
+  return norm(ConstMatrixView<double>{m}, type);
+}
+
 Solution::SolutionType get_solution_type(const Matrix<double>& A);
 
 Solution::SystemSolution solve_linear_system(const Matrix<double>& A, const Matrix<double>& b);
 
-template <class T>
-class IdentityMatrix: public Matrix<T> {
+// solves Ax = b for every column b of B (n x k) with a single elimination of [A | B].
+// solutions[j] is what solve_linear_system(A, column j of B) returns.
+// the span overload takes one vector per right hand side (not rows, unlike TwoDVector).
+std::vector<Solution::SystemSolution> solve_linear_systems(const Matrix<double>& A, const Matrix<double>& B);
+std::vector<Solution::SystemSolution> solve_linear_systems(const Matrix<double>& A, std::span<const std::vector<double>> bs);
+
+template <class T, class Alloc = std::allocator<T>>
+class IdentityMatrix: public Matrix<T, Alloc> {
   public:
-    IdentityMatrix(int size) 
-      : Matrix<T>{size, size} 
+    IdentityMatrix(int size, const Alloc& alloc=Alloc()) 
+      : Matrix<T, Alloc>{size, size, 0, alloc} 
     {
       for (int i = 0; i < this->m_rows; ++i) {
-        this->m_matrix[i][i] = 1;
+        this->m_data[static_cast<std::size_t>(i) * size + i] = 1;
       }
     }
 };
 
-template<class T>
-Matrix<T>::Matrix(int rows, int cols, T init) {
+// matrices with any other allocator (e.g. pmr::Matrix on an arena, see Arena.h). the result
+// comes from the allocator of the argument and is eliminated in place, through a view
+template <class Alloc>
+  requires (!std::is_same_v<Alloc, std::allocator<double>>)
+Matrix<double, Alloc> gaussian_elimination(const Matrix<double, Alloc>& matrix, const EliminationOptions& options={}) {
+  Matrix<double, Alloc> result {matrix, matrix.get_allocator()};
+  gaussian_elimination_inplace(result.view(), options);
+  return result;
+}
+
+template <class Alloc>
+  requires (!std::is_same_v<Alloc, std::allocator<double>>)
+Matrix<double, Alloc> gauss_jordan_elimination(const Matrix<double, Alloc>& matrix, const EliminationOptions& options={}) {
+  Matrix<double, Alloc> result {matrix, matrix.get_allocator()};
+  gauss_jordan_elimination_inplace(result.view(), options);
+  return result;
+}
+
+// RREF of [A | I] is [I | A^-1] exactly when A is invertible
+template <class Alloc>
+  requires (!std::is_same_v<Alloc, std::allocator<double>>)
+Matrix<double, Alloc> inverse(const Matrix<double, Alloc>& matrix) {
+  const int n = matrix.getRows();
+  if (n != matrix.getCols()) {
+    throw std::runtime_error("Number of rows must equal number of columns!");
+  }
+  Matrix<double, Alloc> augmented {n, 2 * n, 0, matrix.get_allocator()};
+  augmented.block(0, 0, n, n).assign(matrix);
+  for (int i = 0; i < n; ++i) {
+    augmented(i, n + i) = 1;
+  }
+  gauss_jordan_elimination_inplace(augmented.view());
+  for (int i = 0; i < n; ++i) {
+    // otherwise the pivot of row i is further right
+    if (augmented.coeff(i, i) == 0) {
+      throw std::runtime_error("Matrix is not invertible!");
+    }
+  }
+  Matrix<double, Alloc> result {n, n, 0, matrix.get_allocator()};
+  result.view().assign(augmented.block(0, n, n, n));
+  return result;
+}
+
+template<class T, class Alloc>
+Matrix<T, Alloc>::Matrix(int rows, int cols, T init, const Alloc& alloc)
+  : m_data(alloc)
+{
   if (rows <= 0) {
     throw std::runtime_error("rows must be > 0!");
   }
@@ -157,48 +367,115 @@ Matrix<T>::Matrix(int rows, int cols, T init) {
   }
   m_rows = rows;
   m_cols = cols;
-  m_matrix = TwoDVector<T>(m_rows, std::vector<T>(m_cols, init));
+  m_data.assign(static_cast<std::size_t>(m_rows) * m_cols, init);
 }
 
-template<class T>
-Matrix<T>::Matrix(const TwoDVector<T>& matrix) {
+template<class T, class Alloc>
+Matrix<T, Alloc>::Matrix(const TwoDVector<T>& matrix, const Alloc& alloc)
+  : m_data(alloc)
+{
   if (matrix.empty()) {
     throw std::runtime_error("Matrix cannot be empty");
   }
-  std::set<int> cols;
   for (const auto& row: matrix) {
-    cols.insert(row.size());
-    if (cols.size() > 1) {
+    if (row.size() != matrix[0].size()) {
       throw std::runtime_error("Inconsistent number of columns in matrix!");
     }
   }
   m_rows = matrix.size();
   m_cols = matrix[0].size();
-  m_matrix = matrix; //invokes copy assignment
+  m_data.reserve(static_cast<std::size_t>(m_rows) * m_cols);
+  for (const auto& row: matrix) {
+    m_data.insert(m_data.end(), row.begin(), row.end());
+  }
 }
 
-template<class T>
-Matrix<T>::Matrix(const TwoDList<T>& matrix) {
+template<class T, class Alloc>
+Matrix<T, Alloc>::Matrix(TwoDVector<T>&& matrix, const Alloc& alloc)
+  : m_data(alloc)
+{
+  if (matrix.empty()) {
+    throw std::runtime_error("Matrix cannot be empty");
+  }
+  for (const auto& row: matrix) {
+    if (row.size() != matrix[0].size()) {
+      throw std::runtime_error("Inconsistent number of columns in matrix!");
+    }
+  }
+  m_rows = matrix.size();
+  m_cols = matrix[0].size();
+  m_data.reserve(static_cast<std::size_t>(m_rows) * m_cols);
+  for (auto& row: matrix) {
+    m_data.insert(m_data.end(), std::make_move_iterator(row.begin()), std::make_move_iterator(row.end()));
+    std::vector<T>().swap(row);
+  }
+}
+
+template<class T, class Alloc>
+Matrix<T, Alloc>::Matrix(const TwoDList<T>& matrix, const Alloc& alloc)
+  : m_data(alloc)
+{
   if (matrix.size() == 0) {
     throw std::runtime_error("Matrix cannot be empty");
   }
-  std::set<std::size_t> cols;
+  std::size_t cols = matrix.begin()->size();
   for (const auto& row: matrix) {
-    cols.insert(row.size());
-    if (cols.size() > 1) {
+    if (row.size() != cols) {
       throw std::runtime_error("Inconsistent number of columns in matrix!");
     }
-    m_matrix.emplace_back(row);
   }
   m_rows = matrix.size();
-  m_cols = *(cols.begin());
+  m_cols = cols;
+  m_data.reserve(static_cast<std::size_t>(m_rows) * m_cols);
+  for (const auto& row: matrix) {
+    m_data.insert(m_data.end(), row.begin(), row.end());
+  }
 }
 
-template<class T>
-std::ostream& operator<<(std::ostream& out, const Matrix<T>& m) {
-  for (const auto& row: m.m_matrix) {
-    for (const auto& v: row) {
-      out << v << " ";
+template<class T, class Alloc>
+template <expr::Expression E>
+  requires (!std::is_base_of_v<Matrix<T, Alloc>, E>)
+Matrix<T, Alloc>::Matrix(const E& expr, const Alloc& alloc)
+  : m_rows{expr.getRows()}, m_cols{expr.getCols()}, m_data(static_cast<std::size_t>(m_rows) * m_cols, alloc)
+{
+  T* out = data();
+  for (int i = 0; i < m_rows; ++i) {
+    for (int j = 0; j < m_cols; ++j) {
+      *out++ = expr.coeff(i, j);
+    }
+  }
+}
+
+template<class T, class Alloc>
+template <expr::Expression E>
+  requires (!std::is_base_of_v<Matrix<T, Alloc>, E>)
+Matrix<T, Alloc>& Matrix<T, Alloc>::operator=(const E& expr) {
+  if (m_rows != expr.getRows() || m_cols != expr.getCols()) {
+    // this matrix cannot be an operand (shapes differ), so building a new one is safe
+    *this = Matrix<T, Alloc>(expr, get_allocator());
+    return *this;
+  }
+  // element (i, j) only reads (i, j) of the operands, so A = A + B can run in place, unless a
+  // view reads this matrix at other positions, e.g. A = A + A.view().transpose()
+  if (expr::reads_shifted(expr, data(), data() + m_data.size(), stride(), 1)) {
+    *this = Matrix<T, Alloc>(expr, get_allocator());
+    return *this;
+  }
+  T* out = data();
+  for (int i = 0; i < m_rows; ++i) {
+    for (int j = 0; j < m_cols; ++j) {
+      *out++ = expr.coeff(i, j);
+    }
+  }
+  return *this;
+}
+
+template<class T, class Alloc>
+std::ostream& operator<<(std::ostream& out, const Matrix<T, Alloc>& m) {
+  for (int i = 0; i < m.m_rows; ++i) {
+    const T* row = m.data() + static_cast<std::size_t>(i) * m.stride();
+    for (int j = 0; j < m.m_cols; ++j) {
+      out << row[j] << " ";
     }
     out << "\n";
   }
@@ -206,168 +483,300 @@ std::ostream& operator<<(std::ostream& out, const Matrix<T>& m) {
 }
 
 //member functions return *this so we can chain multiple operations
-template<class T>
-Matrix<T>& Matrix<T>::operator+=(const Matrix& rhs) {
+template<class T, class Alloc>
+Matrix<T, Alloc>& Matrix<T, Alloc>::operator+=(const Matrix& rhs) {
   if (m_rows != rhs.m_rows) {
     throw std::runtime_error("Number of rows must be equal!");
   }
   if (m_cols != rhs.m_cols) {
     throw std::runtime_error("Number of columns must be equal!");
   }
+  if constexpr (std::is_same_v<T, double>) {
+    simd::add(m_data.size(), rhs.data(), data());
+  } else {
+    for (std::size_t i = 0; i < m_data.size(); ++i) {
+      m_data[i] += rhs.m_data[i];
+    }
+  }
+  return *this;
+}
+
+template<class T, class Alloc>
+template <expr::Expression E>
+Matrix<T, Alloc>& Matrix<T, Alloc>::operator+=(const E& rhs) {
+  if (m_rows != rhs.getRows()) {
+    throw std::runtime_error("Number of rows must be equal!");
+  }
+  if (m_cols != rhs.getCols()) {
+    throw std::runtime_error("Number of columns must be equal!");
+  }
+  if (expr::reads_shifted(rhs, data(), data() + m_data.size(), stride(), 1)) {
+    return *this += Matrix<T, Alloc>(rhs, get_allocator());
+  }
+  T* out = data();
   for (int i = 0; i < m_rows; ++i) {
     for (int j = 0; j < m_cols; ++j) {
-      m_matrix[i][j] += rhs.m_matrix[i][j];
+      *out++ += rhs.coeff(i, j);
     }
   }
   return *this;
 }
 
-// implement + in terms of += 
-template<class T>
-Matrix<T> operator+(const Matrix<T>& lhs, const Matrix<T>& rhs) {
-  Matrix<T> result = lhs;
-  result += rhs;
-  return result;
+// rvalue operands are updated in place and returned instead of allocating a new matrix
+// (the in place updates fall back to a temporary when the other operand views it shifted).
+// this also keeps temporaries from being captured by reference in a lazy expression.
+template <class T, class Alloc, class R>
+  requires expr::Compatible<Matrix<T, Alloc>, R>
+Matrix<T, Alloc> operator+(Matrix<T, Alloc>&& lhs, const R& rhs) {
+  lhs += rhs;
+  return std::move(lhs);
 }
 
-template<class T>
-Matrix<T>& Matrix<T>::operator*=(const int rhs) {
-  for (int i = 0; i < m_rows; ++i) {
-    for (int j = 0; j < m_cols; ++j) {
-      m_matrix[i][j] *= rhs;
+// a + b == b + a, also in floating point
+template <class L, class T, class Alloc>
+  requires expr::Compatible<L, Matrix<T, Alloc>>
+Matrix<T, Alloc> operator+(const L& lhs, Matrix<T, Alloc>&& rhs) {
+  rhs += lhs;
+  return std::move(rhs);
+}
+
+template <class T, class Alloc>
+Matrix<T, Alloc> operator+(Matrix<T, Alloc>&& lhs, Matrix<T, Alloc>&& rhs) {
+  lhs += rhs;
+  return std::move(lhs);
+}
+
+template<class T, class Alloc>
+Matrix<T, Alloc>& Matrix<T, Alloc>::operator*=(const int rhs) {
+  if constexpr (std::is_same_v<T, double>) {
+    simd::scale(m_data.size(), rhs, data());
+  } else {
+    for (auto& v: m_data) {
+      v *= rhs;
     }
   }
   return *this;
 }
 
-template<class T>
-Matrix<T> operator*(const Matrix<T>& lhs, const int rhs) {  
-  Matrix<T> result = lhs;
-  result *= rhs;
-  return result;
+template <class T, class Alloc>
+Matrix<T, Alloc> operator*(Matrix<T, Alloc>&& lhs, const int rhs) {
+  lhs *= rhs;
+  return std::move(lhs);
 }
 
-template<class T>
-Matrix<T> operator*(const int lhs, const Matrix<T>& rhs) {
-  return rhs * lhs;
+template <class T, class Alloc>
+Matrix<T, Alloc> operator*(const int lhs, Matrix<T, Alloc>&& rhs) {
+  rhs *= lhs;
+  return std::move(rhs);
 }
 
 // here, we implement *= using * instead, since * creates a matrix of new dimensions. 
-template<class T>
-Matrix<T>& Matrix<T>::operator*=(const Matrix<T>& rhs) {
+template<class T, class Alloc>
+Matrix<T, Alloc>& Matrix<T, Alloc>::operator*=(const Matrix& rhs) {
   *this = *this * rhs;
   return *this;
 }
 
-template<class T>
-Matrix<T> operator*(const Matrix<T>& lhs, const Matrix<T>& rhs) {
+template<class T, class Alloc>
+Matrix<T, Alloc> operator*(const Matrix<T, Alloc>& lhs, const Matrix<T, Alloc>& rhs) {
   if (lhs.m_cols != rhs.m_rows) {
     throw std::runtime_error("Rows and cols dimension mismatch!");
   }  
-  // normal method
-  Matrix<T> result {lhs.m_rows, rhs.m_cols};
-  for (int i = 0; i < result.m_rows; ++i) {
-    for (int j = 0; j < result.m_cols; ++j) {
-      for (int k = 0; k < lhs.m_cols; ++k) {
-        result.m_matrix[i][j] += lhs.m_matrix[i][k] * rhs.m_matrix[k][j];
-      } 
+  Matrix<T, Alloc> result {lhs.m_rows, rhs.m_cols, 0, lhs.get_allocator()};
+  if constexpr (std::is_same_v<T, double> || std::is_same_v<T, float>) {
+    // packed, cache blocked kernel, see Gemm.cpp
+    kernels::gemm(lhs.m_rows, rhs.m_cols, lhs.m_cols, lhs.data(), lhs.stride(), rhs.data(), rhs.stride(), result.data(), result.stride());
+  } else {
+    // normal method, for any other T
+    const std::size_t n = result.m_cols, k_dim = lhs.m_cols;
+    for (int i = 0; i < result.m_rows; ++i) {
+      for (std::size_t j = 0; j < n; ++j) {
+        for (std::size_t k = 0; k < k_dim; ++k) {
+          result.m_data[i * n + j] += lhs.m_data[i * k_dim + k] * rhs.m_data[k * n + j];
+        } 
+      }
     }
   }
-  // other alternatives...
   return result;
 }
 
-template<class T>
-Matrix<T>& Matrix<T>::operator-=(const Matrix& rhs) {
+// lhs * rhs with control over threading for this call (e.g. {.num_threads = 4}), see Gemm.h.
+// operator* uses the default options: every thread of default_thread_pool() for large products
+template <class T, class Alloc>
+  requires (std::is_same_v<T, double> || std::is_same_v<T, float>)
+Matrix<T, Alloc> multiply(const Matrix<T, Alloc>& lhs, const Matrix<T, Alloc>& rhs, const kernels::GemmOptions& options) {
+  if (lhs.getCols() != rhs.getRows()) {
+    throw std::runtime_error("Rows and cols dimension mismatch!");
+  }
+  Matrix<T, Alloc> result {lhs.getRows(), rhs.getCols(), 0, lhs.get_allocator()};
+  kernels::gemm(lhs.getRows(), rhs.getCols(), lhs.getCols(), lhs.data(), lhs.stride(), rhs.data(), rhs.stride(),
+                result.data(), result.stride(), options);
+  return result;
+}
+
+// matrix products of expressions evaluate the operands that are not matrices yet and use
+// the Matrix product above (classes derived from Matrix go straight to it)
+template <class L, class R>
+  requires (expr::Compatible<L, R> && !(expr::MatrixType<L> && expr::MatrixType<R>))
+auto operator*(const L& lhs, const R& rhs) {
+  return expr::materialize(lhs) * expr::materialize(rhs);
+}
+
+template<class T, class Alloc>
+Matrix<T, Alloc>& Matrix<T, Alloc>::operator-=(const Matrix& rhs) {
   if (m_rows != rhs.m_rows) {
     throw std::runtime_error("Number of rows must be equal!");
   }
   if (m_cols != rhs.m_cols) {
     throw std::runtime_error("Number of columns must be equal!");
   }
+  if constexpr (std::is_same_v<T, double>) {
+    simd::sub(m_data.size(), rhs.data(), data());
+  } else {
+    for (std::size_t i = 0; i < m_data.size(); ++i) {
+      m_data[i] -= rhs.m_data[i];
+    }
+  }
+  return *this;
+}
+
+template<class T, class Alloc>
+template <expr::Expression E>
+Matrix<T, Alloc>& Matrix<T, Alloc>::operator-=(const E& rhs) {
+  if (m_rows != rhs.getRows()) {
+    throw std::runtime_error("Number of rows must be equal!");
+  }
+  if (m_cols != rhs.getCols()) {
+    throw std::runtime_error("Number of columns must be equal!");
+  }
+  if (expr::reads_shifted(rhs, data(), data() + m_data.size(), stride(), 1)) {
+    return *this -= Matrix<T, Alloc>(rhs, get_allocator());
+  }
+  T* out = data();
   for (int i = 0; i < m_rows; ++i) {
     for (int j = 0; j < m_cols; ++j) {
-      m_matrix[i][j] -= rhs.m_matrix[i][j];
+      *out++ -= rhs.coeff(i, j);
     }
   }
   return *this;
 }
 
-// implement - in terms of -= 
-template<class T>
-Matrix<T> operator-(const Matrix<T>& lhs, const Matrix<T>& rhs) {
-  Matrix<T> result = lhs;
-  result -= rhs;
+template <class T, class Alloc, class R>
+  requires expr::Compatible<Matrix<T, Alloc>, R>
+Matrix<T, Alloc> operator-(Matrix<T, Alloc>&& lhs, const R& rhs) {
+  lhs -= rhs;
+  return std::move(lhs);
+}
+
+template <class L, class T, class Alloc>
+  requires expr::Compatible<L, Matrix<T, Alloc>>
+Matrix<T, Alloc> operator-(const L& lhs, Matrix<T, Alloc>&& rhs) {
+  rhs = expr::Binary<expr::Sub, L, Matrix<T, Alloc>>{lhs, rhs};
+  return std::move(rhs);
+}
+
+template <class T, class Alloc>
+Matrix<T, Alloc> operator-(Matrix<T, Alloc>&& lhs, Matrix<T, Alloc>&& rhs) {
+  lhs -= rhs;
+  return std::move(lhs);
+}
+
+template<class T, class Alloc>
+Matrix<T, Alloc> Matrix<T, Alloc>::transpose() const& {
+  Matrix<T, Alloc> result {m_cols, m_rows, 0, get_allocator()};
+  kernels::transpose(m_rows, m_cols, m_data.data(), m_cols, result.m_data.data(), m_rows);
   return result;
 }
 
-template<class T>
-Matrix<T> Matrix<T>::transpose() const {
-  Matrix<T> result {m_cols, m_rows};
-  for (int i = 0; i < m_cols; ++i) {
-    for (int j = 0; j < m_rows; ++j) {
-      result.m_matrix[i][j] = m_matrix[j][i];
-    }
+template<class T, class Alloc>
+Matrix<T, Alloc> Matrix<T, Alloc>::transpose() && {
+  transpose_inplace();
+  return std::move(*this);
+}
+
+template<class T, class Alloc>
+Matrix<T, Alloc>& Matrix<T, Alloc>::transpose_inplace() {
+  if (m_rows == m_cols) {
+    kernels::transpose_square_inplace(m_rows, m_data.data(), m_cols);
+  } else {
+    kernels::transpose_cycles_inplace(m_rows, m_cols, m_data.data());
+    std::swap(m_rows, m_cols);
   }
-  return result;
+  return *this;
 }
 
-template <class T>
-Matrix<T> Matrix<T>::concat(const Matrix<T>& rhs, int axis) const {
+template <class T, class Alloc>
+template <expr::Expression E>
+  requires std::is_same_v<typename E::value_type, T>
+Matrix<T, Alloc> Matrix<T, Alloc>::concat(const E& rhs, int axis) const {
+  const int rhs_rows = rhs.getRows(), rhs_cols = rhs.getCols();
   // horizontal
   if (!axis) {
-    if (m_rows != rhs.m_rows) {
+    if (m_rows != rhs_rows) {
       throw std::runtime_error("Fail to join horizontally due to mismatched row number");
     }
-    Matrix<T> result = *this;
+    Matrix<T, Alloc> result {m_rows, m_cols + rhs_cols, 0, get_allocator()};
     for (int i = 0; i < m_rows; ++i) {
-      auto& left_row = result.m_matrix[i], right_row = rhs.m_matrix[i];
-      left_row.insert(left_row.end(), right_row.begin(), right_row.end());
+      const T* left_row = data() + static_cast<std::size_t>(i) * stride();
+      T* out = result.data() + static_cast<std::size_t>(i) * result.stride();
+      std::copy(left_row, left_row + m_cols, out);
+      if constexpr (expr::MatrixType<E>) {
+        const T* right_row = rhs.data() + static_cast<std::size_t>(i) * rhs.stride();
+        std::copy(right_row, right_row + rhs_cols, out + m_cols);
+      } else {
+        for (int j = 0; j < rhs_cols; ++j) {
+          out[m_cols + j] = rhs.coeff(i, j);
+        }
+      }
     }
-    result.m_cols += rhs.m_cols;
     return result;
   } else {
      // vertical
-    if (m_cols != rhs.m_cols) {
+    if (m_cols != rhs_cols) {
       throw std::runtime_error("Fail to join vertically due to mismatched col number");
     }
-    Matrix<T> result = *this;
-    auto& left_matrix = result.m_matrix, right_matrix = rhs.m_matrix;
-    left_matrix.insert(left_matrix.end(), left_matrix.begin(), left_matrix.end());
-    result.m_rows += rhs.m_rows;
+    Matrix<T, Alloc> result {*this, get_allocator()};
+    if constexpr (expr::MatrixType<E>) {
+      result.m_data.insert(result.m_data.end(), rhs.data(), rhs.data() + static_cast<std::size_t>(rhs_rows) * rhs_cols);
+    } else {
+      result.m_data.reserve(static_cast<std::size_t>(m_rows + rhs_rows) * m_cols);
+      for (int i = 0; i < rhs_rows; ++i) {
+        for (int j = 0; j < rhs_cols; ++j) {
+          result.m_data.push_back(rhs.coeff(i, j));
+        }
+      }
+    }
+    result.m_rows += rhs_rows;
     return result;
   }
 }
 
-template<class T>
-std::vector<T> Matrix<T>::flatten() const {
-  std::vector<T> vec;
-  for (const auto& row: m_matrix) {
-    vec.insert(vec.end(), row.begin(), row.end());
-  }
-  return vec;
+template<class T, class Alloc>
+std::vector<T> Matrix<T, Alloc>::flatten() const {
+  // rows are already laid out back to back
+  return std::vector<T>(m_data.begin(), m_data.end());
 }
 
-template<class T>
-const T& Matrix<T>::operator()(int r, int c) const {
+template<class T, class Alloc>
+const T& Matrix<T, Alloc>::operator()(int r, int c) const {
   if (r < 0 or r >= m_rows) {
     throw std::runtime_error("Invalid row");
   }
   if (c < 0 or c >= m_cols) {
     throw std::runtime_error("Invalid column");
   }
-  return m_matrix[r][c];
+  return m_data[static_cast<std::size_t>(r) * m_cols + c];
 }
 
-template<class T>
-T& Matrix<T>::operator()(int r, int c) {
+template<class T, class Alloc>
+T& Matrix<T, Alloc>::operator()(int r, int c) {
   if (r < 0 or r >= m_rows) {
     throw std::runtime_error("Invalid row");
   }
   if (c < 0 or c >= m_cols) {
     throw std::runtime_error("Invalid column");
   }
-  return m_matrix[r][c];
+  return m_data[static_cast<std::size_t>(r) * m_cols + c];
 }
 
 }
@@ -0,0 +1,68 @@
+#ifndef MATRIX_ANALYSIS_H
+#define MATRIX_ANALYSIS_H
+
+#include <optional>
+#include <vector>
+
+#include "Matrix.h"
+#include "Solution.h"
+#include "Vectors.h"
+
+namespace linalg {
+
+// everything that can be read off the RREF of a matrix, from a single gauss_jordan_elimination.
+// nothing is computed up front; every piece is computed on first access and kept:
+//
+// auto analysis = analyze(A);
+// if (analysis.rank() < A.getCols()) {
+//   auto& kernel = analysis.null_space();   // reuses the RREF computed for rank()
+// }
+//
+// rank() counts the pivots of the RREF (entries below THRESHOLD are zero), so it always matches
+// the bases.
+// the caches make the const accessors not thread safe, use one analysis per thread.
+class MatrixAnalysis {
+  public:
+    explicit MatrixAnalysis(Matrix<double> matrix, const EliminationOptions& options={})
+      : m_matrix{std::move(matrix)}, m_options{options}
+    {}
+
+    const Matrix<double>& matrix() const {return m_matrix;}
+
+    const Matrix<double>& rref() const;
+
+    // columns holding a pivot of the RREF, in increasing order
+    const std::vector<int>& pivot_columns() const;
+
+    int rank() const {return pivot_columns().size();}
+
+    // same as get_row_space: the nonzero rows of the RREF
+    const TwoDVector<double>& row_space() const;
+
+    // same as get_col_space: the pivot columns of the RREF
+    const TwoDVector<double>& col_space() const;
+
+    // basis of {x : Ax = 0}, one vector per non pivot column f: x_f = 1, the other non pivot
+    // entries 0 and the pivot entries read off the RREF. empty when the columns are independent
+    const TwoDVector<double>& null_space() const;
+
+    // for an augmented matrix [A | b], same as get_solution_type on its RREF
+    Solution::SolutionType solution_type() const;
+
+  private:
+    Matrix<double> m_matrix;
+    EliminationOptions m_options;
+    mutable std::optional<Matrix<double>> m_rref;
+    mutable std::optional<std::vector<int>> m_pivot_cols;
+    mutable std::optional<TwoDVector<double>> m_row_space;
+    mutable std::optional<TwoDVector<double>> m_col_space;
+    mutable std::optional<TwoDVector<double>> m_null_space;
+};
+
+MatrixAnalysis analyze(const Matrix<double>& matrix, const EliminationOptions& options={});
+// takes over the storage of a temporary (or std::move'd) matrix
+MatrixAnalysis analyze(Matrix<double>&& matrix, const EliminationOptions& options={});
+
+}
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef MATRIX_IO_H
+#define MATRIX_IO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Matrix.h"
+#include "MatrixView.h"
+
+// binary matrix files: a 64 byte header followed by the elements, little endian.
+//
+//   offset  size  field
+//        0     8  magic "LINALGMX"
+//        8     4  version (1)
+//       12     4  dtype (DType)
+//       16     8  rows
+//       24     8  cols
+//       32     4  layout (Layout)
+//       36     4  alignment, a power of two <= 4096
+//       40     8  data offset, a multiple of alignment (zero padding up to it)
+//       48     8  XXH64 (seed 0) of the data bytes
+//       56     8  XXH64 of the 56 bytes above
+//
+// save_binary writes one, load_binary copies it into a Matrix and MappedMatrix maps it read only,
+// so opening even a huge file costs a few page faults instead of parsing:
+//
+// save_binary(A, "A.mat");
+// MappedMatrix<double> mapped ("A.mat");
+// auto R = gaussian_elimination(mapped.view());   // elements are paged in as they are read
+namespace linalg {
+
+enum class DType : std::uint32_t {FLOAT32 = 1, FLOAT64 = 2, INT32 = 3, INT64 = 4};
+
+enum class Layout : std::uint32_t {ROW_MAJOR = 0, COL_MAJOR = 1};
+
+template <class T>
+constexpr DType dtype_of() {
+  if constexpr (std::is_same_v<T, float>) {
+    return DType::FLOAT32;
+  } else if constexpr (std::is_same_v<T, double>) {
+    return DType::FLOAT64;
+  } else if constexpr (std::is_same_v<T, std::int32_t>) {
+    return DType::INT32;
+  } else if constexpr (std::is_same_v<T, std::int64_t>) {
+    return DType::INT64;
+  } else {
+    static_assert(!sizeof(T), "Matrix files hold float, double, int32 or int64 elements");
+  }
+}
+
+// the on-disk header, see above
+struct BinaryHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t dtype;
+  std::uint64_t rows;
+  std::uint64_t cols;
+  std::uint32_t layout;
+  std::uint32_t alignment;
+  std::uint64_t data_offset;
+  std::uint64_t checksum;
+  std::uint64_t header_checksum;
+};
+
+static_assert(sizeof(BinaryHeader) == 64 && std::is_trivially_copyable_v<BinaryHeader>);
+
+struct BinaryOptions {
+  Layout layout = Layout::ROW_MAJOR;
+  // of the data offset, so mapped elements start on a cache line (or page, up to 4096)
+  std::uint32_t alignment = 64;
+};
+
+// streaming XXH64 with seed 0, four independent lanes so it keeps up with the disk
+class Checksum {
+  public:
+    Checksum();
+    void update(const void* data, std::size_t bytes);
+    std::uint64_t value() const;
+
+  private:
+    std::uint64_t m_lanes[4];
+    unsigned char m_buffer[32];
+    std::size_t m_buffered = 0;
+    std::uint64_t m_total = 0;
+};
+
+std::uint64_t checksum(const void* data, std::size_t bytes);
+
+// a read only mapping of a whole matrix file with a validated header.
+// move only, the mapping is released on destruction
+class MappedFile {
+  public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const BinaryHeader& header() const {return m_header;}
+    const std::byte* data() const {return static_cast<const std::byte*>(m_base) + m_header.data_offset;}
+    std::size_t data_bytes() const {return m_data_bytes;}
+
+    // recomputes the data checksum, this reads (and faults in) the whole file
+    bool verify() const;
+    // asks the kernel to read the data ahead of use
+    void prefetch() const;
+
+  private:
+    void* m_base = nullptr;
+    std::size_t m_size = 0;
+    std::size_t m_data_bytes = 0;
+    BinaryHeader m_header {};
+};
+
+// a matrix file mapped into memory, read through view() without copying.
+// the checksum is only checked on request, checking reads every page of the file
+template <class T>
+class MappedMatrix {
+  public:
+    explicit MappedMatrix(const std::string& path, bool verify_checksum=false) : m_file{path} {
+      if (m_file.header().dtype != static_cast<std::uint32_t>(dtype_of<T>())) {
+        throw std::runtime_error("Matrix file has a different element type!");
+      }
+      if (verify_checksum && !m_file.verify()) {
+        throw std::runtime_error("Matrix file checksum mismatch!");
+      }
+    }
+
+    int getRows() const {return static_cast<int>(m_file.header().rows);}
+    int getCols() const {return static_cast<int>(m_file.header().cols);}
+    Layout layout() const {return static_cast<Layout>(m_file.header().layout);}
+    const T* data() const {return reinterpret_cast<const T*>(m_file.data());}
+
+    // column major files are viewed through swapped strides
+    ConstMatrixView<T> view() const {
+      if (layout() == Layout::ROW_MAJOR) {
+        return ConstMatrixView<T>{data(), getRows(), getCols(), getCols()};
+      }
+      return ConstMatrixView<T>{data(), getRows(), getCols(), 1, getRows()};
+    }
+
+    bool verify() const {return m_file.verify();}
+    void prefetch() const {m_file.prefetch();}
+
+  private:
+    MappedFile m_file;
+};
+
+// writes any view (so also blocks and transposes) to path, replacing the file
+template <class T>
+void save_binary(ConstMatrixView<T> matrix, const std::string& path, const BinaryOptions& options={}) {
+  const std::uint32_t alignment = options.alignment;
+  if (alignment == 0 || alignment > 4096 || (alignment & (alignment - 1)) != 0) {
+    throw std::runtime_error("Alignment must be a power of two up to 4096!");
+  }
+  std::ofstream out (path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("Could not open " + path + " for writing!");
+  }
+  BinaryHeader header {};
+  std::memcpy(header.magic, "LINALGMX", 8);
+  header.version = 1;
+  header.dtype = static_cast<std::uint32_t>(dtype_of<T>());
+  header.rows = matrix.getRows();
+  header.cols = matrix.getCols();
+  header.layout = static_cast<std::uint32_t>(options.layout);
+  header.alignment = alignment;
+  header.data_offset = (sizeof(BinaryHeader) + alignment - 1) / alignment * alignment;
+
+  // header last, once the checksum is known
+  const std::vector<char> padding (header.data_offset, 0);
+  out.write(padding.data(), padding.size());
+  const bool row_major = options.layout == Layout::ROW_MAJOR;
+  const ConstMatrixView<T> lines = row_major ? matrix : matrix.transpose();
+  Checksum sum;
+  std::vector<T> line (lines.getCols());
+  for (int i = 0; i < lines.getRows() && lines.getCols() > 0; ++i) {
+    const T* data = &lines.coeff(i, 0);
+    if (lines.colStride() != 1) {
+      for (int j = 0; j < lines.getCols(); ++j) {
+        line[j] = lines.coeff(i, j);
+      }
+      data = line.data();
+    }
+    const std::size_t bytes = sizeof(T) * lines.getCols();
+    sum.update(data, bytes);
+    out.write(reinterpret_cast<const char*>(data), bytes);
+  }
+  header.checksum = sum.value();
+  header.header_checksum = checksum(&header, offsetof(BinaryHeader, header_checksum));
+  out.seekp(0);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (!out.flush()) {
+    throw std::runtime_error("Could not write " + path + "!");
+  }
+}
+
+template <class T>
+  requires (!std::is_const_v<T>)
+void save_binary(MatrixView<T> matrix, const std::string& path, const BinaryOptions& options={}) {
+  save_binary(ConstMatrixView<T>{matrix}, path, options);
+}
+
+template <class T, class Alloc>
+void save_binary(const Matrix<T, Alloc>& matrix, const std::string& path, const BinaryOptions& options={}) {
+  save_binary(matrix.view(), path, options);
+}
+
+// reads a whole file into a Matrix, checksum included
+template <class T>
+Matrix<T> load_binary(const std::string& path) {
+  MappedMatrix<T> mapped (path, true);
+  return Matrix<T>(mapped.view());
+}
+
+}
+
+#endif
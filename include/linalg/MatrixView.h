@@ -0,0 +1,147 @@
+#ifndef MATRIX_VIEW_H
+#define MATRIX_VIEW_H
+
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "Expression.h"
+
+namespace linalg {
+
+// non-owning window onto elements of a Matrix (or any strided buffer):
+// element (r,c) lives at data()[r * rowStride() + c * colStride()].
+// submatrices, rows, columns and transposes are all views of the same storage, nothing is copied.
+// MatrixView<const T> (ConstMatrixView<T>) is the read only version.
+//
+// note: a view must not outlive the matrix it refers to, and resizing that matrix
+// (e.g. assigning one of a different shape to it) invalidates the view.
+template <class T>
+class MatrixView {
+  public:
+    // views are a pointer and four ints, so expressions hold them by value (see Expression.h)
+    using value_type = std::remove_const_t<T>;
+    static constexpr bool is_leaf = false;
+
+    MatrixView(T* data, int rows, int cols, int row_stride, int col_stride=1)
+      : m_data{data}, m_rows{rows}, m_cols{cols}, m_row_stride{row_stride}, m_col_stride{col_stride}
+    {}
+
+    // MatrixView<T> -> MatrixView<const T>
+    template <class U>
+      requires (std::is_const_v<T> && std::is_same_v<const U, T>)
+    MatrixView(const MatrixView<U>& other)
+      : MatrixView{other.data(), other.getRows(), other.getCols(), other.rowStride(), other.colStride()}
+    {}
+
+    int getRows() const {return m_rows;}
+    int getCols() const {return m_cols;}
+    int rowStride() const {return m_row_stride;}
+    int colStride() const {return m_col_stride;}
+    T* data() const {return m_data;}
+
+    // rows are contiguous runs of elements, e.g. for handing them to kernels
+    bool has_contiguous_rows() const {return m_col_stride == 1;}
+
+    T& coeff(int r, int c) const {
+      return m_data[static_cast<std::ptrdiff_t>(r) * m_row_stride + static_cast<std::ptrdiff_t>(c) * m_col_stride];
+    }
+
+    // checked access, same errors as Matrix::operator()
+    T& operator()(int r, int c) const {
+      if (r < 0 or r >= m_rows) {
+        throw std::runtime_error("Invalid row");
+      }
+      if (c < 0 or c >= m_cols) {
+        throw std::runtime_error("Invalid column");
+      }
+      return coeff(r, c);
+    }
+
+    // rows [r, r + rows) and cols [c, c + cols) of this view
+    MatrixView block(int r, int c, int rows, int cols) const {
+      if (r < 0 || rows < 0 || r + rows > m_rows) {
+        throw std::runtime_error("Invalid row");
+      }
+      if (c < 0 || cols < 0 || c + cols > m_cols) {
+        throw std::runtime_error("Invalid column");
+      }
+      return MatrixView{&coeff(r, c), rows, cols, m_row_stride, m_col_stride};
+    }
+
+    // 1 x cols
+    MatrixView row(int r) const {return block(r, 0, 1, m_cols);}
+
+    // rows x 1
+    MatrixView col(int c) const {return block(0, c, m_rows, 1);}
+
+    MatrixView transpose() const {
+      return MatrixView{m_data, m_cols, m_rows, m_col_stride, m_row_stride};
+    }
+
+    // see expr::reads_shifted. strides are never negative, so data() is the first viewed element
+    bool reads_shifted(const value_type* begin, const value_type* end, int row_stride, int col_stride) const {
+      if (m_rows == 0 || m_cols == 0) {
+        return false;
+      }
+      const std::less<const value_type*> before;
+      if (before(&coeff(m_rows - 1, m_cols - 1), begin) || !before(m_data, end)) {
+        return false;
+      }
+      return m_data != begin || m_row_stride != row_stride || m_col_stride != col_stride;
+    }
+
+    // copies the viewed elements row by row
+    std::vector<value_type> flatten() const {
+      std::vector<value_type> result;
+      result.reserve(static_cast<std::size_t>(m_rows) * m_cols);
+      for (int i = 0; i < m_rows; ++i) {
+        for (int j = 0; j < m_cols; ++j) {
+          result.push_back(coeff(i, j));
+        }
+      }
+      return result;
+    }
+
+    Matrix<value_type> eval() const {return Matrix<value_type>(*this);}
+
+    // writes an expression of the same shape into the viewed elements.
+    // (i, j) is written after reading (i, j) of the operands, so the expression may read this
+    // view itself; overlapping views with other strides (e.g. its own transpose) go through a copy.
+    template <expr::Expression E>
+      requires (!std::is_const_v<T> && std::is_same_v<typename E::value_type, value_type>)
+    const MatrixView& assign(const E& expr) const {
+      if (expr.getRows() != m_rows) {
+        throw std::runtime_error("Number of rows must be equal!");
+      }
+      if (expr.getCols() != m_cols) {
+        throw std::runtime_error("Number of columns must be equal!");
+      }
+      if (m_rows > 0 && m_cols > 0
+          && expr::reads_shifted(expr, m_data, &coeff(m_rows - 1, m_cols - 1) + 1, m_row_stride, m_col_stride)) {
+        return assign(Matrix<value_type>(expr));
+      }
+      for (int i = 0; i < m_rows; ++i) {
+        for (int j = 0; j < m_cols; ++j) {
+          coeff(i, j) = expr.coeff(i, j);
+        }
+      }
+      return *this;
+    }
+
+  private:
+    T* m_data;
+    int m_rows;
+    int m_cols;
+    int m_row_stride;
+    int m_col_stride;
+};
+
+template <class T>
+using ConstMatrixView = MatrixView<const T>;
+
+}
+
+#endif
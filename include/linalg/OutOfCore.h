@@ -0,0 +1,105 @@
+#ifndef OUT_OF_CORE_H
+#define OUT_OF_CORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Gemm.h"
+#include "Solution.h"
+
+// LU of matrices larger than memory, read from a matrix file (MatrixIO.h):
+//
+// OutOfCoreLU lu ("A.mat", {.memory_budget = 2L << 30});
+// auto x = lu.solve(b);   // same SystemSolution as solve_linear_system(A, b)
+// std::cout << lu.io_stats().bytes_read;
+//
+// the matrix is copied once into a scratch file of column panels (column major), then factored
+// left looking: panel j is read, updated with every earlier panel streamed from disk, factored
+// and written back. only a few panels are in memory at a time, and the next panel is always
+// being read in the background while the current one is used.
+//
+// pivots are chosen as in LUFactorization (largest absolute value, columns without one above
+// THRESHOLD are skipped), so rank, pivot columns and solution types match the in-memory path.
+namespace linalg {
+
+struct OutOfCoreOptions {
+  // bytes for panel buffers, the panel width follows from it (four panels are kept in memory)
+  std::size_t memory_budget = std::size_t{1} << 30;
+  // fixed panel width instead of the one from memory_budget
+  int panel_cols = 0;
+  // where the factors go, "" -> the input path + ".lu". the file is unlinked as soon as it is
+  // created, so it disappears with the factorization even if the process dies
+  std::string scratch_path;
+  // for the trailing updates of every panel
+  kernels::GemmOptions gemm = {};
+};
+
+// disk traffic so far: matrix file, scratch file reads and writes
+struct IOStats {
+  std::uint64_t bytes_read = 0;
+  std::uint64_t bytes_written = 0;
+  std::uint64_t panels_read = 0;
+  std::uint64_t panels_written = 0;
+  // time spent waiting for reads the prefetch did not hide
+  double stall_seconds = 0;
+};
+
+class OutOfCoreLU {
+  public:
+    explicit OutOfCoreLU(const std::string& path, const OutOfCoreOptions& options={});
+    ~OutOfCoreLU();
+
+    OutOfCoreLU(const OutOfCoreLU&) = delete;
+    OutOfCoreLU& operator=(const OutOfCoreLU&) = delete;
+
+    int getRows() const {return m_rows;}
+    int getCols() const {return m_cols;}
+    int panelCols() const {return m_panel_cols;}
+
+    int rank() const {return m_pivot_cols.size();}
+
+    // column of the pivot of every nonzero row of U
+    const std::vector<int>& pivot_columns() const {return m_pivot_cols;}
+
+    // row i of PA is row permutation()[i] of A
+    std::vector<int> permutation() const;
+
+    // both stream the factors from disk once (solve twice: forward and backward)
+    Solution::SolutionType solution_type(const std::vector<double>& b) const;
+    Solution::SystemSolution solve(const std::vector<double>& b) const;
+
+    const IOStats& io_stats() const {return m_stats;}
+
+  private:
+    struct Panel {
+      int first_col;
+      int cols;
+      // pivot rows of this panel are [first_row, first_row + pivots)
+      int first_row;
+      int pivots;
+      // row swaps done while factoring it, in order
+      std::vector<std::pair<int, int>> swaps;
+    };
+
+    void convert(const std::string& path);
+    void factor();
+    // y <- L^-1 P y, panel by panel
+    void forward(std::vector<double>& y) const;
+
+    int m_rows = 0;
+    int m_cols = 0;
+    int m_panel_cols = 0;
+    int m_fd = -1;
+    std::size_t m_memory_budget;
+    kernels::GemmOptions m_gemm;
+    std::vector<Panel> m_panels;
+    std::vector<int> m_pivot_cols;
+    mutable IOStats m_stats;
+};
+
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef PARAMETRIC_SOLUTION_H
+#define PARAMETRIC_SOLUTION_H
+
+#include <span>
+#include <vector>
+
+#include "Gemm.h"
+#include "Matrix.h"
+#include "Solution.h"
+
+namespace linalg {
+
+// dense form of a SystemSolution: x = x_p + N a, where x_p is the particular solution (every free
+// variable 0) and column j of N is the null space direction of the j-th free variable (in
+// increasing order, the a1, a2, ... of the printed solution). evaluating it is a matrix vector
+// product instead of hash lookups, and many parameter vectors at once are a single gemm:
+//
+// auto S = solve_linear_system(A, b);
+// ParametricSolution x {S};
+// Matrix<double> X = x.evaluate(params);   // row i: the solution for the parameters in row i
+class ParametricSolution {
+  public:
+    // throws if the system has no solution. a unique solution has no free variables, x = x_p
+    explicit ParametricSolution(const Solution::SystemSolution& solution);
+
+    int num_variables() const {return m_particular.size();}
+    int num_free_variables() const {return m_free_variables.size();}
+
+    // the free variables in increasing order
+    const std::vector<int>& free_variables() const {return m_free_variables;}
+
+    const std::vector<double>& particular() const {return m_particular;}
+
+    // N, num_variables() x num_free_variables()
+    ConstMatrixView<double> null_space() const {
+      return ConstMatrixView<double>{m_directions.data(), num_free_variables(), num_variables(), num_variables()}.transpose();
+    }
+
+    // x_p + N a for one parameter vector, same as get_compute_function()(a)
+    std::vector<double> operator()(std::span<const double> params) const;
+
+    // one solution per row of params (count x num_free_variables()), count x num_variables()
+    Matrix<double> evaluate(ConstMatrixView<double> params, const kernels::GemmOptions& options={}) const;
+    Matrix<double> evaluate(const Matrix<double>& params, const kernels::GemmOptions& options={}) const {
+      return evaluate(params.view(), options);
+    }
+    // without this a MatrixView<double> would be equally convertible to both of the above
+    Matrix<double> evaluate(MatrixView<double> params, const kernels::GemmOptions& options={}) const {
+      return evaluate(ConstMatrixView<double>{params}, options);
+    }
+
+    // same, written to row i of out (count x num_variables(), contiguous rows) without allocating,
+    // so a sweep can reuse one output buffer. large batches are split over the threads of
+    // options.pool, limited by options.num_threads (1 -> serial)
+    void evaluate(ConstMatrixView<double> params, MatrixView<double> out, const kernels::GemmOptions& options={}) const;
+    // the parameter vectors back to back in params and the solutions back to back in out,
+    // count = out.size() / num_variables()
+    void evaluate(std::span<const double> params, std::span<double> out, const kernels::GemmOptions& options={}) const;
+
+  private:
+    std::vector<double> m_particular;
+    // N^T, row j is the direction of free variable j, so X = params N^T reads it row major
+    std::vector<double> m_directions;
+    std::vector<int> m_free_variables;
+};
+
+}
+
+#endif
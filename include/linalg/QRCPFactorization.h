@@ -0,0 +1,67 @@
+#ifndef QRCP_FACTORIZATION_H
+#define QRCP_FACTORIZATION_H
+
+#include <vector>
+
+#include "Matrix.h"
+#include "Vectors.h"
+
+namespace linalg {
+
+struct QRCPOptions {
+  // R(i, i) counts towards the rank while |R(i, i)| > tolerance * |R(0, 0)|.
+  // 0 -> max(rows, cols) * machine epsilon
+  double tolerance = 0;
+  // stop as soon as the rank is known: rank(), column_space() and row_space() still work,
+  // Q() and R() only hold the first rank() reflectors / rows
+  bool rank_only = false;
+  // reflectors per block, the rest of the matrix is updated once per block with a matrix multiply
+  int block_size = 32;
+};
+
+// A P = Q R by Householder reflections, always pivoting the column of largest remaining norm
+// to the front (blocked as in LAPACK's dgeqp3). then |R(i, i)| is non increasing and the rank is
+// read off relative to |R(0, 0)|, which does not depend on the scale of A, unlike the
+// absolute THRESHOLD used by the eliminations.
+class QRCPFactorization {
+  public:
+    explicit QRCPFactorization(const Matrix<double>& A, const QRCPOptions& options={});
+
+    int getRows() const {return m_rows;}
+    int getCols() const {return m_cols;}
+
+    int rank() const {return m_rank;}
+
+    // column j of AP is column permutation()[j] of A
+    const std::vector<int>& permutation() const {return m_perm;}
+
+    // orthonormal basis of the column space, rank() vectors of getRows() entries
+    TwoDVector<double> column_space() const;
+
+    // basis of the row space, rank() vectors of getCols() entries: the first rank() rows of R
+    // with the columns in their original order, so sum_i column_space()[i] row_space()[i]^T ~ A
+    TwoDVector<double> row_space() const;
+
+    // thin factors of A P, k = min(rows, cols) (or the rank with rank_only, which must be > 0):
+    // Q is rows x k with orthonormal columns, R is k x cols and upper triangular
+    Matrix<double> Q() const;
+    Matrix<double> R() const;
+
+  private:
+    // first cols columns of Q, column major
+    std::vector<double> form_Q(int cols) const;
+
+    int m_rows;
+    int m_cols;
+    int m_rank = -1;
+    // reflectors computed
+    int m_steps = 0;
+    // column major: R on and above the diagonal, Householder vectors (without their leading 1) below
+    std::vector<double> m_qr;
+    std::vector<double> m_tau;
+    std::vector<int> m_perm;
+};
+
+}
+
+#endif
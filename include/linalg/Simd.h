@@ -0,0 +1,54 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstddef>
+
+// explicit SIMD kernels for the hot loops on contiguous doubles.
+// the instruction set is picked once at runtime (cpuid), so a single build of
+// linalg-lib runs the widest kernels each machine supports.
+namespace linalg::simd {
+
+enum class KernelSet {
+  SCALAR,
+  SSE2,
+  AVX2,
+  AVX512
+};
+
+// the kernel set currently used by the functions below
+KernelSet active_kernel_set();
+
+// widest kernel set supported by this cpu (and os)
+KernelSet best_kernel_set();
+
+// e.g. "avx2", handy for logging
+const char* kernel_set_name(KernelSet set);
+
+// forces a kernel set, clamped to best_kernel_set(). mostly for testing and benchmarking.
+void set_kernel_set(KernelSet set);
+
+// the element-wise kernels do not use FMA (Simd.cpp is compiled without fp contraction) and
+// round every operation exactly like the scalar code, so their results are identical on every
+// kernel set.
+// dot() reorders the sum and may differ in the last bits.
+
+// y += a * x
+void axpy(std::size_t n, double a, const double* x, double* y);
+
+// x *= a
+void scale(std::size_t n, double a, double* x);
+
+// y += x
+void add(std::size_t n, const double* x, double* y);
+
+// y -= x
+void sub(std::size_t n, const double* x, double* y);
+
+double dot(std::size_t n, const double* x, const double* y);
+
+// applies round_if_below_threshold (FloatingPoint.h) to every element
+void round_below_threshold(std::size_t n, double* x);
+
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include <set>
 #include <sstream> 
 #include <string>
+#include <utility>
 #include <unordered_map>
 
 #include "Vectors.h"
@@ -39,35 +40,33 @@ struct SystemSolution {
   std::set<int> free_variables;
   int num_free_variables;
 
+  // the values are taken in the order of the free variables (a1, a2, ...). for many parameter
+  // vectors at once, into a caller provided buffer and optionally threaded, see ParametricSolution.h
   auto get_compute_function() {
-    return [&](std::initializer_list<double> lst) -> std::vector<double> {
+    // position of every free variable in the list, looked up once instead of on every call
+    std::vector<int> free_index (m_solutions.size(), -1);
+    int index = 0;
+    for (int var: free_variables) {
+      free_index[var] = index++;
+    }
+    return [this, free_index=std::move(free_index)](std::initializer_list<double> lst) -> std::vector<double> {
       if (lst.size() != free_variables.size()) {
         throw std::runtime_error("Passed in incorrect number of values for free variables. You need to pass in " + std::to_string(free_variables.size()) + " values!");
       }
-      // create mapping from list passed in to free variables
-      std::unordered_map<int, double> free_variable_val_map; 
-      auto setIt = free_variables.begin();
-      for (auto it = lst.begin(); it != lst.end(); ++it) {
-        free_variable_val_map[*setIt] = *it;
-        ++setIt;
-      }
+      const double* values = lst.begin();
       std::vector<double> res;
+      res.reserve(m_solutions.size());
       for (std::size_t i = 0; i < m_solutions.size(); ++i) {
-        if (free_variables.contains(i)) {
-          res.emplace_back(free_variable_val_map[i]);
+        if (free_index[i] >= 0) {
+          res.emplace_back(values[free_index[i]]);
           continue;
         }
-        auto& solution = m_solutions[i];
-        if (!solution.contains_free_variables()) {
-          res.emplace_back(solution.val);
-        } else {
-          auto& map = solution.variable_count_map;
-          double acc = solution.val;
-          for (const auto& [key, val]: map) {
-            acc += val * free_variable_val_map[key];
-          }
-          res.emplace_back(acc);
+        const auto& solution = m_solutions[i];
+        double acc = solution.val;
+        for (const auto& [key, val]: solution.variable_count_map) {
+          acc += val * values[free_index[key]];
         }
+        res.emplace_back(acc);
       }
       return res;
     };
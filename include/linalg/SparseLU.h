@@ -0,0 +1,75 @@
+#ifndef SPARSE_LU_H
+#define SPARSE_LU_H
+
+#include <vector>
+
+#include "Matrix.h"
+#include "Solution.h"
+#include "SparseMatrix.h"
+
+namespace linalg {
+
+struct SparseLUOptions {
+  enum class Ordering {
+    // columns in the order they are given
+    NATURAL,
+    // approximate minimum degree on the pattern of A + A^T. best when the diagonal is a
+    // reasonable pivot (e.g. diagonally dominant or structurally symmetric matrices)
+    MINIMUM_DEGREE,
+    // the same on the pattern of A^T A (as COLAMD), which bounds the fill for any row pivoting
+    COLUMN_MINIMUM_DEGREE
+  };
+  Ordering ordering = Ordering::MINIMUM_DEGREE;
+  // threshold pivoting: the diagonal entry is kept as pivot as long as it is at least
+  // pivot_tolerance times the largest candidate in its column. smaller values keep more
+  // of the ordering's sparsity, 1 gives plain partial pivoting.
+  double pivot_tolerance = 0.1;
+};
+
+// PAQ = LU of a square sparse matrix, left looking (Gilbert-Peierls): column k of L and U comes
+// from a sparse triangular solve with the columns already factored, so the work is proportional
+// to the flops actually needed rather than n^3.
+// Q is the fill reducing column ordering, P comes from threshold partial pivoting.
+class SparseLUFactorization {
+  public:
+    explicit SparseLUFactorization(const SparseMatrix<double>& A, const SparseLUOptions& options={});
+
+    int getRows() const {return m_n;}
+    int getCols() const {return m_n;}
+
+    // false if some column had no pivot above THRESHOLD, the factorization stops there
+    bool is_invertible() const {return m_invertible;}
+
+    // solves Ax = b
+    std::vector<double> solve(const std::vector<double>& b) const;
+
+    // stored entries, including the unit diagonal of L
+    int nonZerosL() const {return m_Lx.size();}
+    int nonZerosU() const {return m_Ux.size();}
+
+    // column k of AQ is column column_order()[k] of A
+    const std::vector<int>& column_order() const {return m_q;}
+
+    // row i of A is row row_positions()[i] of PA
+    const std::vector<int>& row_positions() const {return m_pinv;}
+
+  private:
+    int m_n;
+    bool m_invertible = true;
+    std::vector<int> m_q;
+    std::vector<int> m_pinv;
+    // L and U in compressed column form. L has its unit diagonal first in every column,
+    // U has the pivot last
+    std::vector<int> m_Lp, m_Li;
+    std::vector<double> m_Lx;
+    std::vector<int> m_Up, m_Ui;
+    std::vector<double> m_Ux;
+};
+
+// same result as solve_linear_system(A.to_dense(), b). square nonsingular systems are solved with
+// the sparse LU, anything else (no solution / infinitely many) goes through the dense solver.
+Solution::SystemSolution solve_linear_system(const SparseMatrix<double>& A, const Matrix<double>& b);
+
+}
+
+#endif
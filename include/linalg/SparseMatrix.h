@@ -0,0 +1,312 @@
+#ifndef SPARSE_MATRIX_H
+#define SPARSE_MATRIX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Matrix.h"
+
+namespace linalg {
+
+// one (row, col, value) entry, used to assemble a SparseMatrix
+template <class T>
+struct Triplet {
+  int row;
+  int col;
+  T val;
+};
+
+// compressed sparse row (CSR) matrix: only nonzero entries are stored.
+// the nonzeros of row r are values()[row_offsets()[r] .. row_offsets()[r + 1]), in increasing
+// column order, with their columns in col_indices().
+// compressed sparse column (CSC) is the same layout for the transpose: the CSR arrays of
+// transpose() are the CSC arrays of this matrix.
+template <class T>
+class SparseMatrix {
+  public:
+    using value_type = T;
+
+    // all zero
+    SparseMatrix(int rows, int cols);
+
+    // duplicates are summed, entries that end up 0 are dropped
+    SparseMatrix(int rows, int cols, const std::vector<Triplet<T>>& entries);
+
+    // takes ready made CSR arrays (checked)
+    SparseMatrix(int rows, int cols, std::vector<int> row_offsets, std::vector<int> col_indices, std::vector<T> values);
+
+    // keeps the nonzero entries of a dense matrix
+    explicit SparseMatrix(const Matrix<T>& dense);
+
+    int getRows() const {return m_rows;}
+    int getCols() const {return m_cols;}
+    int nonZeros() const {return m_values.size();}
+
+    const std::vector<int>& row_offsets() const {return m_row_offsets;}
+    const std::vector<int>& col_indices() const {return m_col_indices;}
+    const std::vector<T>& values() const {return m_values;}
+
+    // element at (r,c), 0 if it is not stored
+    T operator()(int r, int c) const;
+
+    Matrix<T> to_dense() const;
+
+    SparseMatrix transpose() const;
+
+  private:
+    int m_rows = 0;
+    int m_cols = 0;
+    std::vector<int> m_row_offsets;
+    std::vector<int> m_col_indices;
+    std::vector<T> m_values;
+
+    template <class U>
+    friend SparseMatrix<U> operator*(const SparseMatrix<U>& lhs, const SparseMatrix<U>& rhs);
+};
+
+template <class T>
+SparseMatrix<T>::SparseMatrix(int rows, int cols)
+  : m_rows{rows}, m_cols{cols}, m_row_offsets(static_cast<std::size_t>(rows) + 1, 0)
+{
+  if (rows <= 0) {
+    throw std::runtime_error("rows must be > 0!");
+  }
+  if (cols <= 0) {
+    throw std::runtime_error("cols must be > 0!");
+  }
+}
+
+template <class T>
+SparseMatrix<T>::SparseMatrix(int rows, int cols, const std::vector<Triplet<T>>& entries)
+  : SparseMatrix{rows, cols}
+{
+  // counting sort by row, then sort and merge the columns of each row
+  for (const auto& e: entries) {
+    if (e.row < 0 || e.row >= rows) {
+      throw std::runtime_error("Invalid row");
+    }
+    if (e.col < 0 || e.col >= cols) {
+      throw std::runtime_error("Invalid column");
+    }
+    ++m_row_offsets[e.row + 1];
+  }
+  for (int i = 0; i < rows; ++i) {
+    m_row_offsets[i + 1] += m_row_offsets[i];
+  }
+  std::vector<std::pair<int, T>> sorted (entries.size());
+  std::vector<int> next (m_row_offsets.begin(), m_row_offsets.end() - 1);
+  for (const auto& e: entries) {
+    sorted[next[e.row]++] = {e.col, e.val};
+  }
+  int start = 0;
+  for (int i = 0; i < rows; ++i) {
+    const int end = m_row_offsets[i + 1];
+    std::sort(sorted.begin() + start, sorted.begin() + end,
+              [](const auto& a, const auto& b) {return a.first < b.first;});
+    for (int p = start; p < end; ) {
+      int col = sorted[p].first;
+      T sum = 0;
+      for (; p < end && sorted[p].first == col; ++p) {
+        sum += sorted[p].second;
+      }
+      if (sum != T{}) {
+        m_col_indices.push_back(col);
+        m_values.push_back(sum);
+      }
+    }
+    start = end;
+    m_row_offsets[i + 1] = m_values.size();
+  }
+}
+
+template <class T>
+SparseMatrix<T>::SparseMatrix(int rows, int cols, std::vector<int> row_offsets, std::vector<int> col_indices, std::vector<T> values)
+  : SparseMatrix{rows, cols}
+{
+  if (row_offsets.size() != static_cast<std::size_t>(rows) + 1 || row_offsets[0] != 0
+      || static_cast<std::size_t>(row_offsets[rows]) != col_indices.size() || col_indices.size() != values.size()) {
+    throw std::runtime_error("Inconsistent CSR arrays!");
+  }
+  for (int i = 0; i < rows; ++i) {
+    if (row_offsets[i] > row_offsets[i + 1]) {
+      throw std::runtime_error("Inconsistent CSR arrays!");
+    }
+    for (int p = row_offsets[i]; p < row_offsets[i + 1]; ++p) {
+      if (col_indices[p] < 0 || col_indices[p] >= cols || (p > row_offsets[i] && col_indices[p - 1] >= col_indices[p])) {
+        throw std::runtime_error("Column indices must be increasing within a row!");
+      }
+    }
+  }
+  m_row_offsets = std::move(row_offsets);
+  m_col_indices = std::move(col_indices);
+  m_values = std::move(values);
+}
+
+template <class T>
+SparseMatrix<T>::SparseMatrix(const Matrix<T>& dense)
+  : SparseMatrix{dense.getRows(), dense.getCols()}
+{
+  for (int i = 0; i < m_rows; ++i) {
+    const T* row = dense.data() + static_cast<std::size_t>(i) * dense.stride();
+    for (int j = 0; j < m_cols; ++j) {
+      if (row[j] != T{}) {
+        m_col_indices.push_back(j);
+        m_values.push_back(row[j]);
+      }
+    }
+    m_row_offsets[i + 1] = m_values.size();
+  }
+}
+
+template <class T>
+T SparseMatrix<T>::operator()(int r, int c) const {
+  if (r < 0 or r >= m_rows) {
+    throw std::runtime_error("Invalid row");
+  }
+  if (c < 0 or c >= m_cols) {
+    throw std::runtime_error("Invalid column");
+  }
+  auto begin = m_col_indices.begin() + m_row_offsets[r], end = m_col_indices.begin() + m_row_offsets[r + 1];
+  auto it = std::lower_bound(begin, end, c);
+  return it != end && *it == c ? m_values[it - m_col_indices.begin()] : T{};
+}
+
+template <class T>
+Matrix<T> SparseMatrix<T>::to_dense() const {
+  Matrix<T> result {m_rows, m_cols};
+  for (int i = 0; i < m_rows; ++i) {
+    T* row = result.data() + static_cast<std::size_t>(i) * result.stride();
+    for (int p = m_row_offsets[i]; p < m_row_offsets[i + 1]; ++p) {
+      row[m_col_indices[p]] = m_values[p];
+    }
+  }
+  return result;
+}
+
+template <class T>
+SparseMatrix<T> SparseMatrix<T>::transpose() const {
+  SparseMatrix<T> result {m_cols, m_rows};
+  result.m_col_indices.resize(m_values.size());
+  result.m_values.resize(m_values.size());
+  for (int c: m_col_indices) {
+    ++result.m_row_offsets[c + 1];
+  }
+  for (int j = 0; j < m_cols; ++j) {
+    result.m_row_offsets[j + 1] += result.m_row_offsets[j];
+  }
+  // walking the rows in order keeps the columns of the result sorted
+  std::vector<int> next (result.m_row_offsets.begin(), result.m_row_offsets.end() - 1);
+  for (int i = 0; i < m_rows; ++i) {
+    for (int p = m_row_offsets[i]; p < m_row_offsets[i + 1]; ++p) {
+      int q = next[m_col_indices[p]]++;
+      result.m_col_indices[q] = i;
+      result.m_values[q] = m_values[p];
+    }
+  }
+  return result;
+}
+
+// sparse x dense
+template <class T>
+Matrix<T> operator*(const SparseMatrix<T>& lhs, const Matrix<T>& rhs) {
+  if (lhs.getCols() != rhs.getRows()) {
+    throw std::runtime_error("Rows and cols dimension mismatch!");
+  }
+  const int cols = rhs.getCols();
+  Matrix<T> result {lhs.getRows(), cols};
+  for (int i = 0; i < lhs.getRows(); ++i) {
+    T* out = result.data() + static_cast<std::size_t>(i) * result.stride();
+    for (int p = lhs.row_offsets()[i]; p < lhs.row_offsets()[i + 1]; ++p) {
+      const T a = lhs.values()[p];
+      const T* row = rhs.data() + static_cast<std::size_t>(lhs.col_indices()[p]) * rhs.stride();
+      for (int j = 0; j < cols; ++j) {
+        out[j] += a * row[j];
+      }
+    }
+  }
+  return result;
+}
+
+// dense x sparse
+template <class T>
+Matrix<T> operator*(const Matrix<T>& lhs, const SparseMatrix<T>& rhs) {
+  if (lhs.getCols() != rhs.getRows()) {
+    throw std::runtime_error("Rows and cols dimension mismatch!");
+  }
+  Matrix<T> result {lhs.getRows(), rhs.getCols()};
+  for (int i = 0; i < lhs.getRows(); ++i) {
+    const T* row = lhs.data() + static_cast<std::size_t>(i) * lhs.stride();
+    T* out = result.data() + static_cast<std::size_t>(i) * result.stride();
+    for (int k = 0; k < lhs.getCols(); ++k) {
+      if (row[k] == T{}) {
+        continue;
+      }
+      for (int p = rhs.row_offsets()[k]; p < rhs.row_offsets()[k + 1]; ++p) {
+        out[rhs.col_indices()[p]] += row[k] * rhs.values()[p];
+      }
+    }
+  }
+  return result;
+}
+
+// sparse matrix x vector
+template <class T>
+std::vector<T> operator*(const SparseMatrix<T>& lhs, const std::vector<T>& rhs) {
+  if (static_cast<std::size_t>(lhs.getCols()) != rhs.size()) {
+    throw std::runtime_error("Rows and cols dimension mismatch!");
+  }
+  std::vector<T> result (lhs.getRows());
+  for (int i = 0; i < lhs.getRows(); ++i) {
+    T sum = 0;
+    for (int p = lhs.row_offsets()[i]; p < lhs.row_offsets()[i + 1]; ++p) {
+      sum += lhs.values()[p] * rhs[lhs.col_indices()[p]];
+    }
+    result[i] = sum;
+  }
+  return result;
+}
+
+// sparse x sparse, row by row with a dense accumulator (Gustavson)
+template <class T>
+SparseMatrix<T> operator*(const SparseMatrix<T>& lhs, const SparseMatrix<T>& rhs) {
+  if (lhs.getCols() != rhs.getRows()) {
+    throw std::runtime_error("Rows and cols dimension mismatch!");
+  }
+  SparseMatrix<T> result {lhs.getRows(), rhs.getCols()};
+  std::vector<T> acc (rhs.getCols());
+  // marker[j] == i while column j is part of row i of the result
+  std::vector<int> marker (rhs.getCols(), -1);
+  std::vector<int> pattern;
+  for (int i = 0; i < lhs.getRows(); ++i) {
+    pattern.clear();
+    for (int p = lhs.m_row_offsets[i]; p < lhs.m_row_offsets[i + 1]; ++p) {
+      const int k = lhs.m_col_indices[p];
+      const T a = lhs.m_values[p];
+      for (int q = rhs.m_row_offsets[k]; q < rhs.m_row_offsets[k + 1]; ++q) {
+        const int j = rhs.m_col_indices[q];
+        if (marker[j] != i) {
+          marker[j] = i;
+          acc[j] = 0;
+          pattern.push_back(j);
+        }
+        acc[j] += a * rhs.m_values[q];
+      }
+    }
+    std::sort(pattern.begin(), pattern.end());
+    for (int j: pattern) {
+      if (acc[j] != T{}) {
+        result.m_col_indices.push_back(j);
+        result.m_values.push_back(acc[j]);
+      }
+    }
+    result.m_row_offsets[i + 1] = result.m_values.size();
+  }
+  return result;
+}
+
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef STRASSEN_H
+#define STRASSEN_H
+
+#include <cstddef>
+
+#include "Gemm.h"
+#include "Matrix.h"
+
+// Strassen-Winograd multiplication: 7 half-size products and 15 additions per level instead
+// of 8 products, about O(n^2.81) operations. worth it for large products only, below the
+// crossover the blocked kernel (Gemm.h) is faster, so the recursion stops there.
+//
+// accuracy: the error is bounded normwise, not elementwise like the classical product.
+// for n x n matrices recursing down to n0 (Higham, Accuracy and Stability of Numerical
+// Algorithms, 2nd ed., ch. 23), with u = 2^-53 and ||.|| the largest absolute entry:
+//   classical:  |C - C'| <= n u |A| |B|                   (every entry)
+//   winograd:   ||C - C'|| <= [(n / n0)^log2(18) (n0^2 + 6 n0) - 6 n] u ||A|| ||B||
+// so every level of recursion costs up to 18 / 4 = 4.5 times more error bound, and entries
+// much smaller than ||A|| ||B|| can lose all their relative accuracy. in practice the error
+// is far below the bound; use the classical product when small entries matter.
+namespace linalg {
+
+struct StrassenOptions {
+  // products with a dimension at or below this go to the blocked kernel
+  int crossover = 256;
+  // threading of those base products
+  kernels::GemmOptions gemm = {};
+};
+
+namespace kernels {
+
+// scratch space (in doubles) strassen_gemm needs for these sizes: about (m max(k, n) + k n) / 3
+std::size_t strassen_workspace(int m, int n, int k, int crossover);
+
+// C (m x n) = A (m x k) * B (k x n), overwriting C. odd sizes are handled by peeling off the
+// last row / column and fixing them up with the blocked kernel. work holds at least
+// strassen_workspace(m, n, k, crossover) doubles, nullptr -> allocated here.
+void strassen_gemm(int m, int n, int k, const double* A, int lda, const double* B, int ldb, double* C, int ldc,
+                   const StrassenOptions& options={}, double* work=nullptr);
+
+}
+
+// A * B, see above. any shapes work, but only large square-ish products gain anything
+Matrix<double> strassen_multiply(const Matrix<double>& A, const Matrix<double>& B, const StrassenOptions& options={});
+
+}
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace linalg {
+
+// a small fixed size pool for data parallel loops. the calling thread always
+// takes part in the work, so a pool of size n runs n - 1 worker threads.
+class ThreadPool {
+  public:
+    explicit ThreadPool(int num_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const {return m_size;}
+
+    // calls fn(begin, end) on disjoint chunks covering [0, n) and blocks until all are done.
+    // chunks are at least grain long. with static_schedule, participant i always gets the
+    // i-th contiguous slice; otherwise every participant starts on its own contiguous run of
+    // chunks and, once that is done, steals half of what is left of another participant's run.
+    // max_threads limits the participants of this loop (0 -> all of them).
+    // calls made from inside a running loop execute serially on the calling thread.
+    // if fn throws (on any thread), no further chunks are started, the loop waits for the
+    // chunks already running and then rethrows the first exception on the calling thread.
+    void parallel_for(int n, int grain, const std::function<void(int, int)>& fn, bool static_schedule=false,
+                      int max_threads=0);
+
+  private:
+    // chunks [begin, end) not yet taken from a participant's run, packed into one word so the
+    // owner (taking from the front) and thieves (taking from the back) only need a CAS
+    struct alignas(64) Run {
+      std::atomic<std::uint64_t> chunks {0};
+    };
+
+    void worker_loop(int id);
+    void run_chunks(int participant);
+    bool take_chunk(int participant, int& chunk);
+    bool steal(int participant);
+
+    int m_size;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_call_mutex; // one loop at a time
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+
+    // current loop, guarded by m_mutex
+    const std::function<void(int, int)>* m_fn = nullptr;
+    int m_n = 0;
+    int m_chunk = 0;
+    bool m_static = false;
+    int m_participants = 0;
+    std::unique_ptr<Run[]> m_runs;
+    int m_busy = 0;
+    // first exception thrown by fn in the current loop, guarded by m_mutex
+    std::exception_ptr m_error;
+    // set once m_error is, so the other participants stop taking chunks
+    std::atomic<bool> m_failed {false};
+    unsigned long m_generation = 0;
+    bool m_stop = false;
+};
+
+// the pool used when no pool is passed explicitly, sized to the hardware by default
+ThreadPool& default_thread_pool();
+
+// resizes the default pool. must not be called while it is running a loop.
+void set_num_threads(int num_threads);
+int get_num_threads();
+
+}
+
+#endif
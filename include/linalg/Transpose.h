@@ -0,0 +1,95 @@
+#ifndef TRANSPOSE_H
+#define TRANSPOSE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// transpose kernels working on raw row-major buffers (see Gemm.h for the conventions).
+namespace linalg::kernels {
+
+// tiles of TRANSPOSE_TILE x TRANSPOSE_TILE elements: source and destination tile fit in L1 together
+inline constexpr int TRANSPOSE_TILE = 32;
+
+// dst (cols x rows) = transpose of src (rows x cols).
+// cache-oblivious: halves the longer side until the block is a single tile, so every level
+// of the memory hierarchy sees blocks that fit, without tuning for a particular cache size.
+template <class T>
+void transpose(int rows, int cols, const T* src, int lds, T* dst, int ldd) {
+  if (rows <= TRANSPOSE_TILE && cols <= TRANSPOSE_TILE) {
+    for (int i = 0; i < rows; ++i) {
+      for (int j = 0; j < cols; ++j) {
+        dst[static_cast<std::size_t>(j) * ldd + i] = src[static_cast<std::size_t>(i) * lds + j];
+      }
+    }
+  } else if (rows >= cols) {
+    int half = rows / 2;
+    transpose(half, cols, src, lds, dst, ldd);
+    transpose(rows - half, cols, src + static_cast<std::size_t>(half) * lds, lds, dst + half, ldd);
+  } else {
+    int half = cols / 2;
+    transpose(rows, half, src, lds, dst, ldd);
+    transpose(rows, cols - half, src + half, lds, dst + static_cast<std::size_t>(half) * ldd, ldd);
+  }
+}
+
+// in place transpose of a square n x n block, swapping pairs of tiles across the diagonal
+template <class T>
+void transpose_square_inplace(int n, T* a, int lda) {
+  for (int bi = 0; bi < n; bi += TRANSPOSE_TILE) {
+    int ei = std::min(bi + TRANSPOSE_TILE, n);
+    // diagonal tile
+    for (int i = bi; i < ei; ++i) {
+      for (int j = i + 1; j < ei; ++j) {
+        std::swap(a[static_cast<std::size_t>(i) * lda + j], a[static_cast<std::size_t>(j) * lda + i]);
+      }
+    }
+    // tile (bi, bj) <-> tile (bj, bi)
+    for (int bj = ei; bj < n; bj += TRANSPOSE_TILE) {
+      int ej = std::min(bj + TRANSPOSE_TILE, n);
+      for (int i = bi; i < ei; ++i) {
+        for (int j = bj; j < ej; ++j) {
+          std::swap(a[static_cast<std::size_t>(i) * lda + j], a[static_cast<std::size_t>(j) * lda + i]);
+        }
+      }
+    }
+  }
+}
+
+// in place transpose of a contiguous rows x cols buffer into cols x rows.
+// follows the cycles of the permutation q -> q * cols mod (rows * cols - 1), which is where
+// the element ending up at q comes from. only needs one bit per element of extra memory.
+template <class T>
+void transpose_cycles_inplace(int rows, int cols, T* a) {
+  const std::uint64_t size = static_cast<std::uint64_t>(rows) * cols;
+  if (rows <= 1 || cols <= 1) {
+    // the buffer is already laid out the same way
+    return;
+  }
+  const std::uint64_t last = size - 1;
+  std::vector<bool> done (size, false);
+  // the first and last elements never move
+  for (std::uint64_t start = 1; start < last; ++start) {
+    if (done[start]) {
+      continue;
+    }
+    T carried = std::move(a[start]);
+    std::uint64_t q = start;
+    while (true) {
+      done[q] = true;
+      std::uint64_t from = q * cols % last;
+      if (from == start) {
+        a[q] = std::move(carried);
+        break;
+      }
+      a[q] = std::move(a[from]);
+      q = from;
+    }
+  }
+}
+
+}
+
+#endif
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <memory_resource>
+
+#include "Arena.h"
+
+namespace linalg {
+
+namespace {
+
+// alignment of the blocks taken from upstream, enough for the SIMD kernels
+constexpr std::size_t BLOCK_ALIGNMENT = 64;
+
+// smallest pool class, one cache line
+constexpr std::size_t MIN_CLASS = 64;
+
+// bytes of a block carved into pieces of one size class
+constexpr std::size_t POOL_BLOCK = 1 << 16;
+
+}
+
+MonotonicArena::MonotonicArena(std::size_t initial_size, std::pmr::memory_resource* upstream)
+  : m_upstream{upstream}, m_next_size{std::max<std::size_t>(initial_size, BLOCK_ALIGNMENT)}
+{}
+
+MonotonicArena::~MonotonicArena() {
+  for (const auto& block: m_blocks) {
+    m_upstream->deallocate(block.data, block.size, BLOCK_ALIGNMENT);
+  }
+}
+
+void MonotonicArena::release() {
+  if (m_blocks.empty()) {
+    return;
+  }
+  auto largest = std::max_element(m_blocks.begin(), m_blocks.end(), [](const Block& a, const Block& b) {
+    return a.size < b.size;
+  });
+  const Block kept = *largest;
+  for (const auto& block: m_blocks) {
+    if (block.data != kept.data) {
+      m_upstream->deallocate(block.data, block.size, BLOCK_ALIGNMENT);
+    }
+  }
+  m_blocks.assign(1, kept);
+  m_current = kept.data;
+  m_remaining = kept.size;
+  m_allocated = 0;
+}
+
+std::size_t MonotonicArena::bytes_reserved() const {
+  std::size_t total = 0;
+  for (const auto& block: m_blocks) {
+    total += block.size;
+  }
+  return total;
+}
+
+void* MonotonicArena::do_allocate(std::size_t bytes, std::size_t alignment) {
+  // zero sized allocations still need distinct addresses
+  bytes = std::max<std::size_t>(bytes, 1);
+  auto padding = [&]() {
+    return (alignment - reinterpret_cast<std::uintptr_t>(m_current) % alignment) % alignment;
+  };
+  if (m_current == nullptr || padding() + bytes > m_remaining) {
+    // the rest of the current block is abandoned
+    const std::size_t size = std::max(m_next_size, bytes + alignment);
+    m_current = static_cast<std::byte*>(m_upstream->allocate(size, BLOCK_ALIGNMENT));
+    m_blocks.push_back({m_current, size});
+    m_remaining = size;
+    m_next_size = size * 2;
+  }
+  const std::size_t skip = padding();
+  void* result = m_current + skip;
+  m_current += skip + bytes;
+  m_remaining -= skip + bytes;
+  m_allocated += bytes;
+  return result;
+}
+
+PoolArena::PoolArena(std::size_t max_pooled, std::pmr::memory_resource* upstream)
+  : m_upstream{upstream}, m_max_pooled{std::bit_ceil(std::max(max_pooled, MIN_CLASS))}
+{
+  m_free.assign(std::countr_zero(m_max_pooled) - std::countr_zero(MIN_CLASS) + 1, nullptr);
+}
+
+PoolArena::~PoolArena() {
+  release();
+}
+
+void PoolArena::release() {
+  for (const auto& block: m_blocks) {
+    m_upstream->deallocate(block.data, block.size, BLOCK_ALIGNMENT);
+  }
+  m_blocks.clear();
+  std::fill(m_free.begin(), m_free.end(), nullptr);
+}
+
+std::size_t PoolArena::bytes_reserved() const {
+  std::size_t total = 0;
+  for (const auto& block: m_blocks) {
+    total += block.size;
+  }
+  return total;
+}
+
+std::size_t PoolArena::size_class(std::size_t bytes) const {
+  if (bytes > m_max_pooled) {
+    return m_free.size();
+  }
+  return std::countr_zero(std::bit_ceil(std::max(bytes, MIN_CLASS))) - std::countr_zero(MIN_CLASS);
+}
+
+void* PoolArena::do_allocate(std::size_t bytes, std::size_t alignment) {
+  const std::size_t c = size_class(bytes);
+  if (c == m_free.size() || alignment > BLOCK_ALIGNMENT) {
+    return m_upstream->allocate(bytes, alignment);
+  }
+  if (m_free[c] == nullptr) {
+    // carve a new block into pieces of this class (pieces are multiples of 64 bytes,
+    // so they all keep the alignment of the block)
+    const std::size_t piece = MIN_CLASS << c, size = std::max(POOL_BLOCK, piece);
+    auto* data = static_cast<std::byte*>(m_upstream->allocate(size, BLOCK_ALIGNMENT));
+    m_blocks.push_back({data, size});
+    for (std::size_t offset = size; offset >= piece; offset -= piece) {
+      auto* node = reinterpret_cast<Node*>(data + offset - piece);
+      node->next = m_free[c];
+      m_free[c] = node;
+    }
+  }
+  Node* node = m_free[c];
+  m_free[c] = node->next;
+  return node;
+}
+
+void PoolArena::do_deallocate(void* p, std::size_t bytes, std::size_t alignment) {
+  const std::size_t c = size_class(bytes);
+  if (c == m_free.size() || alignment > BLOCK_ALIGNMENT) {
+    m_upstream->deallocate(p, bytes, alignment);
+    return;
+  }
+  auto* node = static_cast<Node*>(p);
+  node->next = m_free[c];
+  m_free[c] = node;
+}
+
+}
@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "BatchedSolver.h"
+#include "FloatingPoint.h"
+#include "Simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LINALG_X86 1
+#endif
+
+namespace linalg {
+
+BatchedSystems::BatchedSystems(int size, int count)
+  : m_size{size}, m_count{count}
+{
+  if (size <= 0) {
+    throw std::runtime_error("rows must be > 0!");
+  }
+  if (count < 0) {
+    throw std::runtime_error("count must be >= 0!");
+  }
+  m_A.assign(static_cast<std::size_t>(size) * size * count, 0);
+  m_b.assign(static_cast<std::size_t>(size) * count, 0);
+}
+
+std::vector<double> BatchedSolutions::solution(int system) const {
+  std::vector<double> result (size);
+  for (int i = 0; i < size; ++i) {
+    result[i] = (*this)(system, i);
+  }
+  return result;
+}
+
+namespace {
+
+// systems handled together by one call of the kernel: one AVX-512 vector or two AVX2 vectors
+constexpr int LANES = 8;
+
+// entry of LANES systems, one per lane. GCC splits it into whatever vectors the target has.
+// the alignment is explicit since by default it depends on the target the code is compiled for
+typedef double Lanes __attribute__((vector_size(LANES * sizeof(double)), aligned(64)));
+typedef long long Mask __attribute__((vector_size(LANES * sizeof(long long)), aligned(64)));
+
+// eliminates LANES systems held in a (n x n) and b (n), leaving x in b. there is no branch on
+// data, so every lane follows the same instructions: pivoting is done with selects, row c is
+// swapped with every row i below it whose entry in column c is larger, which leaves the
+// largest one in row c. lanes where a pivot is below THRESHOLD are marked in singular.
+[[gnu::always_inline]] inline void eliminate_lanes(int n, Lanes* a, Lanes* b, Mask& singular) {
+  const Lanes zero {}, one = zero + 1;
+  for (int c = 0; c < n; ++c) {
+    Lanes* pivot_row = a + c * n;
+    for (int i = c + 1; i < n; ++i) {
+      Lanes* row = a + i * n;
+      const Lanes p = pivot_row[c], q = row[c];
+      const Mask larger = (q < 0 ? -q : q) > (p < 0 ? -p : p);
+      for (int j = c; j < n; ++j) {
+        const Lanes u = pivot_row[j], v = row[j];
+        pivot_row[j] = larger ? v : u;
+        row[j] = larger ? u : v;
+      }
+      const Lanes u = b[c], v = b[i];
+      b[c] = larger ? v : u;
+      b[i] = larger ? u : v;
+    }
+    const Lanes pivot = pivot_row[c];
+    const Mask small = (pivot < 0 ? -pivot : pivot) < THRESHOLD;
+    singular |= small;
+    // keeps the lane finite, its result is thrown away
+    pivot_row[c] = small ? one : pivot;
+    const Lanes inv = one / pivot_row[c];
+    for (int i = c + 1; i < n; ++i) {
+      Lanes* row = a + i * n;
+      const Lanes factor = row[c] * inv;
+      for (int j = c + 1; j < n; ++j) {
+        row[j] -= factor * pivot_row[j];
+      }
+      b[i] -= factor * b[c];
+    }
+    // the pivot is only needed as its inverse from here on
+    pivot_row[c] = inv;
+  }
+  // back substitution
+  for (int i = n - 1; i >= 0; --i) {
+    const Lanes* row = a + i * n;
+    Lanes sum = b[i];
+    for (int j = i + 1; j < n; ++j) {
+      sum -= row[j] * b[j];
+    }
+    b[i] = sum * row[i];
+  }
+}
+
+using Kernel = void (*)(int, Lanes*, Lanes*, Mask&);
+
+void eliminate_default(int n, Lanes* a, Lanes* b, Mask& singular) {
+  eliminate_lanes(n, a, b, singular);
+}
+
+#ifdef LINALG_X86
+// same code, compiled for wider vectors
+__attribute__((target("avx2")))
+void eliminate_avx2(int n, Lanes* a, Lanes* b, Mask& singular) {
+  eliminate_lanes(n, a, b, singular);
+}
+
+__attribute__((target("avx512f")))
+void eliminate_avx512(int n, Lanes* a, Lanes* b, Mask& singular) {
+  eliminate_lanes(n, a, b, singular);
+}
+#endif
+
+// follows simd::set_kernel_set like the other kernels
+Kernel kernel() {
+#ifdef LINALG_X86
+  switch (simd::active_kernel_set()) {
+    case simd::KernelSet::AVX512:
+      return eliminate_avx512;
+    case simd::KernelSet::AVX2:
+      return eliminate_avx2;
+    default:
+      break;
+  }
+#endif
+  return eliminate_default;
+}
+
+}
+
+void solve_batched(int size, int count, std::span<const double> A, std::span<const double> b,
+                   std::span<double> x, std::span<BatchStatus> status, ThreadPool* pool) {
+  const std::size_t n = size, systems = count;
+  if (size <= 0 || count < 0) {
+    throw std::runtime_error("size must be > 0 and count >= 0!");
+  }
+  if (A.size() != n * n * systems || b.size() != n * systems || x.size() != n * systems || status.size() != systems) {
+    throw std::runtime_error("Batch buffers do not match size and count!");
+  }
+  const Kernel eliminate = kernel();
+  const int chunks = (count + LANES - 1) / LANES;
+  // a few thousand flops per task
+  const int grain = std::max(1, 16384 / (size * size * size * LANES));
+  ThreadPool& threads = pool ? *pool : default_thread_pool();
+  threads.parallel_for(chunks, grain, [&](int chunk_begin, int chunk_end) {
+    // Lanes are 64 byte aligned, more than the allocator guarantees
+    std::vector<double> buffer ((n * n + n + 1) * LANES);
+    void* start = buffer.data();
+    std::size_t space = buffer.size() * sizeof(double);
+    Lanes* a = static_cast<Lanes*>(std::align(alignof(Lanes), (n * n + n) * sizeof(Lanes), start, space));
+    Lanes* rhs = a + n * n;
+    for (int chunk = chunk_begin; chunk < chunk_end; ++chunk) {
+      const std::size_t first = static_cast<std::size_t>(chunk) * LANES;
+      const int lanes = std::min<std::size_t>(LANES, systems - first);
+      // gather the chunk, a short last chunk is padded with identity systems
+      if (lanes < LANES) {
+        std::fill(a, a + n * n + n, Lanes{});
+        for (std::size_t i = 0; i < n; ++i) {
+          a[i * n + i] += 1;
+        }
+      }
+      for (std::size_t e = 0; e < n * n; ++e) {
+        std::memcpy(&a[e], A.data() + e * systems + first, lanes * sizeof(double));
+      }
+      for (std::size_t i = 0; i < n; ++i) {
+        std::memcpy(&rhs[i], b.data() + i * systems + first, lanes * sizeof(double));
+      }
+      Mask singular {};
+      eliminate(size, a, rhs, singular);
+      for (int l = 0; l < lanes; ++l) {
+        status[first + l] = singular[l] ? BatchStatus::SINGULAR : BatchStatus::OK;
+      }
+      for (std::size_t i = 0; i < n; ++i) {
+        double* dst = x.data() + i * systems + first;
+        for (int l = 0; l < lanes; ++l) {
+          dst[l] = singular[l] ? std::numeric_limits<double>::quiet_NaN() : rhs[i][l];
+        }
+      }
+    }
+  });
+}
+
+BatchedSolutions solve_batched(const BatchedSystems& systems, ThreadPool* pool) {
+  BatchedSolutions result {
+    .size = systems.size(),
+    .count = systems.count(),
+    .x = std::vector<double>(static_cast<std::size_t>(systems.size()) * systems.count()),
+    .status = std::vector<BatchStatus>(systems.count())
+  };
+  solve_batched(systems.size(), systems.count(), systems.A_data(), systems.b_data(), result.x, result.status, pool);
+  return result;
+}
+
+}
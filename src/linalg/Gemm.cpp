@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "Gemm.h"
+#include "ThreadPool.h"
+
+// Packed, cache blocked GEMM in the style of Goto/BLIS:
+// - B is packed one KC x NC panel at a time (meant to sit in L3),
+// - A is packed one MC x KC block at a time (meant to sit in L2),
+// - a MR x NR micro-kernel keeps its tile of C in registers while it
+//   streams through the packed slivers (KC x NR of B stays in L1).
+// Packing also zero pads the ragged edges so the micro-kernel never branches.
+// Large products are cut into tiles of C (and, when C is small, panels of k) that the
+// threads of the pool work through independently, each packing into its own buffers.
+
+namespace linalg::kernels {
+
+namespace {
+
+// MR x NR accumulators have to fit in the 16 baseline vector registers,
+// MC is a multiple of MR so full blocks have no partial slivers.
+template <class T>
+struct Blocking;
+
+template <>
+struct Blocking<double> {
+  static constexpr int MR = 6, NR = 4;
+  static constexpr int MC = 120, KC = 256, NC = 2048;
+};
+
+template <>
+struct Blocking<float> {
+  static constexpr int MR = 6, NR = 8;
+  static constexpr int MC = 120, KC = 384, NC = 2048;
+};
+
+// below this many multiply-adds packing does not pay for itself
+constexpr long SMALL_GEMM = 32L * 32 * 32;
+
+// narrowest tile of C handed to a thread, narrower ones spend too much time packing
+constexpr int MIN_TILE_COLS = 64;
+
+// packing buffers of the calling thread, kept between calls
+template <class T>
+struct Workspace {
+  std::vector<T> a;
+  std::vector<T> b;
+};
+
+template <class T>
+Workspace<T>& workspace() {
+  thread_local Workspace<T> w;
+  return w;
+}
+
+int ceil_div(int a, int b) {
+  return (a + b - 1) / b;
+}
+
+int round_up(int a, int b) {
+  return ceil_div(a, b) * b;
+}
+
+// sliver layout: for every p in [0, kc), MR consecutive elements of column p
+template <class T, int MR>
+void pack_A(int mc, int kc, const T* A, int lda, T* packed) {
+  for (int i = 0; i < mc; i += MR) {
+    int rows = std::min(MR, mc - i);
+    for (int p = 0; p < kc; ++p) {
+      for (int r = 0; r < rows; ++r) {
+        packed[r] = A[static_cast<std::size_t>(i + r) * lda + p];
+      }
+      for (int r = rows; r < MR; ++r) {
+        packed[r] = 0;
+      }
+      packed += MR;
+    }
+  }
+}
+
+// sliver layout: for every p in [0, kc), NR consecutive elements of row p
+template <class T, int NR>
+void pack_B(int kc, int nc, const T* B, int ldb, T* packed) {
+  for (int j = 0; j < nc; j += NR) {
+    int cols = std::min(NR, nc - j);
+    for (int p = 0; p < kc; ++p) {
+      const T* src = B + static_cast<std::size_t>(p) * ldb + j;
+      for (int c = 0; c < cols; ++c) {
+        packed[c] = src[c];
+      }
+      for (int c = cols; c < NR; ++c) {
+        packed[c] = 0;
+      }
+      packed += NR;
+    }
+  }
+}
+
+// C (mr x nr, mr <= MR, nr <= NR) += packed A sliver * packed B sliver
+template <class T, int MR, int NR>
+void micro_kernel(int kc, const T* a, const T* b, T* C, int ldc, int mr, int nr) {
+  T acc[MR][NR] = {};
+  for (int p = 0; p < kc; ++p) {
+    for (int i = 0; i < MR; ++i) {
+      const T a_ip = a[i];
+      for (int j = 0; j < NR; ++j) {
+        acc[i][j] += a_ip * b[j];
+      }
+    }
+    a += MR;
+    b += NR;
+  }
+  for (int i = 0; i < mr; ++i) {
+    T* c_row = C + static_cast<std::size_t>(i) * ldc;
+    for (int j = 0; j < nr; ++j) {
+      c_row[j] += acc[i][j];
+    }
+  }
+}
+
+template <class T>
+void naive_gemm(int m, int n, int k, const T* A, int lda, const T* B, int ldb, T* C, int ldc) {
+  // i-k-j order so the inner loop walks rows of B and C
+  for (int i = 0; i < m; ++i) {
+    T* c_row = C + static_cast<std::size_t>(i) * ldc;
+    for (int p = 0; p < k; ++p) {
+      const T a_ip = A[static_cast<std::size_t>(i) * lda + p];
+      const T* b_row = B + static_cast<std::size_t>(p) * ldb;
+      for (int j = 0; j < n; ++j) {
+        c_row[j] += a_ip * b_row[j];
+      }
+    }
+  }
+}
+
+template <class T>
+void packed_gemm(int m, int n, int k, const T* A, int lda, const T* B, int ldb, T* C, int ldc) {
+  using B_ = Blocking<T>;
+  constexpr int MR = B_::MR, NR = B_::NR, MC = B_::MC, KC = B_::KC, NC = B_::NC;
+  // buffers are sized for full blocks, rounded up to whole slivers
+  auto& [packed_A, packed_B] = workspace<T>();
+  packed_A.resize(static_cast<std::size_t>(MC) * KC);
+  packed_B.resize(std::max(packed_B.size(), static_cast<std::size_t>(KC) * round_up(std::min(n, NC), NR)));
+  for (int jc = 0; jc < n; jc += NC) {
+    int nc = std::min(NC, n - jc);
+    for (int pc = 0; pc < k; pc += KC) {
+      int kc = std::min(KC, k - pc);
+      pack_B<T, NR>(kc, nc, B + static_cast<std::size_t>(pc) * ldb + jc, ldb, packed_B.data());
+      for (int ic = 0; ic < m; ic += MC) {
+        int mc = std::min(MC, m - ic);
+        pack_A<T, MR>(mc, kc, A + static_cast<std::size_t>(ic) * lda + pc, lda, packed_A.data());
+        for (int jr = 0; jr < nc; jr += NR) {
+          const T* b = packed_B.data() + static_cast<std::size_t>(jr) * kc;
+          for (int ir = 0; ir < mc; ir += MR) {
+            const T* a = packed_A.data() + static_cast<std::size_t>(ir) * kc;
+            T* c = C + static_cast<std::size_t>(ic + ir) * ldc + jc + jr;
+            micro_kernel<T, MR, NR>(kc, a, b, c, ldc, std::min(MR, mc - ir), std::min(NR, nc - jr));
+          }
+        }
+      }
+    }
+  }
+}
+
+template <class T>
+void blocked_gemm(int m, int n, int k, const T* A, int lda, const T* B, int ldb, T* C, int ldc, const GemmOptions& options) {
+  using B_ = Blocking<T>;
+  constexpr int NR = B_::NR, MC = B_::MC, KC = B_::KC, NC = B_::NC;
+  if (static_cast<long>(m) * n * k <= SMALL_GEMM) {
+    naive_gemm(m, n, k, A, lda, B, ldb, C, ldc);
+    return;
+  }
+  ThreadPool& pool = options.pool ? *options.pool : default_thread_pool();
+  const int threads = options.num_threads > 0 ? std::min(options.num_threads, pool.size()) : pool.size();
+  if (threads == 1 || static_cast<long>(m) * n * k < options.parallel_threshold) {
+    packed_gemm(m, n, k, A, lda, B, ldb, C, ldc);
+    return;
+  }
+
+  // tiles as large as possible (every tile packs its own panels of A and B) while still
+  // giving every thread a few, so stealing can even out the load
+  const int wanted = 4 * threads;
+  int tile_rows = round_up(m, MC), tile_cols = round_up(std::min(n, NC), NR);
+  auto tile_count = [&]() {return ceil_div(m, tile_rows) * ceil_div(n, tile_cols);};
+  while (tile_count() < wanted) {
+    if (tile_rows > MC && (tile_rows >= tile_cols || tile_cols <= MIN_TILE_COLS)) {
+      tile_rows = round_up(tile_rows / 2, MC);
+    } else if (tile_cols > MIN_TILE_COLS) {
+      tile_cols = round_up(tile_cols / 2, NR);
+    } else {
+      break;
+    }
+  }
+  const int row_tiles = ceil_div(m, tile_rows), tiles = tile_count();
+
+  // still not enough tiles (small C, long k): the panels of k are split between tasks too.
+  // split 0 adds into C, the others into zeroed buffers that are added to C afterwards
+  const int k_panels = ceil_div(k, KC);
+  int panels_per_split = k_panels;
+  if (tiles < threads) {
+    panels_per_split = ceil_div(k_panels, std::min(k_panels, ceil_div(wanted, tiles)));
+  }
+  const int splits = ceil_div(k_panels, panels_per_split);
+  const std::size_t partial_size = static_cast<std::size_t>(m) * n;
+  std::vector<T> partial (partial_size * (splits - 1));
+
+  // consecutive tasks share the same columns of B, which then stay in cache
+  pool.parallel_for(tiles * splits, 1, [&](int begin, int end) {
+    for (int task = begin; task < end; ++task) {
+      const int split = task / tiles, tile = task % tiles;
+      const int ic = tile % row_tiles * tile_rows, jc = tile / row_tiles * tile_cols;
+      const int pc = split * panels_per_split * KC;
+      const int mc = std::min(tile_rows, m - ic), nc = std::min(tile_cols, n - jc), kc = std::min(panels_per_split * KC, k - pc);
+      const T* a = A + static_cast<std::size_t>(ic) * lda + pc;
+      const T* b = B + static_cast<std::size_t>(pc) * ldb + jc;
+      if (split == 0) {
+        packed_gemm(mc, nc, kc, a, lda, b, ldb, C + static_cast<std::size_t>(ic) * ldc + jc, ldc);
+      } else {
+        T* c = partial.data() + partial_size * (split - 1) + static_cast<std::size_t>(ic) * n + jc;
+        packed_gemm(mc, nc, kc, a, lda, b, ldb, c, n);
+      }
+    }
+  }, false, threads);
+
+  if (splits > 1) {
+    pool.parallel_for(m, std::max(1, 4096 / n), [&](int row_begin, int row_end) {
+      for (int i = row_begin; i < row_end; ++i) {
+        T* c_row = C + static_cast<std::size_t>(i) * ldc;
+        for (int split = 1; split < splits; ++split) {
+          const T* p_row = partial.data() + partial_size * (split - 1) + static_cast<std::size_t>(i) * n;
+          for (int j = 0; j < n; ++j) {
+            c_row[j] += p_row[j];
+          }
+        }
+      }
+    }, false, threads);
+  }
+}
+
+}
+
+void gemm(int m, int n, int k, const double* A, int lda, const double* B, int ldb, double* C, int ldc,
+          const GemmOptions& options) {
+  blocked_gemm(m, n, k, A, lda, B, ldb, C, ldc, options);
+}
+
+void gemm(int m, int n, int k, const float* A, int lda, const float* B, int ldb, float* C, int ldc,
+          const GemmOptions& options) {
+  blocked_gemm(m, n, k, A, lda, B, ldb, C, ldc, options);
+}
+
+}
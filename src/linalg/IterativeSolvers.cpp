@@ -0,0 +1,435 @@
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "FloatingPoint.h"
+#include "IterativeSolvers.h"
+#include "Simd.h"
+
+namespace linalg {
+
+MatrixOperator::MatrixOperator(const Matrix<double>& A)
+  : m_A{A}
+{
+  if (A.getRows() != A.getCols()) {
+    throw std::runtime_error("Number of rows must equal number of columns!");
+  }
+}
+
+void MatrixOperator::apply(const std::vector<double>& x, std::vector<double>& y) const {
+  const int n = m_A.getRows();
+  for (int i = 0; i < n; ++i) {
+    y[i] = simd::dot(n, m_A.data() + static_cast<std::size_t>(i) * m_A.stride(), x.data());
+  }
+}
+
+SparseMatrixOperator::SparseMatrixOperator(const SparseMatrix<double>& A)
+  : m_A{A}
+{
+  if (A.getRows() != A.getCols()) {
+    throw std::runtime_error("Number of rows must equal number of columns!");
+  }
+}
+
+void SparseMatrixOperator::apply(const std::vector<double>& x, std::vector<double>& y) const {
+  const auto& offsets = m_A.row_offsets();
+  const auto& cols = m_A.col_indices();
+  const auto& vals = m_A.values();
+  for (int i = 0; i < m_A.getRows(); ++i) {
+    double sum = 0;
+    for (int p = offsets[i]; p < offsets[i + 1]; ++p) {
+      sum += vals[p] * x[cols[p]];
+    }
+    y[i] = sum;
+  }
+}
+
+FunctionOperator::FunctionOperator(int size, Function apply)
+  : m_size{size}, m_apply{std::move(apply)}
+{
+  if (size <= 0) {
+    throw std::runtime_error("rows must be > 0!");
+  }
+}
+
+namespace {
+
+std::vector<double> inverted(std::vector<double> diagonal) {
+  for (auto& d: diagonal) {
+    if (d == 0) {
+      throw std::runtime_error("Jacobi preconditioner needs a nonzero diagonal!");
+    }
+    d = 1 / d;
+  }
+  return diagonal;
+}
+
+std::vector<double> diagonal_of(const Matrix<double>& A) {
+  if (A.getRows() != A.getCols()) {
+    throw std::runtime_error("Number of rows must equal number of columns!");
+  }
+  std::vector<double> diagonal (A.getRows());
+  for (int i = 0; i < A.getRows(); ++i) {
+    diagonal[i] = A.coeff(i, i);
+  }
+  return diagonal;
+}
+
+std::vector<double> diagonal_of(const SparseMatrix<double>& A) {
+  if (A.getRows() != A.getCols()) {
+    throw std::runtime_error("Number of rows must equal number of columns!");
+  }
+  std::vector<double> diagonal (A.getRows());
+  for (int i = 0; i < A.getRows(); ++i) {
+    diagonal[i] = A(i, i);
+  }
+  return diagonal;
+}
+
+}
+
+JacobiPreconditioner::JacobiPreconditioner(const Matrix<double>& A)
+  : m_inv_diagonal{inverted(diagonal_of(A))}
+{}
+
+JacobiPreconditioner::JacobiPreconditioner(const SparseMatrix<double>& A)
+  : m_inv_diagonal{inverted(diagonal_of(A))}
+{}
+
+void JacobiPreconditioner::apply(const std::vector<double>& r, std::vector<double>& z) const {
+  for (std::size_t i = 0; i < r.size(); ++i) {
+    z[i] = r[i] * m_inv_diagonal[i];
+  }
+}
+
+// IKJ variant of incomplete LU: row i is eliminated with the rows above it, but only
+// entries that already exist in row i are updated (no fill)
+ILU0Preconditioner::ILU0Preconditioner(const SparseMatrix<double>& A)
+  : m_lu{A}, m_diagonal(A.getRows(), -1)
+{
+  if (A.getRows() != A.getCols()) {
+    throw std::runtime_error("Number of rows must equal number of columns!");
+  }
+  const int n = A.getRows();
+  const auto& offsets = A.row_offsets();
+  const auto& cols = A.col_indices();
+  std::vector<double> vals = A.values();
+  for (int i = 0; i < n; ++i) {
+    for (int p = offsets[i]; p < offsets[i + 1]; ++p) {
+      if (cols[p] == i) {
+        m_diagonal[i] = p;
+      }
+    }
+    if (m_diagonal[i] < 0 || vals[m_diagonal[i]] == 0) {
+      throw std::runtime_error("ILU(0) needs a nonzero diagonal!");
+    }
+  }
+  // where column j sits in the current row, -1 if it is not part of the pattern
+  std::vector<int> position (n, -1);
+  for (int i = 0; i < n; ++i) {
+    for (int p = offsets[i]; p < offsets[i + 1]; ++p) {
+      position[cols[p]] = p;
+    }
+    // columns are sorted, so every row k < i is finished before it is used
+    for (int p = offsets[i]; p < m_diagonal[i]; ++p) {
+      const int k = cols[p];
+      vals[p] /= vals[m_diagonal[k]];
+      for (int q = m_diagonal[k] + 1; q < offsets[k + 1]; ++q) {
+        if (position[cols[q]] >= 0) {
+          vals[position[cols[q]]] -= vals[p] * vals[q];
+        }
+      }
+    }
+    if (vals[m_diagonal[i]] == 0) {
+      throw std::runtime_error("ILU(0) needs a nonzero diagonal!");
+    }
+    for (int p = offsets[i]; p < offsets[i + 1]; ++p) {
+      position[cols[p]] = -1;
+    }
+  }
+  m_lu = SparseMatrix<double>{n, n, offsets, cols, std::move(vals)};
+}
+
+ILU0Preconditioner::ILU0Preconditioner(const Matrix<double>& A)
+  : ILU0Preconditioner{SparseMatrix<double>{A}}
+{}
+
+void ILU0Preconditioner::apply(const std::vector<double>& r, std::vector<double>& z) const {
+  const int n = m_lu.getRows();
+  const auto& offsets = m_lu.row_offsets();
+  const auto& cols = m_lu.col_indices();
+  const auto& vals = m_lu.values();
+  // L y = r
+  for (int i = 0; i < n; ++i) {
+    double sum = r[i];
+    for (int p = offsets[i]; p < m_diagonal[i]; ++p) {
+      sum -= vals[p] * z[cols[p]];
+    }
+    z[i] = sum;
+  }
+  // U z = y
+  for (int i = n - 1; i >= 0; --i) {
+    double sum = z[i];
+    for (int p = m_diagonal[i] + 1; p < offsets[i + 1]; ++p) {
+      sum -= vals[p] * z[cols[p]];
+    }
+    z[i] = sum / vals[m_diagonal[i]];
+  }
+}
+
+namespace {
+
+double norm(const std::vector<double>& x) {
+  return std::sqrt(simd::dot(x.size(), x.data(), x.data()));
+}
+
+double dot(const std::vector<double>& x, const std::vector<double>& y) {
+  return simd::dot(x.size(), x.data(), y.data());
+}
+
+// y += a * x
+void axpy(double a, const std::vector<double>& x, std::vector<double>& y) {
+  simd::axpy(x.size(), a, x.data(), y.data());
+}
+
+void precondition(const IterativeOptions& options, const std::vector<double>& r, std::vector<double>& z) {
+  if (options.preconditioner) {
+    options.preconditioner->apply(r, z);
+  } else {
+    z = r;
+  }
+}
+
+void check(const LinearOperator& A, const std::vector<double>& b, const IterativeOptions& options) {
+  if (static_cast<int>(b.size()) != A.size()) {
+    throw std::runtime_error("A and b need to have the same number of rows");
+  }
+  if (options.max_iterations < 0 || options.restart <= 0) {
+    throw std::runtime_error("max_iterations must be >= 0 and restart > 0!");
+  }
+}
+
+// records the residual, returns true once it is small enough
+bool record(double residual, const IterativeOptions& options, IterativeReport& report) {
+  report.residuals.push_back(residual);
+  report.converged = residual <= options.tolerance;
+  return report.converged;
+}
+
+Solution::SystemSolution finish(std::vector<double>& x, IterativeReport& report, IterativeReport* out) {
+  using namespace Solution;
+  bool converged = report.converged;
+  if (out) {
+    *out = std::move(report);
+  }
+  if (!converged) {
+    throw std::runtime_error("Iterative solver did not converge!");
+  }
+  std::vector<VariableSolution> solutions;
+  solutions.reserve(x.size());
+  for (double v: x) {
+    round_if_below_threshold(v);
+    solutions.emplace_back(VariableSolution{.val=v});
+  }
+  return SystemSolution{.type = SolutionType::ONE_SOLUTION, .m_solutions=solutions};
+}
+
+std::vector<double> column(const Matrix<double>& b) {
+  if (b.getCols() != 1) {
+    throw std::runtime_error("b must be a column matrix!");
+  }
+  return b.flatten();
+}
+
+}
+
+Solution::SystemSolution conjugate_gradient(const LinearOperator& A, const std::vector<double>& b,
+                                            const IterativeOptions& options, IterativeReport* out) {
+  check(A, b, options);
+  const int n = A.size();
+  IterativeReport report;
+  std::vector<double> x (n, 0), r = b, z (n), p (n), Ap (n);
+  const double b_norm = norm(b);
+  if (record(b_norm == 0 ? 0 : 1, options, report)) {
+    return finish(x, report, out);
+  }
+  precondition(options, r, z);
+  p = z;
+  double rz = dot(r, z);
+  while (report.iterations < options.max_iterations) {
+    A.apply(p, Ap);
+    ++report.iterations;
+    const double pAp = dot(p, Ap);
+    if (pAp <= 0) {
+      throw std::runtime_error("Conjugate gradient needs a symmetric positive definite matrix!");
+    }
+    const double alpha = rz / pAp;
+    axpy(alpha, p, x);
+    axpy(-alpha, Ap, r);
+    if (record(norm(r) / b_norm, options, report)) {
+      break;
+    }
+    precondition(options, r, z);
+    const double rz_next = dot(r, z);
+    const double beta = rz_next / rz;
+    rz = rz_next;
+    // p = z + beta * p
+    simd::scale(n, beta, p.data());
+    simd::add(n, z.data(), p.data());
+  }
+  return finish(x, report, out);
+}
+
+// restarted GMRES(m) with modified Gram-Schmidt and Givens rotations. right preconditioning
+// (A M^-1 u = b, x = M^-1 u) keeps the least squares residual equal to the true one.
+Solution::SystemSolution gmres(const LinearOperator& A, const std::vector<double>& b,
+                               const IterativeOptions& options, IterativeReport* out) {
+  check(A, b, options);
+  const int n = A.size();
+  const int m = options.restart;
+  IterativeReport report;
+  std::vector<double> x (n, 0), r (n), w (n), z (n), u (n);
+  const double b_norm = norm(b);
+  if (record(b_norm == 0 ? 0 : 1, options, report)) {
+    return finish(x, report, out);
+  }
+  std::vector<std::vector<double>> V (m + 1, std::vector<double>(n));
+  // H is (m + 1) x m, column j is stored in H[j]
+  std::vector<std::vector<double>> H (m, std::vector<double>(m + 1));
+  std::vector<double> cs (m), sn (m), g (m + 1), y (m);
+  while (report.iterations < options.max_iterations) {
+    // r = b - A x
+    A.apply(x, r);
+    for (int i = 0; i < n; ++i) {
+      r[i] = b[i] - r[i];
+    }
+    const double beta = norm(r);
+    if (beta / b_norm <= options.tolerance) {
+      report.converged = true;
+      break;
+    }
+    V[0] = r;
+    simd::scale(n, 1 / beta, V[0].data());
+    std::fill(g.begin(), g.end(), 0);
+    g[0] = beta;
+    int k = 0;
+    bool done = false;
+    while (k < m && report.iterations < options.max_iterations && !done) {
+      precondition(options, V[k], z);
+      A.apply(z, w);
+      ++report.iterations;
+      for (int i = 0; i <= k; ++i) {
+        H[k][i] = dot(w, V[i]);
+        axpy(-H[k][i], V[i], w);
+      }
+      H[k][k + 1] = norm(w);
+      // happy breakdown: the Krylov space is invariant, the solution is in it
+      const bool breakdown = H[k][k + 1] <= THRESHOLD * beta;
+      if (!breakdown) {
+        V[k + 1] = w;
+        simd::scale(n, 1 / H[k][k + 1], V[k + 1].data());
+      }
+      // bring the new column to upper triangular form
+      for (int i = 0; i < k; ++i) {
+        const double t = cs[i] * H[k][i] + sn[i] * H[k][i + 1];
+        H[k][i + 1] = -sn[i] * H[k][i] + cs[i] * H[k][i + 1];
+        H[k][i] = t;
+      }
+      const double d = std::hypot(H[k][k], H[k][k + 1]);
+      cs[k] = H[k][k] / d;
+      sn[k] = H[k][k + 1] / d;
+      H[k][k] = d;
+      H[k][k + 1] = 0;
+      g[k + 1] = -sn[k] * g[k];
+      g[k] *= cs[k];
+      ++k;
+      done = record(std::abs(g[k]) / b_norm, options, report) || breakdown;
+    }
+    // x += M^-1 V y where H y = g
+    for (int i = k - 1; i >= 0; --i) {
+      double sum = g[i];
+      for (int j = i + 1; j < k; ++j) {
+        sum -= H[j][i] * y[j];
+      }
+      y[i] = sum / H[i][i];
+    }
+    std::fill(u.begin(), u.end(), 0);
+    for (int i = 0; i < k; ++i) {
+      axpy(y[i], V[i], u);
+    }
+    precondition(options, u, z);
+    axpy(1, z, x);
+    if (report.converged) {
+      break;
+    }
+  }
+  return finish(x, report, out);
+}
+
+// right preconditioned BiCGSTAB (van der Vorst)
+Solution::SystemSolution bicgstab(const LinearOperator& A, const std::vector<double>& b,
+                                  const IterativeOptions& options, IterativeReport* out) {
+  check(A, b, options);
+  const int n = A.size();
+  IterativeReport report;
+  std::vector<double> x (n, 0), r = b, r_hat = b, p (n, 0), v (n, 0), p_hat (n), s (n), s_hat (n), t (n);
+  const double b_norm = norm(b);
+  if (record(b_norm == 0 ? 0 : 1, options, report)) {
+    return finish(x, report, out);
+  }
+  double rho = 1, alpha = 1, omega = 1;
+  while (report.iterations < options.max_iterations) {
+    ++report.iterations;
+    const double rho_next = dot(r_hat, r);
+    if (rho_next == 0 || omega == 0) {
+      // breakdown, report what we have
+      break;
+    }
+    const double beta = (rho_next / rho) * (alpha / omega);
+    rho = rho_next;
+    // p = r + beta * (p - omega * v)
+    axpy(-omega, v, p);
+    simd::scale(n, beta, p.data());
+    simd::add(n, r.data(), p.data());
+    precondition(options, p, p_hat);
+    A.apply(p_hat, v);
+    alpha = rho / dot(r_hat, v);
+    s = r;
+    axpy(-alpha, v, s);
+    axpy(alpha, p_hat, x);
+    const double s_norm = norm(s) / b_norm;
+    if (s_norm <= options.tolerance) {
+      record(s_norm, options, report);
+      break;
+    }
+    precondition(options, s, s_hat);
+    A.apply(s_hat, t);
+    const double tt = dot(t, t);
+    omega = tt == 0 ? 0 : dot(t, s) / tt;
+    axpy(omega, s_hat, x);
+    r = s;
+    axpy(-omega, t, r);
+    if (record(norm(r) / b_norm, options, report)) {
+      break;
+    }
+  }
+  return finish(x, report, out);
+}
+
+Solution::SystemSolution conjugate_gradient(const Matrix<double>& A, const Matrix<double>& b,
+                                            const IterativeOptions& options, IterativeReport* report) {
+  return conjugate_gradient(MatrixOperator{A}, column(b), options, report);
+}
+
+Solution::SystemSolution gmres(const Matrix<double>& A, const Matrix<double>& b,
+                               const IterativeOptions& options, IterativeReport* report) {
+  return gmres(MatrixOperator{A}, column(b), options, report);
+}
+
+Solution::SystemSolution bicgstab(const Matrix<double>& A, const Matrix<double>& b,
+                                  const IterativeOptions& options, IterativeReport* report) {
+  return bicgstab(MatrixOperator{A}, column(b), options, report);
+}
+
+}
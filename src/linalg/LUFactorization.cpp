@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "FloatingPoint.h"
+#include "Gemm.h"
+#include "LUFactorization.h"
+#include "Simd.h"
+
+namespace linalg {
+
+// right looking blocked LU. for every panel of block_size columns:
+// 1. factor the panel with the unblocked algorithm (only panel columns are updated),
+// 2. U12 <- L11^-1 A12 for the rows that got a pivot,
+// 3. A22 <- A22 - L21 * U12, which is where almost all the flops go.
+LUFactorization::LUFactorization(const Matrix<double>& A, int block_size)
+  : m_lu{A}, m_perm(A.getRows()), m_norm1{norm(A, NormType::ONE)}
+{
+  if (block_size <= 0) {
+    throw std::runtime_error("block size must be > 0!");
+  }
+  const int rows = m_lu.getRows(), cols = m_lu.getCols();
+  const std::size_t ld = m_lu.stride();
+  double* lu = m_lu.data();
+  auto at = [&](int i, int j) -> double& {return lu[i * ld + j];};
+  for (int i = 0; i < rows; ++i) {
+    m_perm[i] = i;
+  }
+  std::vector<double> neg_L21;
+  int r = 0;
+  for (int c0 = 0; c0 < cols && r < rows; c0 += block_size) {
+    const int c1 = std::min(cols, c0 + block_size);
+    const int r0 = r;
+    // 1. panel
+    for (int c = c0; c < c1 && r < rows; ++c) {
+      int pivot = r;
+      double max_val = std::abs(at(r, c));
+      for (int i = r + 1; i < rows; ++i) {
+        if (std::abs(at(i, c)) >= max_val) {
+          max_val = std::abs(at(i, c));
+          pivot = i;
+        }
+      }
+      if (max_val < THRESHOLD) {
+        // no pivot in this column, it is zero below the staircase
+        for (int i = r; i < rows; ++i) {
+          at(i, c) = 0;
+        }
+        continue;
+      }
+      if (pivot != r) {
+        std::swap_ranges(&at(r, 0), &at(r, 0) + cols, &at(pivot, 0));
+        std::swap(m_perm[r], m_perm[pivot]);
+        ++m_swaps;
+      }
+      m_pivot_cols.push_back(c);
+      const double* pivot_row = &at(r, 0);
+      for (int i = r + 1; i < rows; ++i) {
+        double& l = at(i, c);
+        l /= pivot_row[c];
+        simd::axpy(c1 - c - 1, -l, pivot_row + c + 1, &at(i, c + 1));
+      }
+      ++r;
+    }
+    const int p = r - r0;
+    if (p == 0 || c1 == cols) {
+      continue;
+    }
+    const int* pivot_cols = m_pivot_cols.data() + m_pivot_cols.size() - p;
+    // 2. forward substitution with the unit lower triangle of the panel
+    for (int k = 0; k < p; ++k) {
+      for (int i = k + 1; i < p; ++i) {
+        simd::axpy(cols - c1, -at(r0 + i, pivot_cols[k]), &at(r0 + k, c1), &at(r0 + i, c1));
+      }
+    }
+    // 3. trailing update. L21 is gathered (negated) since skipped columns make it non contiguous
+    const int below = rows - r;
+    if (below == 0) {
+      continue;
+    }
+    neg_L21.resize(static_cast<std::size_t>(below) * p);
+    for (int i = 0; i < below; ++i) {
+      for (int k = 0; k < p; ++k) {
+        neg_L21[static_cast<std::size_t>(i) * p + k] = -at(r + i, pivot_cols[k]);
+      }
+    }
+    kernels::gemm(below, cols - c1, p, neg_L21.data(), p, &at(r0, c1), ld, &at(r, c1), ld);
+  }
+  // columns after the last pivot row are U entries only, nothing to do
+}
+
+bool LUFactorization::is_invertible() const {
+  return getRows() == getCols() && rank() == getRows();
+}
+
+void LUFactorization::require_invertible() const {
+  if (getRows() != getCols()) {
+    throw std::runtime_error("Number of rows must equal number of columns!");
+  }
+  if (rank() != getRows()) {
+    throw std::runtime_error("Matrix is not invertible!");
+  }
+}
+
+double LUFactorization::determinant() const {
+  if (getRows() != getCols()) {
+    throw std::runtime_error("Number of rows must equal number of columns!");
+  }
+  if (rank() != getRows()) {
+    return 0;
+  }
+  double det = m_swaps % 2 ? -1 : 1;
+  for (int i = 0; i < getRows(); ++i) {
+    det *= m_lu(i, i);
+  }
+  return det;
+}
+
+LogDeterminant LUFactorization::log_determinant() const {
+  if (getRows() != getCols()) {
+    throw std::runtime_error("Number of rows must equal number of columns!");
+  }
+  if (rank() != getRows()) {
+    return LogDeterminant{0, -std::numeric_limits<double>::infinity()};
+  }
+  LogDeterminant result {m_swaps % 2 ? -1 : 1, 0};
+  for (int i = 0; i < getRows(); ++i) {
+    const double u = m_lu(i, i);
+    if (u < 0) {
+      result.sign = -result.sign;
+    }
+    result.log_abs += std::log(std::abs(u));
+  }
+  return result;
+}
+
+// the iteration of Higham, "FORTRAN codes for estimating the one-norm of a real or complex
+// matrix" (1988): ||A^-1 x||_1 over x with ||x||_1 = 1 is convex, so it is maximised at a unit
+// vector e_j, and the gradient (A^-T sign(A^-1 x)) says which one to try next. at most 5 steps
+// of 2 solves each, then one extra vector guards against matrices that fool the iteration.
+double LUFactorization::rcond() const {
+  if (getRows() != getCols()) {
+    throw std::runtime_error("Number of rows must equal number of columns!");
+  }
+  if (rank() != getRows()) {
+    return 0;
+  }
+  const int n = getRows();
+  auto norm1 = [](const std::vector<double>& v) {
+    double sum = 0;
+    for (double x: v) {
+      sum += std::abs(x);
+    }
+    return sum;
+  };
+  std::vector<double> x (n, 1.0 / n), z (n);
+  double estimate = 0;
+  int last = -1;
+  for (int step = 0; step < 5; ++step) {
+    x = solve(x);
+    const double y_norm = norm1(x);
+    if (step > 0 && y_norm <= estimate) {
+      break;
+    }
+    estimate = y_norm;
+    for (int i = 0; i < n; ++i) {
+      z[i] = x[i] >= 0 ? 1 : -1;
+    }
+    solve_transposed(z);
+    const int j = std::max_element(z.begin(), z.end(), [](double a, double b) {return std::abs(a) < std::abs(b);}) - z.begin();
+    // x was e_last; no direction improves on it
+    if (step > 0 && std::abs(z[j]) <= z[last]) {
+      break;
+    }
+    std::fill(x.begin(), x.end(), 0.0);
+    x[j] = 1;
+    last = j;
+  }
+  for (int i = 0; i < n; ++i) {
+    x[i] = (i % 2 ? -1 : 1) * (1 + (n > 1 ? static_cast<double>(i) / (n - 1) : 0));
+  }
+  estimate = std::max(estimate, 2 * norm1(solve(x)) / (3 * n));
+  return 1 / (m_norm1 * estimate);
+}
+
+void LUFactorization::substitute(double* X, int k) const {
+  const int n = getRows();
+  const std::size_t ld = m_lu.stride();
+  const double* lu = m_lu.data();
+  if (k == 1) {
+    // a single right hand side: one dot product per row instead of an axpy of length 1 per entry
+    for (int i = 1; i < n; ++i) {
+      X[i] -= simd::dot(i, lu + i * ld, X);
+    }
+    for (int i = n - 1; i >= 0; --i) {
+      const double* u_row = lu + i * ld;
+      X[i] = (X[i] - simd::dot(n - i - 1, u_row + i + 1, X + i + 1)) / u_row[i];
+    }
+    return;
+  }
+  // L y = Pb
+  for (int i = 1; i < n; ++i) {
+    const double* l_row = lu + i * ld;
+    for (int j = 0; j < i; ++j) {
+      if (l_row[j] != 0) {
+        simd::axpy(k, -l_row[j], X + static_cast<std::size_t>(j) * k, X + static_cast<std::size_t>(i) * k);
+      }
+    }
+  }
+  // U x = y
+  for (int i = n - 1; i >= 0; --i) {
+    const double* u_row = lu + i * ld;
+    double* x_i = X + static_cast<std::size_t>(i) * k;
+    for (int j = i + 1; j < n; ++j) {
+      if (u_row[j] != 0) {
+        simd::axpy(k, -u_row[j], X + static_cast<std::size_t>(j) * k, x_i);
+      }
+    }
+    simd::scale(k, 1 / u_row[i], x_i);
+  }
+}
+
+// A^T = U^T L^T P: U^T z = x forward, L^T w = z backward, then undo the row permutation
+void LUFactorization::solve_transposed(std::vector<double>& x) const {
+  const int n = getRows();
+  const std::size_t ld = m_lu.stride();
+  const double* lu = m_lu.data();
+  // row i of U is column i of U^T, so both passes run over rows of the packed matrix
+  for (int i = 0; i < n; ++i) {
+    const double* u_row = lu + i * ld;
+    x[i] /= u_row[i];
+    simd::axpy(n - i - 1, -x[i], u_row + i + 1, x.data() + i + 1);
+  }
+  for (int i = n - 1; i > 0; --i) {
+    simd::axpy(i, -x[i], lu + i * ld, x.data());
+  }
+  std::vector<double> w = x;
+  for (int i = 0; i < n; ++i) {
+    x[m_perm[i]] = w[i];
+  }
+}
+
+std::vector<double> LUFactorization::solve(const std::vector<double>& b) const {
+  require_invertible();
+  if (static_cast<int>(b.size()) != getRows()) {
+    throw std::runtime_error("A and b need to have the same number of rows");
+  }
+  std::vector<double> x(b.size());
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    x[i] = b[m_perm[i]];
+  }
+  substitute(x.data(), 1);
+  return x;
+}
+
+Matrix<double> LUFactorization::solve(const Matrix<double>& B) const {
+  require_invertible();
+  if (B.getRows() != getRows()) {
+    throw std::runtime_error("A and b need to have the same number of rows");
+  }
+  const int k = B.getCols();
+  Matrix<double> X {B.getRows(), k};
+  for (int i = 0; i < B.getRows(); ++i) {
+    const double* src = B.data() + static_cast<std::size_t>(m_perm[i]) * B.stride();
+    std::copy(src, src + k, X.data() + static_cast<std::size_t>(i) * X.stride());
+  }
+  substitute(X.data(), k);
+  return X;
+}
+
+Matrix<double> LUFactorization::inverse() const {
+  require_invertible();
+  return solve(IdentityMatrix<double>(getRows()));
+}
+
+}
@@ -1,98 +1,243 @@
+#include <algorithm>
 #include <cmath>
 #include <set>
+#include <span>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "FloatingPoint.h"
+#include "LUFactorization.h"
+#include "MatrixAnalysis.h"
 #include "Matrix.h"
+#include "QRCPFactorization.h"
+#include "Simd.h"
 #include "Solution.h"
+#include "ThreadPool.h"
 #include "Vectors.h"
 
 
 namespace linalg {
 
-int compute_max_in_col(int r, int c, const Matrix<double>& m) {
-  const TwoDVector<double>& matrix = m.m_matrix;
-  double max_val = std::abs(matrix[r][c]);
+namespace {
+
+// start of row r in the contiguous buffer
+inline double* row_ptr(Matrix<double>& m, int r) {
+  return m.data() + static_cast<std::size_t>(r) * m.stride();
+}
+
+inline const double* row_ptr(const Matrix<double>& m, int r) {
+  return m.data() + static_cast<std::size_t>(r) * m.stride();
+}
+
+// same for a view with contiguous rows
+inline double* row_ptr(const MatrixView<double>& m, int r) {
+  return m.data() + static_cast<std::ptrdiff_t>(r) * m.rowStride();
+}
+
+// runs update(i) for every row i in [begin, end), split across threads when the step
+// touches enough elements to be worth the hand-off
+template <class F>
+void for_each_row(int begin, int end, long work_per_row, const EliminationOptions& options, F&& update) {
+  int n = end - begin;
+  if (n <= 0) {
+    return;
+  }
+  if (static_cast<long>(n) * work_per_row < options.parallel_threshold) {
+    for (int i = begin; i < end; ++i) {
+      update(i);
+    }
+    return;
+  }
+  ThreadPool& pool = options.pool ? *options.pool : default_thread_pool();
+  // at least a few thousand elements per chunk
+  int grain = static_cast<int>(std::max(1L, 4096 / std::max(1L, work_per_row)));
+  pool.parallel_for(n, grain, [&](int chunk_begin, int chunk_end) {
+    for (int i = chunk_begin; i < chunk_end; ++i) {
+      update(begin + i);
+    }
+  }, options.deterministic);
+}
+
+}
+
+namespace {
+
+int max_in_col(int r, int c, ConstMatrixView<double> m) {
+  const double* col = m.data() + c;
+  const std::ptrdiff_t stride = m.rowStride();
+  double max_val = std::abs(col[r * stride]);
   int row = r;
-  for (int i = r + 1; i < m.m_rows; ++i) {
-    if (std::abs(matrix[i][c]) >= max_val) {
-      max_val = std::abs(matrix[i][c]);
+  for (int i = r + 1; i < m.getRows(); ++i) {
+    if (std::abs(col[i * stride]) >= max_val) {
+      max_val = std::abs(col[i * stride]);
       row = i; 
     } 
   }
   return row;
 }
 
+}
+
+int compute_max_in_col(int r, int c, const Matrix<double>& m) {
+  return max_in_col(r, c, m.view());
+}
+
+namespace {
+
 // * Choice of pivot: " In any case, choosing the largest possible absolute value of the pivot improves the numerical stability of the algorithm, when floating point is used for representing numbers."
-Matrix<double> gaussian_elimination(const Matrix<double>& m) {
-  auto result = m; //copy assignment is invoked
-  auto& matrix = result.m_matrix;
+// brings result (with contiguous rows) to REF in place. pivots are only looked for in the first
+// pivot_cols columns, the columns after that (e.g. right hand sides) are carried along by the row operations.
+void eliminate(MatrixView<double> result, int pivot_cols, const EliminationOptions& options) {
+  const int rows = result.getRows(), cols = result.getCols();
   int r = 0, c = 0;
-  while (r < result.m_rows && c < result.m_cols) {
+  while (r < rows && c < pivot_cols) {
     // finds the row which gives the max abs value in cth column (from rth row inclusive)
-    int row_i = compute_max_in_col(r, c, matrix);
+    int row_i = max_in_col(r, c, result);
     // if max pivot == 0, move to next col
-    if (matrix[row_i][c] == 0) {
+    if (row_ptr(result, row_i)[c] == 0) {
       ++c;
       continue;
     }
-    std::swap(matrix[r], matrix[row_i]);
-    // make everything below result[r][c] 0
-    for (int i = r + 1; i < result.m_rows; ++i) {
-      double factor = matrix[i][c] / matrix[r][c];
-      for (int j = c; j < result.m_cols; ++j) {
-        matrix[i][j] -= factor * matrix[r][j];
-        round_if_below_threshold(matrix[i][j]);
-      }
+    double* pivot_row = row_ptr(result, r);
+    if (row_i != r) {
+      std::swap_ranges(pivot_row, pivot_row + cols, row_ptr(result, row_i));
     }
+    // make everything below result[r][c] 0. rows only read the pivot row, so they are independent
+    for_each_row(r + 1, rows, cols - c, options, [&](int i) {
+      double* row = row_ptr(result, i);
+      double factor = row[c] / pivot_row[c];
+      // row[j] -= factor * pivot_row[j], then round, for j >= c
+      simd::axpy(cols - c, -factor, pivot_row + c, row + c);
+      simd::round_below_threshold(cols - c, row + c);
+    });
     ++r;
     ++c;
   }
-  return matrix;
 }
 
-Matrix<double> gauss_jordan_elimination(const Matrix<double>& m) {
-  auto result = gaussian_elimination(m);
-  auto& matrix = result.m_matrix;
+// brings a REF produced by eliminate (with the same pivot_cols) to RREF in place
+void reduce(MatrixView<double> result, int pivot_cols, const EliminationOptions& options) {
+  const int cols = result.getCols();
   int c = 0;
   // make all leading pivot elements 1 
-  for (auto it = matrix.begin(); it != matrix.end(); ++it) {
-    auto& row = *it;
-    while (row[c] == 0) {
+  for (int r = 0; r < result.getRows(); ++r) {
+    double* row = row_ptr(result, r);
+    while (c < pivot_cols && row[c] == 0) {
       ++c;
     }
+    // zero rows are at the bottom, nothing left to reduce
+    if (c == pivot_cols) {
+      break;
+    }
     // apply scaling factor
     if (row[c] != 1) {
       double factor = row[c];
-      for (int j = c; j < result.m_cols; ++j) {
+      for (int j = c; j < cols; ++j) {
         row[j] /= factor;
         round_if_below_threshold(row[j]);
       }
     }
     // make all elements above the pivot in each row 0
-    auto prev = it;
-    while (prev != matrix.begin()) {
-      --prev;
-      auto& currRow = *prev;
-      if (row[c] == 0)
-        continue;
+    for_each_row(0, r, cols - c, options, [&](int prev) {
+      double* currRow = row_ptr(result, prev);
+      if (currRow[c] == 0)
+        return;
       double factor = -currRow[c];
-      for (int j = c; j < result.m_cols; ++j) {
-        currRow[j] += factor * row[j];
-        round_if_below_threshold(currRow[j]);
-      }
-    }
+      simd::axpy(cols - c, factor, row + c, currRow + c);
+      simd::round_below_threshold(cols - c, currRow + c);
+    });
   }
+}
+
+}
+
+Matrix<double> gaussian_elimination(const Matrix<double>& m) {
+  return gaussian_elimination(m, EliminationOptions{});
+}
+
+Matrix<double> gaussian_elimination(const Matrix<double>& m, const EliminationOptions& options) {
+  auto result = m; //copy assignment is invoked
+  eliminate(result.view(), result.getCols(), options);
   return result;
 }
 
-int get_rank(const Matrix<double>& m) {
+Matrix<double> gaussian_elimination(Matrix<double>&& m, const EliminationOptions& options) {
+  eliminate(m.view(), m.getCols(), options);
+  return std::move(m);
+}
+
+void gaussian_elimination_inplace(Matrix<double>& m, const EliminationOptions& options) {
+  eliminate(m.view(), m.getCols(), options);
+}
+
+Matrix<double> gauss_jordan_elimination(const Matrix<double>& m) {
+  return gauss_jordan_elimination(m, EliminationOptions{});
+}
+
+Matrix<double> gauss_jordan_elimination(const Matrix<double>& m, const EliminationOptions& options) {
+  auto result = m;
+  eliminate(result.view(), result.getCols(), options);
+  reduce(result.view(), result.getCols(), options);
+  return result;
+}
+
+Matrix<double> gauss_jordan_elimination(Matrix<double>&& m, const EliminationOptions& options) {
+  gauss_jordan_elimination_inplace(m, options);
+  return std::move(m);
+}
+
+void gauss_jordan_elimination_inplace(Matrix<double>& m, const EliminationOptions& options) {
+  eliminate(m.view(), m.getCols(), options);
+  reduce(m.view(), m.getCols(), options);
+}
+
+namespace {
+
+// runs f on a view with contiguous rows: the view itself, or a copy that is written back
+template <class F>
+void with_contiguous_rows(MatrixView<double> m, F&& f) {
+  if (m.has_contiguous_rows()) {
+    f(m);
+    return;
+  }
+  Matrix<double> copy (m);
+  f(copy.view());
+  m.assign(copy);
+}
+
+}
+
+Matrix<double> gaussian_elimination(ConstMatrixView<double> m, const EliminationOptions& options) {
+  return gaussian_elimination(Matrix<double>(m), options);
+}
+
+Matrix<double> gauss_jordan_elimination(ConstMatrixView<double> m, const EliminationOptions& options) {
+  return gauss_jordan_elimination(Matrix<double>(m), options);
+}
+
+void gaussian_elimination_inplace(MatrixView<double> m, const EliminationOptions& options) {
+  with_contiguous_rows(m, [&](MatrixView<double> rows) {
+    eliminate(rows, rows.getCols(), options);
+  });
+}
+
+void gauss_jordan_elimination_inplace(MatrixView<double> m, const EliminationOptions& options) {
+  with_contiguous_rows(m, [&](MatrixView<double> rows) {
+    eliminate(rows, rows.getCols(), options);
+    reduce(rows, rows.getCols(), options);
+  });
+}
+
+int get_rank(const Matrix<double>& m, RankMethod method) {
+  if (method == RankMethod::QRCP) {
+    // stops as soon as the remaining columns are negligible
+    return QRCPFactorization(m, {.rank_only = true}).rank();
+  }
   auto result = gaussian_elimination(m);
-  auto& matrix = result.m_matrix;
   int r = 0, c = 0;
-  while (r < result.m_rows && c < result.m_cols) {
-    if (matrix[r][c] != 0) {
+  while (r < result.getRows() && c < result.getCols()) {
+    if (row_ptr(result, r)[c] != 0) {
       ++r;
     }
     ++c;
@@ -100,54 +245,145 @@ int get_rank(const Matrix<double>& m) {
   return r;
 }
 
-
+// both read off the RREF; MatrixAnalysis.h computes everything from a single elimination
 TwoDVector<double> get_row_space(const Matrix<double>& m) {
-  auto result = gauss_jordan_elimination(m);
-  auto& matrix = result.m_matrix;
-  int rank = get_rank(m);
-  TwoDVector<double> row_space(matrix.begin(), matrix.begin() + rank);
-  return row_space;
+  return analyze(m).row_space();
 }
 
 TwoDVector<double> get_col_space(const Matrix<double>& m) {
-  TwoDVector<double> col_space;
-  auto result = gauss_jordan_elimination(m);
-  auto& matrix = result.m_matrix;
-  std::vector<int> col_idxs;
-  int r = 0, c = 0;
-  while (r < result.m_rows && c < result.m_cols) {
-    if (matrix[r][c] != 0) {
-      col_idxs.emplace_back(c);
-      ++r;
-    } 
-    ++c;
-  }
-  for (auto i: col_idxs) {
-    std::vector<double> col_vec;
-    for (int j = 0; j < result.m_rows; ++j) {
-      col_vec.emplace_back(matrix[j][i]);
-    }
-    col_space.emplace_back(std::move(col_vec));
-  }
-  return col_space;
+  return analyze(m).col_space();
 }
 
 Matrix<double> inverse(const Matrix<double>& matrix) {
   if (matrix.m_rows != matrix.m_cols) {
     throw std::runtime_error("Number of rows must equal number of columns!");
   }
-  if (get_rank(matrix) != matrix.m_rows) {
+  // one factorization both decides invertibility and produces the inverse
+  LUFactorization lu {matrix};
+  if (!lu.is_invertible()) {
     throw std::runtime_error("Matrix is not invertible!");
   }
-  int rank = matrix.m_rows;
-  auto augmented_matrix = matrix.concat(IdentityMatrix<double>(rank));
-  auto result = gauss_jordan_elimination(augmented_matrix);
-  TwoDVector<double> vec;
-  for (int i = 0; i < rank; i++) {
-    std::vector<double> v(result.m_matrix[i].begin() + rank, result.m_matrix[i].end());
-    vec.emplace_back(std::move(v));
+  return lu.inverse();
+}
+
+double determinant(const Matrix<double>& matrix) {
+  return LUFactorization{matrix}.determinant();
+}
+
+double norm(ConstMatrixView<double> m, NormType type) {
+  const int rows = m.getRows(), cols = m.getCols();
+  double result = 0;
+  switch (type) {
+    case NormType::ONE: {
+      // row by row, so row major storage is read in order
+      std::vector<double> col_sums (cols, 0.0);
+      for (int i = 0; i < rows; ++i) {
+        for (int j = 0; j < cols; ++j) {
+          col_sums[j] += std::abs(m.coeff(i, j));
+        }
+      }
+      result = col_sums.empty() ? 0 : *std::max_element(col_sums.begin(), col_sums.end());
+      break;
+    }
+    case NormType::INF:
+      for (int i = 0; i < rows; ++i) {
+        double sum = 0;
+        for (int j = 0; j < cols; ++j) {
+          sum += std::abs(m.coeff(i, j));
+        }
+        result = std::max(result, sum);
+      }
+      break;
+    case NormType::FROBENIUS:
+      for (int i = 0; i < rows; ++i) {
+        if (m.has_contiguous_rows()) {
+          const double* row = &m.coeff(i, 0);
+          result += simd::dot(cols, row, row);
+        } else {
+          for (int j = 0; j < cols; ++j) {
+            result += m.coeff(i, j) * m.coeff(i, j);
+          }
+        }
+      }
+      result = std::sqrt(result);
+      break;
+  }
+  return result;
+}
+
+namespace {
+
+// reads the solution for the right hand side in column rhs_col off the RREF of [A | B],
+// where only the first num_variables columns were allowed to hold pivots
+Solution::SystemSolution extract_solution(const Matrix<double>& RREF, int num_variables, int rhs_col) {
+  using namespace Solution;
+  auto matrix = [&RREF](int i, int j) {return row_ptr(RREF, i)[j];};
+
+  std::set<int> pivot_cols;
+  std::set<int> non_pivot_cols;
+  std::unordered_map<int, int> pivot_col_to_row_map;
+
+  int r = 0, c = 0;
+  while (r < RREF.getRows() && c < num_variables) {
+    if (matrix(r, c) != 0) {
+      pivot_cols.insert(c);
+      pivot_col_to_row_map[c] = r;
+      ++r;
+    }
+    ++c;
+  }
+  // inconsistent if a zero row of A is not zero in b, i.e. b would have been a pivot column
+  for (int i = r; i < RREF.getRows(); ++i) {
+    if (matrix(i, rhs_col) != 0) {
+      return SystemSolution{.type = SolutionType::NO_SOLUTION};
+    }
+  }
+  if (r == num_variables) {
+    std::vector<VariableSolution> solutions;
+    for (int i = 0; i < num_variables; ++i) {
+      solutions.emplace_back(VariableSolution{.val=matrix(i, rhs_col)});
+    }
+    return SystemSolution{.type = SolutionType::ONE_SOLUTION, .m_solutions=solutions};
   }
-  return vec;
+
+  for (int i = 0; i < num_variables; ++i) {
+    if (!pivot_cols.contains(i)) {
+      non_pivot_cols.insert(i);
+    }
+  }
+
+  std::unordered_map<int, VariableSolution> solutionMap; 
+  std::vector<VariableSolution> solutions;
+
+  // iterate backwards - bottom up DP :)
+  for (auto it = pivot_cols.rbegin(); it != pivot_cols.rend(); ++it) {
+    int currCol = *it; 
+    int currRow = pivot_col_to_row_map[currCol];
+    double rhsVal = matrix(currRow, rhs_col);
+    //value component
+    for (int c = currCol + 1; c < num_variables; ++c) {
+      if (matrix(currRow, c) == 0) continue;
+      // if non pivot, easy! just deduct the free variable.
+      auto& currMap = solutionMap[currCol].variable_count_map;
+      if (non_pivot_cols.contains(c)) {
+        currMap[c] -= matrix(currRow, c);
+      } else {
+        // if pivot, do some math. 
+        solutionMap[currCol].val -= solutionMap[c].val * matrix(currRow, c);
+        for (const auto& [key, val]: currMap) {
+          if (val == 0) continue;
+          currMap[key] -= val * matrix(currRow, c);
+        }
+      }
+    }
+    solutionMap[currCol].val += rhsVal;
+  }
+  for (int i = 0; i < num_variables; ++i) {
+    solutions.emplace_back(std::move(solutionMap[i]));
+  } 
+  return SystemSolution{.type = SolutionType::INFINITELY_MANY_SOLUTIONS, .m_solutions=solutions, .free_variables=non_pivot_cols, .num_free_variables=static_cast<int>(non_pivot_cols.size())};
+}
+
 }
 
 // solves the equation Ax = b 
@@ -156,81 +392,47 @@ Matrix<double> inverse(const Matrix<double>& matrix) {
 Solution::SystemSolution solve_linear_system(const Matrix<double>& A, const Matrix<double>& b) {
   // a special case: assuming A is nxn, if A is invertible => x = A^-1(b), x is unique IFF A is invertible (t)
   // proof: https://www.quora.com/How-do-I-show-that-AX-B-has-a-unique-solution-if-and-only-if-Matrix-A-is-invertible.
-  using namespace Solution;
   if (A.m_rows != b.m_rows) {
     throw std::runtime_error("A and b need to have the same number of rows");
   }
-  auto augmented_matrix = A.concat(b);
-  auto RREF = gauss_jordan_elimination(augmented_matrix);
-  int num_variables = A.m_cols;
-  SolutionType solutionType = get_solution_type(RREF);
-  switch (solutionType) {
-    case SolutionType::NO_SOLUTION:
-      return SystemSolution{.type = solutionType};
-    case SolutionType::ONE_SOLUTION:
-    {
-      std::vector<VariableSolution> solutions;
-      for (int i = 0; i < num_variables; ++i) {
-        solutions.emplace_back(VariableSolution{.val=RREF.m_matrix[i][RREF.m_cols - 1]});
-      }
-      return SystemSolution{.type = solutionType, .m_solutions=solutions};
-    }
-    case SolutionType::INFINITELY_MANY_SOLUTIONS:
-    {
-      int r = 0, c = 0;
-      auto& matrix = RREF.m_matrix;
-
-      std::set<int> pivot_cols;
-      std::set<int> non_pivot_cols;
-      std::unordered_map<int, int> pivot_col_to_row_map;
-
-      while (r < RREF.m_rows && c < RREF.m_cols - 1) {
-        if (matrix[r][c] != 0) {
-          pivot_cols.insert(c);
-          pivot_col_to_row_map[c] = r;
-          ++r;
-        }
-        ++c;
-      }
+  auto RREF = A.concat(b);
+  // b never needs to be a pivot column: a pivot there just means no solution
+  eliminate(RREF.view(), A.m_cols, EliminationOptions{});
+  reduce(RREF.view(), A.m_cols, EliminationOptions{});
+  return extract_solution(RREF, A.m_cols, A.m_cols);
+}
 
-      for (int i = 0; i < RREF.m_cols - 1; ++i) {
-        if (!pivot_cols.contains(i)) {
-          non_pivot_cols.insert(i);
-        }
-      }
+// the pivots of [A | B] only depend on A, so one elimination serves every column of B
+std::vector<Solution::SystemSolution> solve_linear_systems(const Matrix<double>& A, const Matrix<double>& B) {
+  if (A.getRows() != B.getRows()) {
+    throw std::runtime_error("A and b need to have the same number of rows");
+  }
+  const int num_variables = A.getCols();
+  auto RREF = A.concat(B);
+  eliminate(RREF.view(), num_variables, EliminationOptions{});
+  reduce(RREF.view(), num_variables, EliminationOptions{});
+  std::vector<Solution::SystemSolution> solutions;
+  solutions.reserve(B.getCols());
+  for (int j = 0; j < B.getCols(); ++j) {
+    solutions.emplace_back(extract_solution(RREF, num_variables, num_variables + j));
+  }
+  return solutions;
+}
 
-      std::unordered_map<int, VariableSolution> solutionMap; 
-      std::vector<VariableSolution> solutions;
-
-      // iterate backwards - bottom up DP :)
-      for (auto it = pivot_cols.rbegin(); it != pivot_cols.rend(); ++it) {
-        int currCol = *it; 
-        int currRow = pivot_col_to_row_map[currCol];
-        double rhsVal = matrix[currRow][RREF.m_cols - 1];
-        //value component
-        for (int c = currCol + 1; c < RREF.m_cols - 1; ++c) {
-          if (matrix[currRow][c] == 0) continue;
-          // if non pivot, easy! just deduct the free variable.
-          auto& currMap = solutionMap[currCol].variable_count_map;
-          if (non_pivot_cols.contains(c)) {
-            currMap[c] -= matrix[currRow][c];
-          } else {
-            // if pivot, do some math. 
-            solutionMap[currCol].val -= solutionMap[c].val * matrix[currRow][c];
-            for (const auto& [key, val]: currMap) {
-              if (val == 0) continue;
-              currMap[key] -= val * matrix[currRow][c];
-            }
-          }
-        }
-        solutionMap[currCol].val += rhsVal;
-      }
-      for (int i = 0; i < RREF.m_cols - 1; ++i) {
-        solutions.emplace_back(std::move(solutionMap[i]));
-      } 
-      return SystemSolution{.type = solutionType, .m_solutions=solutions, .free_variables=non_pivot_cols, .num_free_variables=static_cast<int>(non_pivot_cols.size())};
+std::vector<Solution::SystemSolution> solve_linear_systems(const Matrix<double>& A, std::span<const std::vector<double>> bs) {
+  if (bs.empty()) {
+    return {};
+  }
+  Matrix<double> B {A.getRows(), static_cast<int>(bs.size())};
+  for (std::size_t j = 0; j < bs.size(); ++j) {
+    if (static_cast<int>(bs[j].size()) != A.getRows()) {
+      throw std::runtime_error("A and b need to have the same number of rows");
+    }
+    for (int i = 0; i < A.getRows(); ++i) {
+      B(i, j) = bs[j][i];
     }
   }
+  return solve_linear_systems(A, B);
 }
 
 // A is a REF or RREF form. 
@@ -238,9 +440,8 @@ Solution::SolutionType get_solution_type(const Matrix<double>& A) {
   using namespace Solution;
   // inconsistent if if the last column of a row-echelon form of the augmented matrix is a pivot column
   int r = 0, c = 0;
-  auto& matrix = A.m_matrix;
   while (r < A.m_rows && c < A.m_cols) {
-    if (matrix[r][c] != 0) {
+    if (row_ptr(A, r)[c] != 0) {
       if (c == A.m_cols - 1) return SolutionType::NO_SOLUTION;
       ++r;
     }
@@ -0,0 +1,92 @@
+#include <utility>
+
+#include "MatrixAnalysis.h"
+
+namespace linalg {
+
+const Matrix<double>& MatrixAnalysis::rref() const {
+  if (!m_rref) {
+    m_rref = gauss_jordan_elimination(m_matrix, m_options);
+  }
+  return *m_rref;
+}
+
+const std::vector<int>& MatrixAnalysis::pivot_columns() const {
+  if (!m_pivot_cols) {
+    const Matrix<double>& R = rref();
+    std::vector<int> pivot_cols;
+    int r = 0, c = 0;
+    while (r < R.getRows() && c < R.getCols()) {
+      if (R(r, c) != 0) {
+        pivot_cols.push_back(c);
+        ++r;
+      }
+      ++c;
+    }
+    m_pivot_cols = std::move(pivot_cols);
+  }
+  return *m_pivot_cols;
+}
+
+const TwoDVector<double>& MatrixAnalysis::row_space() const {
+  if (!m_row_space) {
+    const Matrix<double>& R = rref();
+    TwoDVector<double> rows;
+    for (int i = 0; i < rank(); ++i) {
+      rows.push_back(R.row(i).flatten());
+    }
+    m_row_space = std::move(rows);
+  }
+  return *m_row_space;
+}
+
+const TwoDVector<double>& MatrixAnalysis::col_space() const {
+  if (!m_col_space) {
+    const Matrix<double>& R = rref();
+    TwoDVector<double> cols;
+    for (int c: pivot_columns()) {
+      cols.push_back(R.col(c).flatten());
+    }
+    m_col_space = std::move(cols);
+  }
+  return *m_col_space;
+}
+
+const TwoDVector<double>& MatrixAnalysis::null_space() const {
+  if (!m_null_space) {
+    const Matrix<double>& R = rref();
+    const std::vector<int>& pivots = pivot_columns();
+    const int cols = R.getCols();
+    TwoDVector<double> basis;
+    std::size_t next_pivot = 0;
+    for (int f = 0; f < cols; ++f) {
+      if (next_pivot < pivots.size() && pivots[next_pivot] == f) {
+        ++next_pivot;
+        continue;
+      }
+      // row r of the RREF reads x_pivot(r) + R(r, f) x_f = 0 for the pivots left of f
+      std::vector<double> x (cols, 0.0);
+      x[f] = 1;
+      for (std::size_t r = 0; r < next_pivot; ++r) {
+        x[pivots[r]] = -R(r, f);
+      }
+      basis.push_back(std::move(x));
+    }
+    m_null_space = std::move(basis);
+  }
+  return *m_null_space;
+}
+
+Solution::SolutionType MatrixAnalysis::solution_type() const {
+  return get_solution_type(rref());
+}
+
+MatrixAnalysis analyze(const Matrix<double>& matrix, const EliminationOptions& options) {
+  return MatrixAnalysis{matrix, options};
+}
+
+MatrixAnalysis analyze(Matrix<double>&& matrix, const EliminationOptions& options) {
+  return MatrixAnalysis{std::move(matrix), options};
+}
+
+}
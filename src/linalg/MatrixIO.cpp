@@ -0,0 +1,219 @@
+#include <bit>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MatrixIO.h"
+
+static_assert(std::endian::native == std::endian::little, "Matrix files are little endian");
+
+namespace linalg {
+
+namespace {
+
+constexpr std::uint64_t P1 = 11400714785074694791ULL;
+constexpr std::uint64_t P2 = 14029467366897019727ULL;
+constexpr std::uint64_t P3 = 1609587929392839161ULL;
+constexpr std::uint64_t P4 = 9650029242287828579ULL;
+constexpr std::uint64_t P5 = 2870177450012600261ULL;
+
+std::uint64_t read64(const unsigned char* p) {
+  std::uint64_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+std::uint32_t read32(const unsigned char* p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+std::uint64_t round(std::uint64_t lane, std::uint64_t input) {
+  return std::rotl(lane + input * P2, 31) * P1;
+}
+
+std::uint64_t merge(std::uint64_t hash, std::uint64_t lane) {
+  return (hash ^ round(0, lane)) * P1 + P4;
+}
+
+std::size_t dtype_size(std::uint32_t dtype) {
+  switch (static_cast<DType>(dtype)) {
+    case DType::FLOAT32:
+    case DType::INT32:
+      return 4;
+    case DType::FLOAT64:
+    case DType::INT64:
+      return 8;
+  }
+  return 0;
+}
+
+}
+
+Checksum::Checksum() : m_lanes{P1 + P2, P2, 0, 0 - P1} {}
+
+void Checksum::update(const void* data, std::size_t bytes) {
+  auto in = static_cast<const unsigned char*>(data);
+  m_total += bytes;
+  if (m_buffered + bytes < 32) {
+    std::memcpy(m_buffer + m_buffered, in, bytes);
+    m_buffered += bytes;
+    return;
+  }
+  auto stripe = [&](const unsigned char* p) {
+    for (int lane = 0; lane < 4; ++lane) {
+      m_lanes[lane] = round(m_lanes[lane], read64(p + 8 * lane));
+    }
+  };
+  if (m_buffered > 0) {
+    const std::size_t fill = 32 - m_buffered;
+    std::memcpy(m_buffer + m_buffered, in, fill);
+    stripe(m_buffer);
+    in += fill;
+    bytes -= fill;
+    m_buffered = 0;
+  }
+  for (; bytes >= 32; in += 32, bytes -= 32) {
+    stripe(in);
+  }
+  std::memcpy(m_buffer, in, bytes);
+  m_buffered = bytes;
+}
+
+std::uint64_t Checksum::value() const {
+  std::uint64_t hash;
+  if (m_total >= 32) {
+    hash = std::rotl(m_lanes[0], 1) + std::rotl(m_lanes[1], 7) + std::rotl(m_lanes[2], 12) + std::rotl(m_lanes[3], 18);
+    for (std::uint64_t lane: m_lanes) {
+      hash = merge(hash, lane);
+    }
+  } else {
+    hash = m_lanes[2] + P5;
+  }
+  hash += m_total;
+  // the tail that did not fill a stripe
+  const unsigned char* p = m_buffer;
+  std::size_t left = m_buffered;
+  for (; left >= 8; p += 8, left -= 8) {
+    hash = std::rotl(hash ^ round(0, read64(p)), 27) * P1 + P4;
+  }
+  if (left >= 4) {
+    hash = std::rotl(hash ^ (read32(p) * P1), 23) * P2 + P3;
+    p += 4;
+    left -= 4;
+  }
+  for (; left > 0; ++p, --left) {
+    hash = std::rotl(hash ^ (*p * P5), 11) * P1;
+  }
+  hash ^= hash >> 33;
+  hash *= P2;
+  hash ^= hash >> 29;
+  hash *= P3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+std::uint64_t checksum(const void* data, std::size_t bytes) {
+  Checksum sum;
+  sum.update(data, bytes);
+  return sum.value();
+}
+
+MappedFile::MappedFile(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Could not open " + path + "!");
+  }
+  struct stat info;
+  if (::fstat(fd, &info) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Could not open " + path + "!");
+  }
+  m_size = info.st_size;
+  if (m_size < sizeof(BinaryHeader)) {
+    ::close(fd);
+    throw std::runtime_error("Not a matrix file!");
+  }
+  m_base = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (m_base == MAP_FAILED) {
+    m_base = nullptr;
+    throw std::runtime_error("Could not map " + path + "!");
+  }
+  // from here on the destructor will not run if the header is rejected
+  auto reject = [&](const char* message) {
+    ::munmap(m_base, m_size);
+    m_base = nullptr;
+    throw std::runtime_error(message);
+  };
+  std::memcpy(&m_header, m_base, sizeof(BinaryHeader));
+  if (std::memcmp(m_header.magic, "LINALGMX", 8) != 0) {
+    reject("Not a matrix file!");
+  }
+  if (m_header.header_checksum != checksum(&m_header, offsetof(BinaryHeader, header_checksum))) {
+    reject("Matrix file header is corrupted!");
+  }
+  if (m_header.version != 1) {
+    reject("Unsupported matrix file version!");
+  }
+  const std::size_t element = dtype_size(m_header.dtype);
+  const std::uint32_t alignment = m_header.alignment;
+  if (element == 0 || m_header.layout > static_cast<std::uint32_t>(Layout::COL_MAJOR) || alignment == 0 ||
+      alignment > 4096 || (alignment & (alignment - 1)) != 0 || m_header.data_offset % alignment != 0 ||
+      m_header.data_offset < sizeof(BinaryHeader)) {
+    reject("Matrix file header is corrupted!");
+  }
+  if (m_header.rows > INT_MAX || m_header.cols > INT_MAX) {
+    reject("Matrix in file is too large!");
+  }
+  // views index with int, so rows * cols must fit one. then the byte count (element <= 8) fits too
+  std::uint64_t count;
+  if (__builtin_mul_overflow(m_header.rows, m_header.cols, &count) || count > INT_MAX) {
+    reject("Matrix in file is too large!");
+  }
+  m_data_bytes = count * element;
+  if (m_header.data_offset > m_size || m_size - m_header.data_offset < m_data_bytes) {
+    reject("Matrix file is truncated!");
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (m_base != nullptr) {
+    ::munmap(m_base, m_size);
+  }
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+  : m_base{std::exchange(other.m_base, nullptr)}, m_size{other.m_size}, m_data_bytes{other.m_data_bytes},
+    m_header{other.m_header}
+{}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    if (m_base != nullptr) {
+      ::munmap(m_base, m_size);
+    }
+    m_base = std::exchange(other.m_base, nullptr);
+    m_size = other.m_size;
+    m_data_bytes = other.m_data_bytes;
+    m_header = other.m_header;
+  }
+  return *this;
+}
+
+bool MappedFile::verify() const {
+  return checksum(data(), m_data_bytes) == m_header.checksum;
+}
+
+void MappedFile::prefetch() const {
+  ::madvise(m_base, m_size, MADV_WILLNEED);
+}
+
+}
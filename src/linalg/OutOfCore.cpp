@@ -0,0 +1,479 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <set>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "FloatingPoint.h"
+#include "MatrixIO.h"
+#include "OutOfCore.h"
+#include "Simd.h"
+
+namespace linalg {
+
+namespace {
+
+void read_all(int fd, double* data, std::size_t count, std::size_t offset) {
+  auto out = reinterpret_cast<char*>(data);
+  std::size_t bytes = count * sizeof(double);
+  offset *= sizeof(double);
+  while (bytes > 0) {
+    const ssize_t n = ::pread(fd, out, bytes, offset);
+    if (n <= 0) {
+      throw std::runtime_error("Could not read scratch file!");
+    }
+    out += n;
+    offset += n;
+    bytes -= n;
+  }
+}
+
+void write_all(int fd, const double* data, std::size_t count, std::size_t offset) {
+  auto in = reinterpret_cast<const char*>(data);
+  std::size_t bytes = count * sizeof(double);
+  offset *= sizeof(double);
+  while (bytes > 0) {
+    const ssize_t n = ::pwrite(fd, in, bytes, offset);
+    if (n <= 0) {
+      throw std::runtime_error("Could not write scratch file!");
+    }
+    in += n;
+    offset += n;
+    bytes -= n;
+  }
+}
+
+// rows [first_row, last_row) of columns [first_col, first_col + cols) of the scratch file,
+// column after column
+struct Read {
+  int first_col;
+  int cols;
+  int first_row;
+  int last_row;
+
+  std::size_t size() const {return static_cast<std::size_t>(cols) * (last_row - first_row);}
+};
+
+// hands out a sequence of reads in order, the next one is always in flight while the caller
+// works on the current one. next_read is called for read i + 1 when read i is handed out,
+// so it may depend on everything the caller did before that.
+class PanelStream {
+  public:
+    PanelStream(int fd, int rows, std::function<bool(Read&)> next_read, IOStats& stats)
+      : m_fd{fd}, m_rows{rows}, m_next_read{std::move(next_read)}, m_stats{stats}
+    {
+      start();
+    }
+
+    ~PanelStream() {
+      if (m_pending.valid()) {
+        m_pending.wait();
+      }
+    }
+
+    // data of the next read, valid until the following call. nullptr at the end
+    const double* next(Read& read) {
+      if (!m_pending.valid()) {
+        return nullptr;
+      }
+      const auto begin = std::chrono::steady_clock::now();
+      m_pending.get();
+      m_stats.stall_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+      read = m_read;
+      m_stats.bytes_read += read.size() * sizeof(double);
+      ++m_stats.panels_read;
+      const double* data = m_buffers[m_fill].data();
+      m_fill = 1 - m_fill;
+      start();
+      return data;
+    }
+
+  private:
+    void start() {
+      if (!m_next_read(m_read)) {
+        return;
+      }
+      std::vector<double>& buffer = m_buffers[m_fill];
+      buffer.resize(std::max(buffer.size(), m_read.size()));
+      m_pending = std::async(std::launch::async, [this, read = m_read, data = buffer.data()] {
+        const int height = read.last_row - read.first_row;
+        if (height == m_rows) {
+          // whole columns are contiguous in the file
+          read_all(m_fd, data, read.size(), static_cast<std::size_t>(read.first_col) * m_rows);
+          return;
+        }
+        for (int t = 0; t < read.cols; ++t) {
+          read_all(m_fd, data + static_cast<std::size_t>(t) * height, height,
+                   static_cast<std::size_t>(read.first_col + t) * m_rows + read.first_row);
+        }
+      });
+    }
+
+    int m_fd;
+    int m_rows;
+    std::function<bool(Read&)> m_next_read;
+    IOStats& m_stats;
+    std::vector<double> m_buffers[2];
+    int m_fill = 0;
+    Read m_read {};
+    std::future<void> m_pending;
+};
+
+}
+
+OutOfCoreLU::OutOfCoreLU(const std::string& path, const OutOfCoreOptions& options)
+  : m_panel_cols{options.panel_cols}, m_memory_budget{options.memory_budget}, m_gemm{options.gemm}
+{
+  const std::string scratch = options.scratch_path.empty() ? path + ".lu" : options.scratch_path;
+  m_fd = ::open(scratch.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (m_fd < 0) {
+    throw std::runtime_error("Could not create " + scratch + "!");
+  }
+  ::unlink(scratch.c_str());
+  try {
+    convert(path);
+    factor();
+  } catch (...) {
+    ::close(m_fd);
+    throw;
+  }
+}
+
+OutOfCoreLU::~OutOfCoreLU() {
+  ::close(m_fd);
+}
+
+// matrix file -> column major scratch file, split into panels
+void OutOfCoreLU::convert(const std::string& path) {
+  MappedMatrix<double> input (path);
+  m_rows = input.getRows();
+  m_cols = input.getCols();
+  if (m_rows == 0 || m_cols == 0) {
+    throw std::runtime_error("Matrix cannot be empty");
+  }
+  if (m_panel_cols <= 0) {
+    const std::size_t fit = m_memory_budget / (4 * sizeof(double) * static_cast<std::size_t>(m_rows));
+    m_panel_cols = static_cast<int>(std::max<std::size_t>(8, std::min<std::size_t>(fit, m_cols)));
+  }
+  for (int c = 0; c < m_cols; c += m_panel_cols) {
+    m_panels.push_back(Panel{.first_col = c, .cols = std::min(m_panel_cols, m_cols - c)});
+  }
+  const std::size_t elements = static_cast<std::size_t>(m_rows) * m_cols;
+  if (input.layout() == Layout::COL_MAJOR) {
+    write_all(m_fd, input.data(), elements, 0);
+  } else {
+    // blocks of whole rows, transposed in memory and written column by column
+    const std::size_t fit = m_memory_budget / (2 * sizeof(double) * static_cast<std::size_t>(m_cols));
+    const int block = static_cast<int>(std::clamp<std::size_t>(fit, 1, m_rows));
+    std::vector<double> transposed (static_cast<std::size_t>(block) * m_cols);
+    const ConstMatrixView<double> A = input.view();
+    for (int i0 = 0; i0 < m_rows; i0 += block) {
+      const int height = std::min(block, m_rows - i0);
+      for (int i = 0; i < height; ++i) {
+        for (int c = 0; c < m_cols; ++c) {
+          transposed[static_cast<std::size_t>(c) * height + i] = A.coeff(i0 + i, c);
+        }
+      }
+      for (int c = 0; c < m_cols; ++c) {
+        write_all(m_fd, transposed.data() + static_cast<std::size_t>(c) * height, height,
+                  static_cast<std::size_t>(c) * m_rows + i0);
+      }
+    }
+  }
+  m_stats.bytes_read += elements * sizeof(double);
+  m_stats.bytes_written += elements * sizeof(double);
+}
+
+// left looking blocked LU. for every panel j:
+// 1. read it, and for every earlier panel k with pivots (streamed in):
+//    apply the row swaps of k, U_kj <- L_kk^-1 A_kj, A_j below k's pivots -= L_k U_kj
+// 2. factor it with the unblocked algorithm of LUFactorization
+// 3. write it back.
+// panels are stored with their rows in the order right after they were factored, later swaps
+// are never applied to them; forward() replays the swaps in the same order instead.
+void OutOfCoreLU::factor() {
+  const int panels = m_panels.size();
+  const int rows = m_rows;
+  // read sequence: panel j, then every earlier panel with pivots, below its first pivot row
+  int next_panel = 0, next_earlier = -1;
+  auto next_read = [&](Read& read) {
+    while (next_panel < panels) {
+      const Panel& target = m_panels[next_panel];
+      if (next_earlier < 0) {
+        read = Read{target.first_col, target.cols, 0, rows};
+        next_earlier = 0;
+        return true;
+      }
+      while (next_earlier < next_panel && m_panels[next_earlier].pivots == 0) {
+        ++next_earlier;
+      }
+      if (next_earlier < next_panel) {
+        const Panel& earlier = m_panels[next_earlier++];
+        read = Read{earlier.first_col, earlier.cols, earlier.first_row, rows};
+        return true;
+      }
+      ++next_panel;
+      next_earlier = -1;
+    }
+    return false;
+  };
+  PanelStream stream {m_fd, rows, next_read, m_stats};
+
+  std::vector<double> panel (static_cast<std::size_t>(rows) * m_panel_cols);
+  std::vector<double> neg_U, L;
+  auto at = [&](int i, int t) -> double& {return panel[static_cast<std::size_t>(t) * rows + i];};
+  Read read;
+  for (Panel& target: m_panels) {
+    const int cols = target.cols;
+    const double* data = stream.next(read);
+    std::copy(data, data + read.size(), panel.begin());
+
+    // 1. updates from the earlier panels
+    for (const Panel& earlier: m_panels) {
+      if (&earlier == &target) {
+        break;
+      }
+      if (earlier.pivots == 0) {
+        continue;
+      }
+      data = stream.next(read);
+      for (auto [a, b]: earlier.swaps) {
+        for (int t = 0; t < cols; ++t) {
+          std::swap(at(a, t), at(b, t));
+        }
+      }
+      const int r0 = earlier.first_row, p = earlier.pivots, height = rows - r0;
+      const int* pivot_cols = m_pivot_cols.data() + r0;
+      // column kk of L_k, from row r0 on
+      auto L_col = [&](int kk) {
+        return data + static_cast<std::size_t>(pivot_cols[kk] - earlier.first_col) * height;
+      };
+      for (int t = 0; t < cols; ++t) {
+        double* col = &at(r0, t);
+        for (int kk = 0; kk < p; ++kk) {
+          simd::axpy(p - kk - 1, -col[kk], L_col(kk) + kk + 1, col + kk + 1);
+        }
+      }
+      const int below = rows - r0 - p;
+      if (below == 0) {
+        continue;
+      }
+      // transposed, as the kernel is row major: A_j^T -= U_kj^T L_k^T.
+      // columns of L_k are rows of L_k^T, gathered when skipped columns leave gaps
+      neg_U.resize(static_cast<std::size_t>(cols) * p);
+      for (int t = 0; t < cols; ++t) {
+        for (int kk = 0; kk < p; ++kk) {
+          neg_U[static_cast<std::size_t>(t) * p + kk] = -at(r0 + kk, t);
+        }
+      }
+      const double* LT = L_col(0) + p;
+      int ld = height;
+      if (pivot_cols[p - 1] - pivot_cols[0] != p - 1) {
+        L.resize(static_cast<std::size_t>(p) * below);
+        for (int kk = 0; kk < p; ++kk) {
+          std::copy(L_col(kk) + p, L_col(kk) + height, L.begin() + static_cast<std::size_t>(kk) * below);
+        }
+        LT = L.data();
+        ld = below;
+      }
+      kernels::gemm(cols, below, p, neg_U.data(), p, LT, ld, &at(r0 + p, 0), rows, m_gemm);
+    }
+
+    // 2. panel factorization, as in LUFactorization
+    int r = m_pivot_cols.size();
+    target.first_row = r;
+    for (int t = 0; t < cols && r < rows; ++t) {
+      double* col = &at(0, t);
+      int pivot = r;
+      double max_val = std::abs(col[r]);
+      for (int i = r + 1; i < rows; ++i) {
+        if (std::abs(col[i]) >= max_val) {
+          max_val = std::abs(col[i]);
+          pivot = i;
+        }
+      }
+      if (max_val < THRESHOLD) {
+        std::fill(col + r, col + rows, 0.0);
+        continue;
+      }
+      if (pivot != r) {
+        for (int t2 = 0; t2 < cols; ++t2) {
+          std::swap(at(r, t2), at(pivot, t2));
+        }
+        target.swaps.emplace_back(r, pivot);
+      }
+      m_pivot_cols.push_back(target.first_col + t);
+      for (int i = r + 1; i < rows; ++i) {
+        col[i] /= col[r];
+      }
+      for (int t2 = t + 1; t2 < cols; ++t2) {
+        double* col2 = &at(0, t2);
+        simd::axpy(rows - r - 1, -col2[r], col + r + 1, col2 + r + 1);
+      }
+      ++r;
+    }
+    target.pivots = r - target.first_row;
+
+    // 3.
+    const std::size_t elements = static_cast<std::size_t>(rows) * cols;
+    write_all(m_fd, panel.data(), elements, static_cast<std::size_t>(target.first_col) * rows);
+    m_stats.bytes_written += elements * sizeof(double);
+    ++m_stats.panels_written;
+  }
+}
+
+std::vector<int> OutOfCoreLU::permutation() const {
+  std::vector<int> perm (m_rows);
+  for (int i = 0; i < m_rows; ++i) {
+    perm[i] = i;
+  }
+  for (const Panel& panel: m_panels) {
+    for (auto [a, b]: panel.swaps) {
+      std::swap(perm[a], perm[b]);
+    }
+  }
+  return perm;
+}
+
+void OutOfCoreLU::forward(std::vector<double>& y) const {
+  if (static_cast<int>(y.size()) != m_rows) {
+    throw std::runtime_error("A and b need to have the same number of rows");
+  }
+  std::size_t next = 0;
+  auto next_read = [&](Read& read) {
+    while (next < m_panels.size() && m_panels[next].pivots == 0) {
+      ++next;
+    }
+    if (next == m_panels.size()) {
+      return false;
+    }
+    const Panel& panel = m_panels[next++];
+    read = Read{panel.first_col, panel.cols, panel.first_row, m_rows};
+    return true;
+  };
+  PanelStream stream {m_fd, m_rows, next_read, m_stats};
+  Read read;
+  for (const Panel& panel: m_panels) {
+    if (panel.pivots == 0) {
+      continue;
+    }
+    const double* data = stream.next(read);
+    for (auto [a, b]: panel.swaps) {
+      std::swap(y[a], y[b]);
+    }
+    const int height = m_rows - panel.first_row;
+    for (int kk = 0; kk < panel.pivots; ++kk) {
+      const int r = panel.first_row + kk;
+      const double* L = data + static_cast<std::size_t>(m_pivot_cols[r] - panel.first_col) * height;
+      simd::axpy(m_rows - r - 1, -y[r], L + kk + 1, y.data() + r + 1);
+    }
+  }
+}
+
+Solution::SolutionType OutOfCoreLU::solution_type(const std::vector<double>& b) const {
+  using enum Solution::SolutionType;
+  std::vector<double> y = b;
+  forward(y);
+  // a zero row of U with a nonzero right hand side
+  for (int i = rank(); i < m_rows; ++i) {
+    if (std::abs(y[i]) >= THRESHOLD) {
+      return NO_SOLUTION;
+    }
+  }
+  return rank() == m_cols ? ONE_SOLUTION : INFINITELY_MANY_SOLUTIONS;
+}
+
+// back substitution column by column, from the last panel to the first. free variables are
+// carried symbolically: Y[0] is the right hand side, Y[s] the coefficients of free variable s,
+// so every pivot variable comes out as Y[0][r] / u + sum_s Y[s][r] / u * free_s
+Solution::SystemSolution OutOfCoreLU::solve(const std::vector<double>& b) const {
+  using namespace Solution;
+  std::vector<double> y = b;
+  forward(y);
+  const int rank = this->rank();
+  for (int i = rank; i < m_rows; ++i) {
+    if (std::abs(y[i]) >= THRESHOLD) {
+      return SystemSolution{.type = SolutionType::NO_SOLUTION};
+    }
+  }
+  std::vector<int> pivot_row (m_cols, -1);
+  for (int r = 0; r < rank; ++r) {
+    pivot_row[m_pivot_cols[r]] = r;
+  }
+  std::vector<int> free_cols;
+  std::vector<int> free_index (m_cols, -1);
+  for (int c = 0; c < m_cols; ++c) {
+    if (pivot_row[c] < 0) {
+      free_index[c] = free_cols.size();
+      free_cols.push_back(c);
+    }
+  }
+  const int num_free = free_cols.size();
+  std::vector<std::vector<double>> Y (1 + num_free, std::vector<double>(rank, 0.0));
+  std::copy(y.begin(), y.begin() + rank, Y[0].begin());
+
+  // rows of U above and at the pivots of a panel; panels without any are all zero
+  auto last_row = [](const Panel& panel) {return panel.first_row + panel.pivots;};
+  int next = m_panels.size() - 1;
+  auto next_read = [&](Read& read) {
+    while (next >= 0 && last_row(m_panels[next]) == 0) {
+      --next;
+    }
+    if (next < 0) {
+      return false;
+    }
+    const Panel& panel = m_panels[next--];
+    read = Read{panel.first_col, panel.cols, 0, last_row(panel)};
+    return true;
+  };
+  PanelStream stream {m_fd, m_rows, next_read, m_stats};
+
+  std::vector<VariableSolution> solutions (m_cols);
+  std::vector<double> x (1 + num_free);
+  Read read;
+  for (auto panel = m_panels.rbegin(); panel != m_panels.rend(); ++panel) {
+    const int height = last_row(*panel);
+    if (height == 0) {
+      continue;
+    }
+    const double* data = stream.next(read);
+    for (int t = panel->cols - 1; t >= 0; --t) {
+      const int c = panel->first_col + t;
+      const double* U = data + static_cast<std::size_t>(t) * height;
+      const int r = pivot_row[c];
+      if (r < 0) {
+        // free variable: its column moves to the right hand side, above the pivots before it
+        const int above = std::lower_bound(m_pivot_cols.begin(), m_pivot_cols.end(), c) - m_pivot_cols.begin();
+        simd::axpy(above, -1.0, U, Y[1 + free_index[c]].data());
+        continue;
+      }
+      for (int s = 0; s <= num_free; ++s) {
+        x[s] = Y[s][r] / U[r];
+        if (x[s] != 0) {
+          simd::axpy(r, -x[s], U, Y[s].data());
+        }
+        round_if_below_threshold(x[s]);
+      }
+      solutions[c].val = x[0];
+      for (int s = 0; s < num_free; ++s) {
+        if (x[1 + s] != 0) {
+          solutions[c].variable_count_map[free_cols[s]] = x[1 + s];
+        }
+      }
+    }
+  }
+  if (num_free == 0) {
+    return SystemSolution{.type = SolutionType::ONE_SOLUTION, .m_solutions = solutions};
+  }
+  return SystemSolution{.type = SolutionType::INFINITELY_MANY_SOLUTIONS, .m_solutions = solutions,
+                        .free_variables = {free_cols.begin(), free_cols.end()}, .num_free_variables = num_free};
+}
+
+}
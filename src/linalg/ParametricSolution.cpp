@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "ParametricSolution.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+
+namespace linalg {
+
+namespace {
+
+// about the size of a per core L2
+constexpr std::size_t CACHED_DIRECTIONS = 2 << 20;
+
+}
+
+// one pass over the coefficient maps, after which they are never looked at again
+ParametricSolution::ParametricSolution(const Solution::SystemSolution& solution)
+  : m_free_variables(solution.free_variables.begin(), solution.free_variables.end())
+{
+  if (solution.type == Solution::SolutionType::NO_SOLUTION) {
+    throw std::runtime_error("System has no solution!");
+  }
+  const std::size_t n = solution.m_solutions.size();
+  m_particular.resize(n, 0.0);
+  m_directions.resize(m_free_variables.size() * n, 0.0);
+  auto free_index = [this](int variable) {
+    return std::lower_bound(m_free_variables.begin(), m_free_variables.end(), variable) - m_free_variables.begin();
+  };
+  for (std::size_t j = 0; j < m_free_variables.size(); ++j) {
+    m_directions[j * n + m_free_variables[j]] = 1;
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    if (solution.free_variables.contains(i)) {
+      continue;
+    }
+    const auto& variable = solution.m_solutions[i];
+    m_particular[i] = variable.val;
+    for (const auto& [key, coefficient]: variable.variable_count_map) {
+      m_directions[free_index(key) * n + i] = coefficient;
+    }
+  }
+}
+
+std::vector<double> ParametricSolution::operator()(std::span<const double> params) const {
+  if (static_cast<int>(params.size()) != num_free_variables()) {
+    throw std::runtime_error("Passed in incorrect number of values for free variables. You need to pass in " + std::to_string(num_free_variables()) + " values!");
+  }
+  const std::size_t n = m_particular.size();
+  std::vector<double> x = m_particular;
+  for (std::size_t j = 0; j < params.size(); ++j) {
+    simd::axpy(n, params[j], m_directions.data() + j * n, x.data());
+  }
+  return x;
+}
+
+Matrix<double> ParametricSolution::evaluate(ConstMatrixView<double> params, const kernels::GemmOptions& options) const {
+  Matrix<double> X {params.getRows(), num_variables()};
+  evaluate(params, X.view(), options);
+  return X;
+}
+
+void ParametricSolution::evaluate(ConstMatrixView<double> params, MatrixView<double> out, const kernels::GemmOptions& options) const {
+  if (params.getCols() != num_free_variables()) {
+    throw std::runtime_error("Passed in incorrect number of values for free variables. You need to pass in " + std::to_string(num_free_variables()) + " values!");
+  }
+  if (out.getRows() != params.getRows() || out.getCols() != num_variables()) {
+    throw std::runtime_error("Output must have one row per parameter vector and one column per variable!");
+  }
+  if (!out.has_contiguous_rows()) {
+    throw std::runtime_error("Output rows must be contiguous!");
+  }
+  const int count = params.getRows(), n = num_variables(), k = num_free_variables();
+  auto out_row = [&out](int i) {return out.data() + static_cast<std::ptrdiff_t>(i) * out.rowStride();};
+  ThreadPool& pool = options.pool ? *options.pool : default_thread_pool();
+  const int threads = options.num_threads > 0 ? std::min(options.num_threads, pool.size()) : pool.size();
+  const bool parallel = threads > 1 && static_cast<long>(count) * n * std::max(k, 1) >= options.parallel_threshold;
+
+  // while N stays in cache, sweeping it once per row with axpys beats packing it for the serial
+  // kernel; gemm takes over once N spills (it needs contiguous parameter rows)
+  if (m_directions.size() * sizeof(double) <= CACHED_DIRECTIONS || !params.has_contiguous_rows()) {
+    auto sweep = [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        double* x = out_row(i);
+        std::copy(m_particular.begin(), m_particular.end(), x);
+        for (int j = 0; j < k; ++j) {
+          simd::axpy(n, params.coeff(i, j), m_directions.data() + static_cast<std::size_t>(j) * n, x);
+        }
+      }
+    };
+    if (parallel) {
+      // a few thousand multiply-adds per chunk
+      pool.parallel_for(count, std::max(1, 4096 / (n * std::max(k, 1))), sweep, false, threads);
+    } else {
+      sweep(0, count);
+    }
+    return;
+  }
+  for (int i = 0; i < count; ++i) {
+    std::copy(m_particular.begin(), m_particular.end(), out_row(i));
+  }
+  kernels::gemm(count, n, k, params.data(), params.rowStride(), m_directions.data(), n, out.data(), out.rowStride(),
+                options);
+}
+
+void ParametricSolution::evaluate(std::span<const double> params, std::span<double> out, const kernels::GemmOptions& options) const {
+  const std::size_t n = num_variables(), k = num_free_variables();
+  const std::size_t count = n > 0 ? out.size() / n : 0;
+  if (out.size() != count * n || params.size() != count * k) {
+    throw std::runtime_error("Parameter and output buffers do not match the number of variables!");
+  }
+  evaluate(ConstMatrixView<double>{params.data(), static_cast<int>(count), static_cast<int>(k), static_cast<int>(k)},
+           MatrixView<double>{out.data(), static_cast<int>(count), static_cast<int>(n), static_cast<int>(n)}, options);
+}
+
+}
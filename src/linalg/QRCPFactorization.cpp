@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Gemm.h"
+#include "QRCPFactorization.h"
+#include "Simd.h"
+
+namespace linalg {
+
+namespace {
+
+double norm(std::size_t n, const double* x) {
+  return std::sqrt(simd::dot(n, x, x));
+}
+
+}
+
+// the blocked algorithm of LAPACK's dlaqps. within a block the reflectors are only applied to
+// the pivot column and the pivot row; the rest of the matrix waits for A -= V F^T at the end of
+// the block, where F collects tau (A^T v) for every reflector v. the pivots need the norms of the
+// remaining columns, which are downdated step by step. when cancellation makes one unreliable,
+// the block ends early and that norm is recomputed from the updated column.
+QRCPFactorization::QRCPFactorization(const Matrix<double>& A, const QRCPOptions& options)
+  : m_rows{A.getRows()}, m_cols{A.getCols()}, m_qr(static_cast<std::size_t>(m_rows) * m_cols), m_perm(m_cols)
+{
+  if (options.block_size <= 0) {
+    throw std::runtime_error("block size must be > 0!");
+  }
+  const int m = m_rows, n = m_cols, steps = std::min(m, n);
+  const std::size_t ld = m;
+  double* a = m_qr.data();
+  auto col = [&](int c) {return a + c * ld;};
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) {
+      col(j)[i] = A(i, j);
+    }
+  }
+  m_tau.resize(steps);
+  // vn1: downdated norms of the remaining part of every column, vn2: the last exact ones
+  std::vector<double> vn1 (n), vn2 (n);
+  for (int j = 0; j < n; ++j) {
+    m_perm[j] = j;
+    vn1[j] = vn2[j] = norm(m, col(j));
+  }
+  const double eps = std::numeric_limits<double>::epsilon();
+  const double relative = options.tolerance > 0 ? options.tolerance : std::max(m, n) * eps;
+  const double tol3z = std::sqrt(eps);
+  double threshold = 0;
+
+  const int block = options.block_size;
+  // F(c, j) at f[c * block + j]
+  std::vector<double> f (static_cast<std::size_t>(n) * block), neg_F, aux (block);
+  auto F = [&](int c, int j) -> double& {return f[static_cast<std::size_t>(c) * block + j];};
+  std::vector<int> stale;
+  int k = 0;
+  bool stop = false;
+  while (k < steps && !stop) {
+    const int nb = std::min(block, steps - k);
+    std::fill(f.begin() + static_cast<std::size_t>(k) * block, f.end(), 0.0);
+    int j = 0;
+    for (; j < nb; ++j) {
+      const int rk = k + j;
+      const int pivot = std::max_element(vn1.begin() + rk, vn1.end()) - vn1.begin();
+      if (pivot != rk) {
+        std::swap_ranges(col(pivot), col(pivot) + m, col(rk));
+        std::swap_ranges(&F(pivot, 0), &F(pivot, 0) + block, &F(rk, 0));
+        std::swap(m_perm[pivot], m_perm[rk]);
+        vn1[pivot] = vn1[rk];
+        vn2[pivot] = vn2[rk];
+      }
+      // the reflectors of this block so far, on the pivot column
+      double* v = col(rk) + rk;
+      for (int jj = 0; jj < j; ++jj) {
+        simd::axpy(m - rk, -F(rk, jj), col(k + jj) + rk, v);
+      }
+      // |R(rk, rk)| is the norm of what is left of the pivot column
+      const double alpha = v[0], tail = norm(m - rk - 1, v + 1), column_norm = std::hypot(alpha, tail);
+      if (rk == 0) {
+        threshold = relative * column_norm;
+      }
+      if (m_rank < 0 && column_norm <= threshold) {
+        m_rank = rk;
+        if (options.rank_only) {
+          stop = true;
+          break;
+        }
+      }
+      // reflector H = I - tau v v^T with H x = beta e1, v[0] = 1 implied
+      double tau = 0;
+      if (tail != 0) {
+        const double beta = alpha > 0 ? -column_norm : column_norm;
+        tau = (beta - alpha) / beta;
+        simd::scale(m - rk - 1, 1 / (alpha - beta), v + 1);
+        v[0] = beta;
+      }
+      m_tau[rk] = tau;
+      const double diagonal = v[0];
+      v[0] = 1;
+      // F(:, j) = tau (A^T v - F(:, 0:j) V^T v), rows of columns up to rk stay 0
+      for (int c = rk + 1; c < n; ++c) {
+        F(c, j) = tau * simd::dot(m - rk, col(c) + rk, v);
+      }
+      if (j > 0 && tau != 0) {
+        for (int jj = 0; jj < j; ++jj) {
+          aux[jj] = -tau * simd::dot(m - rk, col(k + jj) + rk, v);
+        }
+        for (int c = k; c < n; ++c) {
+          double sum = 0;
+          for (int jj = 0; jj < j; ++jj) {
+            sum += F(c, jj) * aux[jj];
+          }
+          F(c, j) += sum;
+        }
+      }
+      // row rk of R is final from here on
+      for (int c = rk + 1; c < n; ++c) {
+        double sum = 0;
+        for (int jj = 0; jj <= j; ++jj) {
+          sum += col(k + jj)[rk] * F(c, jj);
+        }
+        col(c)[rk] -= sum;
+      }
+      v[0] = diagonal;
+      // removing row rk from the remaining norms
+      for (int c = rk + 1; c < n; ++c) {
+        if (vn1[c] == 0) {
+          continue;
+        }
+        const double ratio = std::abs(col(c)[rk]) / vn1[c];
+        const double left = std::max(0.0, (1 + ratio) * (1 - ratio));
+        if (left * (vn1[c] / vn2[c]) * (vn1[c] / vn2[c]) <= tol3z) {
+          stale.push_back(c);
+        } else {
+          vn1[c] *= std::sqrt(left);
+        }
+      }
+      if (!stale.empty()) {
+        ++j;
+        break;
+      }
+    }
+    const int done = k + j;
+    if (stop) {
+      m_steps = done;
+      break;
+    }
+    // A(done:, done:) -= V(done:, k:done) F(done:, k:done)^T, transposed for the row major kernel
+    if (done < m && done < n) {
+      const int rest = n - done;
+      neg_F.resize(static_cast<std::size_t>(rest) * j);
+      for (int c = 0; c < rest; ++c) {
+        for (int jj = 0; jj < j; ++jj) {
+          neg_F[static_cast<std::size_t>(c) * j + jj] = -F(done + c, jj);
+        }
+      }
+      kernels::gemm(rest, m - done, j, neg_F.data(), j, col(k) + done, ld, col(done) + done, ld);
+    }
+    for (int c: stale) {
+      vn1[c] = vn2[c] = done < m ? norm(m - done, col(c) + done) : 0;
+    }
+    stale.clear();
+    k = done;
+    m_steps = k;
+  }
+  if (m_rank < 0) {
+    m_rank = steps;
+  }
+}
+
+std::vector<double> QRCPFactorization::form_Q(int cols) const {
+  const int m = m_rows;
+  const std::size_t ld = m;
+  // Q = H0 H1 ... [I; 0], applied from the last reflector on, each to the columns it can reach.
+  // column major while building, so reflectors work on contiguous columns
+  std::vector<double> q (static_cast<std::size_t>(m) * cols, 0.0);
+  for (int j = 0; j < cols; ++j) {
+    q[j * ld + j] = 1;
+  }
+  std::vector<double> v (m);
+  for (int j = std::min(cols, m_steps) - 1; j >= 0; --j) {
+    if (m_tau[j] == 0) {
+      continue;
+    }
+    const double* stored = m_qr.data() + j * ld;
+    v[j] = 1;
+    std::copy(stored + j + 1, stored + m, v.begin() + j + 1);
+    for (int c = j; c < cols; ++c) {
+      double* x = q.data() + c * ld;
+      simd::axpy(m - j, -m_tau[j] * simd::dot(m - j, v.data() + j, x + j), v.data() + j, x + j);
+    }
+  }
+  return q;
+}
+
+Matrix<double> QRCPFactorization::Q() const {
+  if (m_steps == 0) {
+    throw std::runtime_error("Factorization stopped before the first reflector!");
+  }
+  const std::vector<double> q = form_Q(m_steps);
+  Matrix<double> Q {m_rows, m_steps};
+  for (int i = 0; i < m_rows; ++i) {
+    for (int j = 0; j < m_steps; ++j) {
+      Q(i, j) = q[static_cast<std::size_t>(j) * m_rows + i];
+    }
+  }
+  return Q;
+}
+
+Matrix<double> QRCPFactorization::R() const {
+  if (m_steps == 0) {
+    throw std::runtime_error("Factorization stopped before the first reflector!");
+  }
+  Matrix<double> R {m_steps, m_cols};
+  for (int i = 0; i < m_steps; ++i) {
+    for (int j = i; j < m_cols; ++j) {
+      R(i, j) = m_qr[static_cast<std::size_t>(j) * m_rows + i];
+    }
+  }
+  return R;
+}
+
+TwoDVector<double> QRCPFactorization::column_space() const {
+  const std::vector<double> q = form_Q(m_rank);
+  TwoDVector<double> basis;
+  for (int j = 0; j < m_rank; ++j) {
+    basis.emplace_back(q.begin() + static_cast<std::size_t>(j) * m_rows, q.begin() + static_cast<std::size_t>(j + 1) * m_rows);
+  }
+  return basis;
+}
+
+TwoDVector<double> QRCPFactorization::row_space() const {
+  TwoDVector<double> basis (m_rank, std::vector<double>(m_cols, 0.0));
+  for (int i = 0; i < m_rank; ++i) {
+    for (int j = i; j < m_cols; ++j) {
+      basis[i][m_perm[j]] = m_qr[static_cast<std::size_t>(j) * m_rows + i];
+    }
+  }
+  return basis;
+}
+
+}
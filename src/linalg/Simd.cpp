@@ -0,0 +1,378 @@
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+
+#include "FloatingPoint.h"
+#include "Simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LINALG_X86 1
+#include <immintrin.h>
+#endif
+
+// the element-wise kernels promise the rounding of the scalar code (Simd.h), so a * x + y must
+// not be fused into an fma, which gcc does by default unless compiling strict iso c++
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace linalg::simd {
+
+namespace {
+
+struct Kernels {
+  KernelSet set;
+  void (*axpy)(std::size_t, double, const double*, double*);
+  void (*scale)(std::size_t, double, double*);
+  void (*add)(std::size_t, const double*, double*);
+  void (*sub)(std::size_t, const double*, double*);
+  double (*dot)(std::size_t, const double*, const double*);
+  void (*round_below_threshold)(std::size_t, double*);
+};
+
+// scalar versions, also used for the tails of the vector loops
+
+void axpy_scalar(std::size_t n, double a, const double* x, double* y) {
+  for (std::size_t i = 0; i < n; ++i) {
+    y[i] += a * x[i];
+  }
+}
+
+void scale_scalar(std::size_t n, double a, double* x) {
+  for (std::size_t i = 0; i < n; ++i) {
+    x[i] *= a;
+  }
+}
+
+void add_scalar(std::size_t n, const double* x, double* y) {
+  for (std::size_t i = 0; i < n; ++i) {
+    y[i] += x[i];
+  }
+}
+
+void sub_scalar(std::size_t n, const double* x, double* y) {
+  for (std::size_t i = 0; i < n; ++i) {
+    y[i] -= x[i];
+  }
+}
+
+double dot_scalar(std::size_t n, const double* x, const double* y) {
+  double acc = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    acc += x[i] * y[i];
+  }
+  return acc;
+}
+
+void round_scalar(std::size_t n, double* x) {
+  for (std::size_t i = 0; i < n; ++i) {
+    round_if_below_threshold(x[i]);
+  }
+}
+
+constexpr Kernels SCALAR_KERNELS {KernelSet::SCALAR, axpy_scalar, scale_scalar, add_scalar, sub_scalar, dot_scalar, round_scalar};
+
+#ifdef LINALG_X86
+
+// SSE2 is part of x86-64, so these need no target attribute
+
+void axpy_sse2(std::size_t n, double a, const double* x, double* y) {
+  std::size_t i = 0;
+  const __m128d va = _mm_set1_pd(a);
+  for (; i + 4 <= n; i += 4) {
+    __m128d y0 = _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(va, _mm_loadu_pd(x + i)));
+    __m128d y1 = _mm_add_pd(_mm_loadu_pd(y + i + 2), _mm_mul_pd(va, _mm_loadu_pd(x + i + 2)));
+    _mm_storeu_pd(y + i, y0);
+    _mm_storeu_pd(y + i + 2, y1);
+  }
+  axpy_scalar(n - i, a, x + i, y + i);
+}
+
+void scale_sse2(std::size_t n, double a, double* x) {
+  std::size_t i = 0;
+  const __m128d va = _mm_set1_pd(a);
+  for (; i + 2 <= n; i += 2) {
+    _mm_storeu_pd(x + i, _mm_mul_pd(_mm_loadu_pd(x + i), va));
+  }
+  scale_scalar(n - i, a, x + i);
+}
+
+void add_sse2(std::size_t n, const double* x, double* y) {
+  std::size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_loadu_pd(x + i)));
+  }
+  add_scalar(n - i, x + i, y + i);
+}
+
+void sub_sse2(std::size_t n, const double* x, double* y) {
+  std::size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    _mm_storeu_pd(y + i, _mm_sub_pd(_mm_loadu_pd(y + i), _mm_loadu_pd(x + i)));
+  }
+  sub_scalar(n - i, x + i, y + i);
+}
+
+double dot_sse2(std::size_t n, const double* x, const double* y) {
+  std::size_t i = 0;
+  __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+  for (; i + 4 <= n; i += 4) {
+    acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+    acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(y + i + 2)));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+  return lanes[0] + lanes[1] + dot_scalar(n - i, x + i, y + i);
+}
+
+void round_sse2(std::size_t n, double* x) {
+  std::size_t i = 0;
+  const __m128d sign = _mm_set1_pd(-0.0), threshold = _mm_set1_pd(THRESHOLD);
+  for (; i + 2 <= n; i += 2) {
+    __m128d v = _mm_loadu_pd(x + i);
+    __m128d small = _mm_cmplt_pd(_mm_andnot_pd(sign, v), threshold);
+    _mm_storeu_pd(x + i, _mm_andnot_pd(small, v));
+  }
+  round_scalar(n - i, x + i);
+}
+
+constexpr Kernels SSE2_KERNELS {KernelSet::SSE2, axpy_sse2, scale_sse2, add_sse2, sub_sse2, dot_sse2, round_sse2};
+
+__attribute__((target("avx2")))
+void axpy_avx2(std::size_t n, double a, const double* x, double* y) {
+  std::size_t i = 0;
+  const __m256d va = _mm256_set1_pd(a);
+  for (; i + 8 <= n; i += 8) {
+    __m256d y0 = _mm256_add_pd(_mm256_loadu_pd(y + i), _mm256_mul_pd(va, _mm256_loadu_pd(x + i)));
+    __m256d y1 = _mm256_add_pd(_mm256_loadu_pd(y + i + 4), _mm256_mul_pd(va, _mm256_loadu_pd(x + i + 4)));
+    _mm256_storeu_pd(y + i, y0);
+    _mm256_storeu_pd(y + i + 4, y1);
+  }
+  axpy_scalar(n - i, a, x + i, y + i);
+}
+
+__attribute__((target("avx2")))
+void scale_avx2(std::size_t n, double a, double* x) {
+  std::size_t i = 0;
+  const __m256d va = _mm256_set1_pd(a);
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(x + i, _mm256_mul_pd(_mm256_loadu_pd(x + i), va));
+  }
+  scale_scalar(n - i, a, x + i);
+}
+
+__attribute__((target("avx2")))
+void add_avx2(std::size_t n, const double* x, double* y) {
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(y + i, _mm256_add_pd(_mm256_loadu_pd(y + i), _mm256_loadu_pd(x + i)));
+  }
+  add_scalar(n - i, x + i, y + i);
+}
+
+__attribute__((target("avx2")))
+void sub_avx2(std::size_t n, const double* x, double* y) {
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(y + i, _mm256_sub_pd(_mm256_loadu_pd(y + i), _mm256_loadu_pd(x + i)));
+  }
+  sub_scalar(n - i, x + i, y + i);
+}
+
+__attribute__((target("avx2")))
+double dot_avx2(std::size_t n, const double* x, const double* y) {
+  std::size_t i = 0;
+  __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+    acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4)));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + dot_scalar(n - i, x + i, y + i);
+}
+
+__attribute__((target("avx2")))
+void round_avx2(std::size_t n, double* x) {
+  std::size_t i = 0;
+  const __m256d sign = _mm256_set1_pd(-0.0), threshold = _mm256_set1_pd(THRESHOLD);
+  for (; i + 4 <= n; i += 4) {
+    __m256d v = _mm256_loadu_pd(x + i);
+    __m256d small = _mm256_cmp_pd(_mm256_andnot_pd(sign, v), threshold, _CMP_LT_OQ);
+    _mm256_storeu_pd(x + i, _mm256_andnot_pd(small, v));
+  }
+  round_scalar(n - i, x + i);
+}
+
+constexpr Kernels AVX2_KERNELS {KernelSet::AVX2, axpy_avx2, scale_avx2, add_avx2, sub_avx2, dot_avx2, round_avx2};
+
+__attribute__((target("avx512f")))
+void axpy_avx512(std::size_t n, double a, const double* x, double* y) {
+  std::size_t i = 0;
+  const __m512d va = _mm512_set1_pd(a);
+  for (; i + 16 <= n; i += 16) {
+    __m512d y0 = _mm512_add_pd(_mm512_loadu_pd(y + i), _mm512_mul_pd(va, _mm512_loadu_pd(x + i)));
+    __m512d y1 = _mm512_add_pd(_mm512_loadu_pd(y + i + 8), _mm512_mul_pd(va, _mm512_loadu_pd(x + i + 8)));
+    _mm512_storeu_pd(y + i, y0);
+    _mm512_storeu_pd(y + i + 8, y1);
+  }
+  axpy_scalar(n - i, a, x + i, y + i);
+}
+
+__attribute__((target("avx512f")))
+void scale_avx512(std::size_t n, double a, double* x) {
+  std::size_t i = 0;
+  const __m512d va = _mm512_set1_pd(a);
+  for (; i + 8 <= n; i += 8) {
+    _mm512_storeu_pd(x + i, _mm512_mul_pd(_mm512_loadu_pd(x + i), va));
+  }
+  scale_scalar(n - i, a, x + i);
+}
+
+__attribute__((target("avx512f")))
+void add_avx512(std::size_t n, const double* x, double* y) {
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm512_storeu_pd(y + i, _mm512_add_pd(_mm512_loadu_pd(y + i), _mm512_loadu_pd(x + i)));
+  }
+  add_scalar(n - i, x + i, y + i);
+}
+
+__attribute__((target("avx512f")))
+void sub_avx512(std::size_t n, const double* x, double* y) {
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm512_storeu_pd(y + i, _mm512_sub_pd(_mm512_loadu_pd(y + i), _mm512_loadu_pd(x + i)));
+  }
+  sub_scalar(n - i, x + i, y + i);
+}
+
+__attribute__((target("avx512f")))
+double dot_avx512(std::size_t n, const double* x, const double* y) {
+  std::size_t i = 0;
+  __m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm512_add_pd(acc0, _mm512_mul_pd(_mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i)));
+    acc1 = _mm512_add_pd(acc1, _mm512_mul_pd(_mm512_loadu_pd(x + i + 8), _mm512_loadu_pd(y + i + 8)));
+  }
+  // not _mm512_reduce_add_pd, whose header trips -Wuninitialized on gcc
+  double lanes[8];
+  _mm512_storeu_pd(lanes, _mm512_add_pd(acc0, acc1));
+  return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]))
+         + dot_scalar(n - i, x + i, y + i);
+}
+
+__attribute__((target("avx512f")))
+void round_avx512(std::size_t n, double* x) {
+  std::size_t i = 0;
+  const __m512d threshold = _mm512_set1_pd(THRESHOLD);
+  for (; i + 8 <= n; i += 8) {
+    __m512d v = _mm512_loadu_pd(x + i);
+    __mmask8 small = _mm512_cmp_pd_mask(_mm512_abs_pd(v), threshold, _CMP_LT_OQ);
+    _mm512_storeu_pd(x + i, _mm512_mask_mov_pd(v, small, _mm512_setzero_pd()));
+  }
+  round_scalar(n - i, x + i);
+}
+
+constexpr Kernels AVX512_KERNELS {KernelSet::AVX512, axpy_avx512, scale_avx512, add_avx512, sub_avx512, dot_avx512, round_avx512};
+
+#endif
+
+const Kernels* kernels_for(KernelSet set) {
+  switch (set) {
+#ifdef LINALG_X86
+    case KernelSet::AVX512:
+      return &AVX512_KERNELS;
+    case KernelSet::AVX2:
+      return &AVX2_KERNELS;
+    case KernelSet::SSE2:
+      return &SSE2_KERNELS;
+#endif
+    default:
+      return &SCALAR_KERNELS;
+  }
+}
+
+KernelSet detect() {
+#ifdef LINALG_X86
+  __builtin_cpu_init();
+  // libgcc also checks that the os saves the wider registers (xgetbv)
+  if (__builtin_cpu_supports("avx512f")) {
+    return KernelSet::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return KernelSet::AVX2;
+  }
+  return KernelSet::SSE2;
+#else
+  return KernelSet::SCALAR;
+#endif
+}
+
+std::atomic<const Kernels*>& active() {
+  static std::atomic<const Kernels*> kernels {kernels_for(best_kernel_set())};
+  return kernels;
+}
+
+inline const Kernels& current() {
+  return *active().load(std::memory_order_relaxed);
+}
+
+}
+
+KernelSet best_kernel_set() {
+  static const KernelSet best = detect();
+  return best;
+}
+
+KernelSet active_kernel_set() {
+  return current().set;
+}
+
+const char* kernel_set_name(KernelSet set) {
+  switch (set) {
+    case KernelSet::SSE2:
+      return "sse2";
+    case KernelSet::AVX2:
+      return "avx2";
+    case KernelSet::AVX512:
+      return "avx512";
+    default:
+      return "scalar";
+  }
+}
+
+void set_kernel_set(KernelSet set) {
+  if (static_cast<int>(set) > static_cast<int>(best_kernel_set())) {
+    set = best_kernel_set();
+  }
+  active().store(kernels_for(set), std::memory_order_relaxed);
+}
+
+void axpy(std::size_t n, double a, const double* x, double* y) {
+  current().axpy(n, a, x, y);
+}
+
+void scale(std::size_t n, double a, double* x) {
+  current().scale(n, a, x);
+}
+
+void add(std::size_t n, const double* x, double* y) {
+  current().add(n, x, y);
+}
+
+void sub(std::size_t n, const double* x, double* y) {
+  current().sub(n, x, y);
+}
+
+double dot(std::size_t n, const double* x, const double* y) {
+  return current().dot(n, x, y);
+}
+
+void round_below_threshold(std::size_t n, double* x) {
+  current().round_below_threshold(n, x);
+}
+
+}
@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "FloatingPoint.h"
+#include "SparseLU.h"
+
+namespace linalg {
+
+namespace {
+
+// approximate minimum degree ordering of the graph adj (symmetric, no self loops).
+// eliminated nodes are kept as "elements" (quotient graph) instead of connecting their neighbours
+// into a clique, so memory stays O(|adj|). degrees are the approximate external degrees of AMD:
+// |L_p \ i| + sum over the other elements e of i of |L_e \ L_p| + neighbours not covered by L_p.
+// nodes listed in last (e.g. dense rows/columns) are ordered after everything else.
+std::vector<int> minimum_degree(std::vector<std::vector<int>> adj, const std::vector<int>& last) {
+  const int n = adj.size();
+  std::vector<std::vector<int>> elements (n), members (n);
+  std::vector<char> eliminated (n, 0);
+  std::vector<int> degree (n), w (n, 0), w_stamp (n, -1), in_lp (n, -1);
+  std::set<std::pair<int, int>> by_degree;
+  for (int v: last) {
+    eliminated[v] = 1;
+  }
+  for (int i = 0; i < n; ++i) {
+    if (eliminated[i]) {
+      continue;
+    }
+    std::erase_if(adj[i], [&](int j) {return eliminated[j];});
+    degree[i] = adj[i].size();
+    by_degree.emplace(degree[i], i);
+  }
+  std::vector<int> order;
+  order.reserve(n);
+  int remaining = by_degree.size();
+  while (!by_degree.empty()) {
+    const int p = by_degree.begin()->second;
+    by_degree.erase(by_degree.begin());
+    order.push_back(p);
+    eliminated[p] = 1;
+    --remaining;
+    // L_p: the uneliminated neighbours of p, directly or through its elements
+    std::vector<int>& lp = members[p];
+    for (int j: adj[p]) {
+      if (!eliminated[j] && in_lp[j] != p) {
+        in_lp[j] = p;
+        lp.push_back(j);
+      }
+    }
+    for (int e: elements[p]) {
+      for (int j: members[e]) {
+        if (j != p && in_lp[j] != p) {
+          in_lp[j] = p;
+          lp.push_back(j);
+        }
+      }
+      // e is a subset of L_p now
+      std::vector<int>().swap(members[e]);
+    }
+    std::vector<int>().swap(adj[p]);
+    std::vector<int>().swap(elements[p]);
+    // p replaces the absorbed elements, edges inside L_p are implied by it
+    for (int i: lp) {
+      std::erase_if(elements[i], [&](int e) {return members[e].empty();});
+      elements[i].push_back(p);
+      std::erase_if(adj[i], [&](int j) {return eliminated[j] || in_lp[j] == p;});
+    }
+    // w(e) = |L_e \ L_p| for every element touching L_p
+    for (int i: lp) {
+      for (int e: elements[i]) {
+        if (e == p) {
+          continue;
+        }
+        if (w_stamp[e] != p) {
+          w_stamp[e] = p;
+          w[e] = members[e].size();
+        }
+        --w[e];
+      }
+    }
+    const int lp_size = lp.size();
+    for (int i: lp) {
+      int d = lp_size - 1 + adj[i].size();
+      for (int e: elements[i]) {
+        if (e != p) {
+          d += w[e];
+        }
+      }
+      d = std::min({d, degree[i] + lp_size - 1, remaining - 1});
+      by_degree.erase({degree[i], i});
+      degree[i] = d;
+      by_degree.emplace(d, i);
+    }
+  }
+  order.insert(order.end(), last.begin(), last.end());
+  return order;
+}
+
+// rows or columns with more entries than this would make the graph (nearly) dense
+int dense_threshold(int n) {
+  return std::max(16, static_cast<int>(10 * std::sqrt(n)));
+}
+
+// graph of A + A^T: suits matrices whose diagonal makes acceptable pivots, which threshold
+// pivoting then mostly keeps (the symmetric strategy of UMFPACK)
+std::vector<int> symmetric_ordering(const SparseMatrix<double>& A) {
+  const int n = A.getCols();
+  std::vector<std::vector<int>> adj (n);
+  const auto& offsets = A.row_offsets();
+  const auto& cols = A.col_indices();
+  for (int i = 0; i < n; ++i) {
+    for (int p = offsets[i]; p < offsets[i + 1]; ++p) {
+      if (cols[p] != i) {
+        adj[i].push_back(cols[p]);
+        adj[cols[p]].push_back(i);
+      }
+    }
+  }
+  std::vector<int> last;
+  for (int i = 0; i < n; ++i) {
+    std::sort(adj[i].begin(), adj[i].end());
+    adj[i].erase(std::unique(adj[i].begin(), adj[i].end()), adj[i].end());
+    if (static_cast<int>(adj[i].size()) > dense_threshold(n)) {
+      last.push_back(i);
+    }
+  }
+  return minimum_degree(std::move(adj), last);
+}
+
+// graph of A^T A (columns sharing a row are adjacent): bounds the fill of LU for any row
+// pivoting, like COLAMD. dense rows are left out of the graph.
+std::vector<int> column_ordering(const SparseMatrix<double>& A) {
+  const int n = A.getCols();
+  std::vector<std::vector<int>> adj (n);
+  const auto& offsets = A.row_offsets();
+  const auto& cols = A.col_indices();
+  for (int i = 0; i < A.getRows(); ++i) {
+    if (offsets[i + 1] - offsets[i] > dense_threshold(n)) {
+      continue;
+    }
+    for (int p = offsets[i]; p < offsets[i + 1]; ++p) {
+      for (int q = offsets[i]; q < offsets[i + 1]; ++q) {
+        if (p != q) {
+          adj[cols[p]].push_back(cols[q]);
+        }
+      }
+    }
+  }
+  for (auto& neighbours: adj) {
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+  }
+  return minimum_degree(std::move(adj), {});
+}
+
+}
+
+SparseLUFactorization::SparseLUFactorization(const SparseMatrix<double>& A, const SparseLUOptions& options)
+  : m_n{A.getRows()}, m_pinv(A.getRows(), -1), m_Lp(A.getRows() + 1, 0), m_Up(A.getRows() + 1, 0)
+{
+  if (A.getRows() != A.getCols()) {
+    throw std::runtime_error("Number of rows must equal number of columns!");
+  }
+  const int n = m_n;
+  if (options.ordering == SparseLUOptions::Ordering::MINIMUM_DEGREE) {
+    m_q = symmetric_ordering(A);
+  } else if (options.ordering == SparseLUOptions::Ordering::COLUMN_MINIMUM_DEGREE) {
+    m_q = column_ordering(A);
+  } else {
+    m_q.resize(n);
+    for (int j = 0; j < n; ++j) {
+      m_q[j] = j;
+    }
+  }
+  // the CSR arrays of A^T are the columns of A
+  const SparseMatrix<double> At = A.transpose();
+  const auto& Ap = At.row_offsets();
+  const auto& Ai = At.col_indices();
+  const auto& Ax = At.values();
+
+  std::vector<double> x (n, 0);
+  // xi[top..n) is the pattern of column k in topological order
+  std::vector<int> xi (n), stack (n), pstack (n), mark (n, -1);
+
+  for (int k = 0; k < n; ++k) {
+    const int col = m_q[k];
+    // 1. rows reachable from the nonzeros of A(:, col) through the graph of L, depth first
+    int top = n;
+    for (int p = Ap[col]; p < Ap[col + 1]; ++p) {
+      if (mark[Ai[p]] == k) {
+        continue;
+      }
+      int head = 0;
+      stack[0] = Ai[p];
+      while (head >= 0) {
+        const int j = stack[head];
+        const int jnew = m_pinv[j];
+        if (mark[j] != k) {
+          mark[j] = k;
+          // skip the unit diagonal, it is row j itself
+          pstack[head] = jnew < 0 ? 0 : m_Lp[jnew] + 1;
+        }
+        bool done = true;
+        const int end = jnew < 0 ? 0 : m_Lp[jnew + 1];
+        for (int q = pstack[head]; q < end; ++q) {
+          const int i = m_Li[q];
+          if (mark[i] == k) {
+            continue;
+          }
+          pstack[head] = q + 1;
+          stack[++head] = i;
+          done = false;
+          break;
+        }
+        if (done) {
+          --head;
+          xi[--top] = j;
+        }
+      }
+    }
+    // 2. x = L \ A(:, col) on that pattern only
+    for (int p = Ap[col]; p < Ap[col + 1]; ++p) {
+      x[Ai[p]] = Ax[p];
+    }
+    for (int px = top; px < n; ++px) {
+      const int j = xi[px];
+      const int J = m_pinv[j];
+      if (J < 0) {
+        continue;
+      }
+      for (int p = m_Lp[J] + 1; p < m_Lp[J + 1]; ++p) {
+        x[m_Li[p]] -= m_Lx[p] * x[j];
+      }
+    }
+    // 3. rows already pivoted go to U, the largest remaining one is the pivot candidate
+    int ipiv = -1;
+    double max_val = -1;
+    for (int px = top; px < n; ++px) {
+      const int i = xi[px];
+      if (m_pinv[i] < 0) {
+        if (std::abs(x[i]) > max_val) {
+          max_val = std::abs(x[i]);
+          ipiv = i;
+        }
+      } else {
+        m_Ui.push_back(m_pinv[i]);
+        m_Ux.push_back(x[i]);
+      }
+    }
+    if (ipiv == -1 || max_val < THRESHOLD) {
+      m_invertible = false;
+      return;
+    }
+    if (m_pinv[col] < 0 && std::abs(x[col]) >= options.pivot_tolerance * max_val) {
+      ipiv = col;
+    }
+    const double pivot = x[ipiv];
+    m_Ui.push_back(k);
+    m_Ux.push_back(pivot);
+    m_pinv[ipiv] = k;
+    m_Li.push_back(ipiv);
+    m_Lx.push_back(1);
+    for (int px = top; px < n; ++px) {
+      const int i = xi[px];
+      if (m_pinv[i] < 0) {
+        m_Li.push_back(i);
+        m_Lx.push_back(x[i] / pivot);
+      }
+      x[i] = 0;
+    }
+    m_Lp[k + 1] = m_Li.size();
+    m_Up[k + 1] = m_Ui.size();
+  }
+  // rows of L were kept as rows of A so far
+  for (auto& i: m_Li) {
+    i = m_pinv[i];
+  }
+}
+
+std::vector<double> SparseLUFactorization::solve(const std::vector<double>& b) const {
+  if (!m_invertible) {
+    throw std::runtime_error("Matrix is not invertible!");
+  }
+  if (static_cast<int>(b.size()) != m_n) {
+    throw std::runtime_error("A and b need to have the same number of rows");
+  }
+  std::vector<double> y (m_n);
+  for (int i = 0; i < m_n; ++i) {
+    y[m_pinv[i]] = b[i];
+  }
+  // L y = Pb
+  for (int j = 0; j < m_n; ++j) {
+    for (int p = m_Lp[j] + 1; p < m_Lp[j + 1]; ++p) {
+      y[m_Li[p]] -= m_Lx[p] * y[j];
+    }
+  }
+  // U z = y
+  for (int j = m_n - 1; j >= 0; --j) {
+    y[j] /= m_Ux[m_Up[j + 1] - 1];
+    for (int p = m_Up[j]; p < m_Up[j + 1] - 1; ++p) {
+      y[m_Ui[p]] -= m_Ux[p] * y[j];
+    }
+  }
+  // x = Q z
+  std::vector<double> x (m_n);
+  for (int k = 0; k < m_n; ++k) {
+    x[m_q[k]] = y[k];
+  }
+  return x;
+}
+
+Solution::SystemSolution solve_linear_system(const SparseMatrix<double>& A, const Matrix<double>& b) {
+  using namespace Solution;
+  if (A.getRows() != b.getRows()) {
+    throw std::runtime_error("A and b need to have the same number of rows");
+  }
+  if (A.getRows() == A.getCols() && b.getCols() == 1) {
+    SparseLUFactorization lu {A};
+    if (lu.is_invertible()) {
+      std::vector<double> x = lu.solve(b.flatten());
+      std::vector<VariableSolution> solutions;
+      solutions.reserve(x.size());
+      for (double v: x) {
+        round_if_below_threshold(v);
+        solutions.emplace_back(VariableSolution{.val=v});
+      }
+      return SystemSolution{.type = SolutionType::ONE_SOLUTION, .m_solutions=solutions};
+    }
+  }
+  // singular or rectangular: the free variables / inconsistency need the RREF anyway
+  return solve_linear_system(A.to_dense(), b);
+}
+
+}
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "Strassen.h"
+
+namespace linalg::kernels {
+
+namespace {
+
+// Z = X + Y and Z = X - Y on m x n blocks, Z may be X or Y
+void add(int m, int n, const double* X, int ldx, const double* Y, int ldy, double* Z, int ldz) {
+  for (int i = 0; i < m; ++i) {
+    const double* x = X + static_cast<std::size_t>(i) * ldx;
+    const double* y = Y + static_cast<std::size_t>(i) * ldy;
+    double* z = Z + static_cast<std::size_t>(i) * ldz;
+    for (int j = 0; j < n; ++j) {
+      z[j] = x[j] + y[j];
+    }
+  }
+}
+
+void sub(int m, int n, const double* X, int ldx, const double* Y, int ldy, double* Z, int ldz) {
+  for (int i = 0; i < m; ++i) {
+    const double* x = X + static_cast<std::size_t>(i) * ldx;
+    const double* y = Y + static_cast<std::size_t>(i) * ldy;
+    double* z = Z + static_cast<std::size_t>(i) * ldz;
+    for (int j = 0; j < n; ++j) {
+      z[j] = x[j] - y[j];
+    }
+  }
+}
+
+void zero(int m, int n, double* Z, int ldz) {
+  for (int i = 0; i < m; ++i) {
+    std::fill_n(Z + static_cast<std::size_t>(i) * ldz, n, 0.0);
+  }
+}
+
+bool is_base_case(int m, int n, int k, int crossover) {
+  return std::min({m, n, k}) <= std::max(crossover, 1);
+}
+
+// C = A B for even m, n, k: one level of Winograd's variant, scheduled as in Boyer, Dumas,
+// Pernet and Zhou (2009) so the only scratch besides the quadrants of C is X (m/2 x max(k, n)/2)
+// and Y (k/2 x n/2); the recursive products reuse the space after them.
+void winograd(int m, int n, int k, const double* A, int lda, const double* B, int ldb, double* C, int ldc,
+              const StrassenOptions& options, double* work);
+
+// C = A B for any sizes: base case, or peel odd sizes and recurse on the even part
+void multiply(int m, int n, int k, const double* A, int lda, const double* B, int ldb, double* C, int ldc,
+              const StrassenOptions& options, double* work) {
+  if (is_base_case(m, n, k, options.crossover)) {
+    zero(m, n, C, ldc);
+    gemm(m, n, k, A, lda, B, ldb, C, ldc, options.gemm);
+    return;
+  }
+  const int me = m & ~1, ne = n & ~1, ke = k & ~1;
+  winograd(me, ne, ke, A, lda, B, ldb, C, ldc, options, work);
+  if (ke != k) {
+    // rank one update with the last column of A and last row of B
+    gemm(me, ne, 1, A + ke, lda, B + static_cast<std::size_t>(ke) * ldb, ldb, C, ldc, options.gemm);
+  }
+  if (ne != n) {
+    zero(m, 1, C + ne, ldc);
+    gemm(m, 1, k, A, lda, B + ne, ldb, C + ne, ldc, options.gemm);
+  }
+  if (me != m) {
+    double* last_row = C + static_cast<std::size_t>(me) * ldc;
+    zero(1, ne, last_row, ldc);
+    gemm(1, ne, k, A + static_cast<std::size_t>(me) * lda, lda, B, ldb, last_row, ldc, options.gemm);
+  }
+}
+
+void winograd(int m, int n, int k, const double* A, int lda, const double* B, int ldb, double* C, int ldc,
+              const StrassenOptions& options, double* work) {
+  const int mh = m / 2, nh = n / 2, kh = k / 2;
+  const double* A11 = A;
+  const double* A12 = A + kh;
+  const double* A21 = A + static_cast<std::size_t>(mh) * lda;
+  const double* A22 = A21 + kh;
+  const double* B11 = B;
+  const double* B12 = B + nh;
+  const double* B21 = B + static_cast<std::size_t>(kh) * ldb;
+  const double* B22 = B21 + nh;
+  double* C11 = C;
+  double* C12 = C + nh;
+  double* C21 = C + static_cast<std::size_t>(mh) * ldc;
+  double* C22 = C21 + nh;
+
+  // X holds an m/2 x k/2 sum of A blocks, later P1 (m/2 x n/2); Y a k/2 x n/2 sum of B blocks
+  const int ldx = std::max(kh, nh), ldy = nh;
+  double* X = work;
+  double* Y = X + static_cast<std::size_t>(mh) * ldx;
+  double* rest = Y + static_cast<std::size_t>(kh) * ldy;
+  auto product = [&](const double* L, int ldl, const double* R, int ldr, double* P, int ldp) {
+    multiply(mh, nh, kh, L, ldl, R, ldr, P, ldp, options, rest);
+  };
+
+  sub(mh, kh, A11, lda, A21, lda, X, ldx);          // S3 = A11 - A21
+  sub(kh, nh, B22, ldb, B12, ldb, Y, ldy);          // T3 = B22 - B12
+  product(X, ldx, Y, ldy, C21, ldc);                // P7 = S3 T3
+  add(mh, kh, A21, lda, A22, lda, X, ldx);          // S1 = A21 + A22
+  sub(kh, nh, B12, ldb, B11, ldb, Y, ldy);          // T1 = B12 - B11
+  product(X, ldx, Y, ldy, C22, ldc);                // P5 = S1 T1
+  sub(mh, kh, X, ldx, A11, lda, X, ldx);            // S2 = S1 - A11
+  sub(kh, nh, B22, ldb, Y, ldy, Y, ldy);            // T2 = B22 - T1
+  product(X, ldx, Y, ldy, C12, ldc);                // P6 = S2 T2
+  sub(mh, kh, A12, lda, X, ldx, X, ldx);            // S4 = A12 - S2
+  product(X, ldx, B22, ldb, C11, ldc);              // P3 = S4 B22
+  product(A11, lda, B11, ldb, X, ldx);              // P1 = A11 B11
+  add(mh, nh, X, ldx, C12, ldc, C12, ldc);          // U2 = P1 + P6
+  add(mh, nh, C12, ldc, C21, ldc, C21, ldc);        // U3 = U2 + P7
+  add(mh, nh, C12, ldc, C22, ldc, C12, ldc);        // U4 = U2 + P5
+  add(mh, nh, C21, ldc, C22, ldc, C22, ldc);        // U7 = U3 + P5 = C22
+  add(mh, nh, C12, ldc, C11, ldc, C12, ldc);        // U5 = U4 + P3 = C12
+  sub(kh, nh, Y, ldy, B21, ldb, Y, ldy);            // T4 = T2 - B21
+  product(A22, lda, Y, ldy, C11, ldc);              // P4 = A22 T4
+  sub(mh, nh, C21, ldc, C11, ldc, C21, ldc);        // U6 = U3 - P4 = C21
+  product(A12, lda, B21, ldb, C11, ldc);            // P2 = A12 B21
+  add(mh, nh, X, ldx, C11, ldc, C11, ldc);          // U1 = P1 + P2 = C11
+}
+
+}
+
+std::size_t strassen_workspace(int m, int n, int k, int crossover) {
+  if (is_base_case(m, n, k, crossover)) {
+    return 0;
+  }
+  const int mh = m / 2, nh = n / 2, kh = k / 2;
+  const std::size_t level = static_cast<std::size_t>(mh) * std::max(kh, nh) + static_cast<std::size_t>(kh) * nh;
+  return level + strassen_workspace(mh, nh, kh, crossover);
+}
+
+void strassen_gemm(int m, int n, int k, const double* A, int lda, const double* B, int ldb, double* C, int ldc,
+                   const StrassenOptions& options, double* work) {
+  std::vector<double> owned;
+  if (work == nullptr) {
+    owned.resize(strassen_workspace(m, n, k, options.crossover));
+    work = owned.data();
+  }
+  multiply(m, n, k, A, lda, B, ldb, C, ldc, options, work);
+}
+
+}
+
+namespace linalg {
+
+Matrix<double> strassen_multiply(const Matrix<double>& A, const Matrix<double>& B, const StrassenOptions& options) {
+  if (A.getCols() != B.getRows()) {
+    throw std::runtime_error("Rows and cols dimension mismatch!");
+  }
+  Matrix<double> result {A.getRows(), B.getCols()};
+  kernels::strassen_gemm(A.getRows(), B.getCols(), A.getCols(), A.data(), A.stride(), B.data(), B.stride(),
+                         result.data(), result.stride(), options);
+  return result;
+}
+
+}
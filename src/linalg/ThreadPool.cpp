@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+#include "ThreadPool.h"
+
+namespace linalg {
+
+namespace {
+
+// set while a thread executes a chunk, nested loops then run inline
+thread_local bool in_parallel_region = false;
+
+std::uint64_t pack(std::uint32_t begin, std::uint32_t end) {
+  return static_cast<std::uint64_t>(begin) << 32 | end;
+}
+
+std::uint32_t run_begin(std::uint64_t run) {return run >> 32;}
+std::uint32_t run_end(std::uint64_t run) {return run & 0xffffffffu;}
+
+}
+
+ThreadPool::ThreadPool(int num_threads) {
+  if (num_threads <= 0) {
+    throw std::runtime_error("Thread pool needs at least one thread!");
+  }
+  m_size = num_threads;
+  m_runs = std::make_unique<Run[]>(m_size);
+  for (int i = 1; i < m_size; ++i) {
+    m_workers.emplace_back(&ThreadPool::worker_loop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock {m_mutex};
+    m_stop = true;
+  }
+  m_start.notify_all();
+  for (auto& worker: m_workers) {
+    worker.join();
+  }
+}
+
+// owner side: the first chunk of its own run
+bool ThreadPool::take_chunk(int participant, int& chunk) {
+  auto& chunks = m_runs[participant].chunks;
+  std::uint64_t run = chunks.load(std::memory_order_acquire);
+  while (run_begin(run) < run_end(run)) {
+    if (chunks.compare_exchange_weak(run, pack(run_begin(run) + 1, run_end(run)), std::memory_order_acq_rel)) {
+      chunk = run_begin(run);
+      return true;
+    }
+  }
+  return false;
+}
+
+// thief side: moves the back half of another run into the (empty) run of participant.
+// false once every run is empty
+bool ThreadPool::steal(int participant) {
+  for (int i = 1; i < m_participants; ++i) {
+    auto& victim = m_runs[(participant + i) % m_participants].chunks;
+    std::uint64_t run = victim.load(std::memory_order_acquire);
+    while (run_begin(run) < run_end(run)) {
+      const std::uint32_t begin = run_begin(run), end = run_end(run), middle = begin + (end - begin) / 2;
+      if (victim.compare_exchange_weak(run, pack(begin, middle), std::memory_order_acq_rel)) {
+        m_runs[participant].chunks.store(pack(middle, end), std::memory_order_release);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ThreadPool::run_chunks(int participant) {
+  if (participant >= m_participants) {
+    return;
+  }
+  in_parallel_region = true;
+  try {
+    if (m_static) {
+      // contiguous slice per participant
+      int per_participant = (m_n + m_participants - 1) / m_participants;
+      int begin = participant * per_participant, end = std::min(m_n, begin + per_participant);
+      if (begin < end) {
+        (*m_fn)(begin, end);
+      }
+    } else {
+      int chunk;
+      while (!m_failed.load(std::memory_order_relaxed) &&
+             (take_chunk(participant, chunk) || (steal(participant) && take_chunk(participant, chunk)))) {
+        const int begin = chunk * m_chunk;
+        (*m_fn)(begin, std::min(m_n, begin + m_chunk));
+      }
+    }
+  } catch (...) {
+    // kept for parallel_for to rethrow once every participant is done with fn
+    std::lock_guard lock {m_mutex};
+    if (!m_error) {
+      m_error = std::current_exception();
+    }
+    m_failed.store(true, std::memory_order_relaxed);
+  }
+  in_parallel_region = false;
+}
+
+void ThreadPool::worker_loop(int id) {
+  unsigned long seen = 0;
+  while (true) {
+    {
+      std::unique_lock lock {m_mutex};
+      m_start.wait(lock, [&] {return m_stop || m_generation != seen;});
+      if (m_stop) {
+        return;
+      }
+      seen = m_generation;
+    }
+    run_chunks(id);
+    {
+      std::lock_guard lock {m_mutex};
+      --m_busy;
+    }
+    m_done.notify_one();
+  }
+}
+
+void ThreadPool::parallel_for(int n, int grain, const std::function<void(int, int)>& fn, bool static_schedule,
+                              int max_threads) {
+  if (n <= 0) {
+    return;
+  }
+  grain = std::max(grain, 1);
+  const int participants = max_threads > 0 ? std::min(max_threads, m_size) : m_size;
+  if (participants == 1 || in_parallel_region || n <= grain) {
+    fn(0, n);
+    return;
+  }
+  std::lock_guard call_lock {m_call_mutex};
+  {
+    std::lock_guard lock {m_mutex};
+    m_fn = &fn;
+    m_n = n;
+    // a few chunks per thread so uneven rows balance out
+    m_chunk = std::max(grain, n / (4 * participants));
+    m_static = static_schedule;
+    m_participants = participants;
+    // participant i starts with the i-th contiguous run of chunks
+    const int chunks = (n + m_chunk - 1) / m_chunk;
+    for (int i = 0; i < participants; ++i) {
+      m_runs[i].chunks.store(pack(static_cast<std::int64_t>(chunks) * i / participants,
+                                  static_cast<std::int64_t>(chunks) * (i + 1) / participants), std::memory_order_relaxed);
+    }
+    m_busy = m_size - 1;
+    m_error = nullptr;
+    m_failed.store(false, std::memory_order_relaxed);
+    ++m_generation;
+  }
+  m_start.notify_all();
+  // does not throw, so fn outlives every worker still calling it
+  run_chunks(0);
+  std::exception_ptr error;
+  {
+    std::unique_lock lock {m_mutex};
+    m_done.wait(lock, [&] {return m_busy == 0;});
+    m_fn = nullptr;
+    std::swap(error, m_error);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+namespace {
+
+std::unique_ptr<ThreadPool>& default_pool_ptr() {
+  static std::unique_ptr<ThreadPool> pool;
+  return pool;
+}
+
+std::mutex default_pool_mutex;
+
+}
+
+ThreadPool& default_thread_pool() {
+  std::lock_guard lock {default_pool_mutex};
+  auto& pool = default_pool_ptr();
+  if (!pool) {
+    pool = std::make_unique<ThreadPool>(std::max(1u, std::thread::hardware_concurrency()));
+  }
+  return *pool;
+}
+
+void set_num_threads(int num_threads) {
+  std::lock_guard lock {default_pool_mutex};
+  default_pool_ptr() = std::make_unique<ThreadPool>(num_threads);
+}
+
+int get_num_threads() {
+  return default_thread_pool().size();
+}
+
+}
@@ -1,7 +1,20 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <string>
 #include <vector>
 
+#include "BatchedSolver.h"
+#include "IterativeSolvers.h"
+#include "LUFactorization.h"
 #include "Matrix.h"
+#include "MatrixIO.h"
+#include "OutOfCore.h"
+#include "ParametricSolution.h"
+#include "Simd.h"
+#include "SparseLU.h"
+#include "ThreadPool.h"
 
 typedef linalg::Matrix<double> Md;
 
@@ -66,6 +79,74 @@ TEST(EquationSolverTest, InfiniteSolutions_System2) {
     EXPECT_TRUE(fun({1,2}) == std::vector<double>({-25,1,4,2,-4}));
 }
 
+TEST(EquationSolverTest, ParametricSolution) {
+    Md a {{0,0,2,4,2},{1,2,4,5,3},{-2,-4,-5,-4,3}};
+    Md b {{8},{-9},{6}};
+    auto S = solve_linear_system(a, b);
+    ParametricSolution x {S};
+    EXPECT_EQ(x.free_variables(), std::vector<int>({1, 3}));
+    EXPECT_TRUE(x.particular() == std::vector<double>({-29,0,8,0,-4}));
+    // A N = 0
+    EXPECT_TRUE(Md(a * x.null_space()) == Md(3, 2));
+
+    Md params {{1,2},{0,0},{-3,0.5},{2,-1}};
+    Md X = x.evaluate(params);
+    auto fun = S.get_compute_function();
+    for (int i = 0; i < params.getRows(); ++i) {
+      auto expected = fun({params(i, 0), params(i, 1)});
+      EXPECT_TRUE(X.row(i).flatten() == expected);
+      EXPECT_TRUE(x(params.row(i).flatten()) == expected);
+    }
+    // a transposed view goes through a copy
+    Md paramsT = params.transpose();
+    EXPECT_TRUE(x.evaluate(paramsT.view().transpose()) == X);
+    EXPECT_THROW(x(std::vector<double>{1}), std::runtime_error);
+
+    EXPECT_THROW(ParametricSolution(solve_linear_system(Md{{1,2},{2,4}}, Md{{1},{3}})), std::runtime_error);
+    ParametricSolution unique {solve_linear_system(Md{{2,0},{0,4}}, Md{{2},{2}})};
+    EXPECT_EQ(unique.num_free_variables(), 0);
+    EXPECT_TRUE(unique(std::vector<double>{}) == std::vector<double>({1, 0.5}));
+}
+
+TEST(EquationSolverTest, BatchedEvaluation) {
+    Md a {{1,2,0,1,-1,3},{0,0,1,2,1,-1}};
+    Md b {{4},{1}};
+    auto S = solve_linear_system(a, b);
+    ParametricSolution x {S};
+    ASSERT_EQ(x.num_free_variables(), 4);
+    auto fun = S.get_compute_function();
+
+    const int count = 300;
+    Md params (count, 4);
+    for (int i = 0; i < count; ++i) {
+      for (int j = 0; j < 4; ++j) {
+        params(i, j) = std::sin(i + 0.7 * j);
+      }
+    }
+    Md expected (count, 6);
+    for (int i = 0; i < count; ++i) {
+      auto row = fun({params(i, 0), params(i, 1), params(i, 2), params(i, 3)});
+      std::copy(row.begin(), row.end(), expected.data() + i * expected.stride());
+    }
+
+    // the output is reused between calls
+    Md out (count, 6, -1);
+    x.evaluate(params.view(), out.view());
+    EXPECT_TRUE(out == expected);
+    ThreadPool pool {4};
+    out = Md(count, 6, -1);
+    x.evaluate(params.view(), out.view(), {.pool = &pool, .parallel_threshold = 0});
+    EXPECT_TRUE(out == expected);
+
+    std::vector<double> flat (params.data(), params.data() + count * 4), flat_out (count * 6);
+    x.evaluate(flat, flat_out, {.num_threads = 1});
+    std::copy(flat_out.begin(), flat_out.end(), out.data());
+    EXPECT_TRUE(out == expected);
+
+    EXPECT_THROW(x.evaluate(params.view(), out.block(0, 0, count, 5)), std::runtime_error);
+    EXPECT_THROW(x.evaluate(flat, std::span<double>{flat_out}.first(count * 6 - 1)), std::runtime_error);
+}
+
 TEST(EquationSolverTest, OneSolution_System1) {
     Md a {{1,0,0,0},{1,1,1,1},{1,3,9,27},{1,4,16,64}};
     Md b {{10},{7},{-11},{-14}};
@@ -101,3 +182,394 @@ TEST(EquationSolverTest, OneSolution_System2) {
     EXPECT_EQ(S.num_free_variables, 0);
     EXPECT_EQ(S.toString(), "x1: 0.667, x2: 1, x3: -0.333");
 }
+
+// reusing one factorization for many right hand sides
+
+TEST(EquationSolverTest, LUFactorizationSolve) {
+    Md a {{1,0,0,0},{1,1,1,1},{1,3,9,27},{1,4,16,64}};
+    LUFactorization lu {a};
+    EXPECT_EQ(lu.rank(), 4);
+    EXPECT_TRUE(lu.is_invertible());
+    EXPECT_TRUE(lu.solve(std::vector<double>{10,7,-11,-14}) == std::vector<double>({10,2,-6,1}));
+
+    Md B {{10,1},{7,4},{-11,40},{-14,85}};
+    Md expected {{10,1},{2,1},{-6,1},{1,1}};
+    EXPECT_EQ(lu.solve(B), expected);
+    EXPECT_EQ(lu.inverse(), inverse(a));
+    EXPECT_NEAR(lu.determinant(), 72, 1e-9);
+}
+
+TEST(EquationSolverTest, LUFactorizationBlocked) {
+    // small block size so several panels and trailing updates are exercised
+    int n = 23;
+    Md a (n, n);
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < n; ++j) {
+        a(i, j) = std::cos(i * 0.9 + j * 2.1) + (i == j ? 3 : 0);
+      }
+    }
+    LUFactorization blocked {a, 4}, unblocked {a, n};
+    EXPECT_EQ(blocked.packed(), unblocked.packed());
+    EXPECT_EQ(blocked.permutation(), unblocked.permutation());
+    EXPECT_EQ(blocked.inverse() * a, IdentityMatrix<double>(n));
+}
+
+TEST(EquationSolverTest, LUFactorizationSingular) {
+    // rank deficient columns are skipped like in gaussian_elimination
+    Md a {{0,1,2},{0,2,4},{0,3,7}};
+    LUFactorization lu {a, 2};
+    EXPECT_EQ(lu.rank(), get_rank(a));
+    EXPECT_FALSE(lu.is_invertible());
+    EXPECT_EQ(lu.determinant(), 0);
+    EXPECT_THROW(lu.solve(std::vector<double>{1,2,3}), std::runtime_error);
+
+    Md wide {{1,2,1,4},{-2,-3,1,0},{3,5,0,4}};
+    EXPECT_EQ(LUFactorization(wide, 1).rank(), get_rank(wide));
+    EXPECT_THROW(LUFactorization(wide).determinant(), std::runtime_error);
+}
+
+TEST(EquationSolverTest, DeterminantNormsAndRcond) {
+    Md a {{1,0,0,0},{1,1,1,1},{1,3,9,27},{1,4,16,64}};
+    EXPECT_NEAR(determinant(a), 72, 1e-9);
+    LUFactorization lu {a};
+    auto log_det = lu.log_determinant();
+    EXPECT_EQ(log_det.sign, 1);
+    EXPECT_NEAR(log_det.log_abs, std::log(72), 1e-12);
+    EXPECT_EQ(LUFactorization(Md{{0,1,2},{0,2,4},{0,3,7}}).log_determinant().sign, 0);
+
+    // the determinant overflows, its logarithm does not
+    Md big (3, 3);
+    big(0, 1) = 1e200, big(1, 0) = 1e200, big(2, 2) = -1e200;
+    EXPECT_TRUE(std::isinf(determinant(big)));
+    log_det = LUFactorization(big).log_determinant();
+    EXPECT_EQ(log_det.sign, 1);
+    EXPECT_NEAR(log_det.log_abs, 600 * std::log(10), 1e-9);
+
+    Md m {{1,-2,3},{-4,5,-6}};
+    EXPECT_DOUBLE_EQ(norm(m, NormType::ONE), 9);
+    EXPECT_DOUBLE_EQ(norm(m, NormType::INF), 15);
+    EXPECT_DOUBLE_EQ(norm(m, NormType::FROBENIUS), std::sqrt(91));
+    Md mT = m.transpose();
+    EXPECT_DOUBLE_EQ(norm(mT.view().transpose(), NormType::INF), 15);
+
+    // hilbert matrices are famously ill conditioned, 1-norm condition of H_6 is about 2.9e7
+    int n = 6;
+    Md hilbert (n, n);
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < n; ++j) {
+        hilbert(i, j) = 1.0 / (i + j + 1);
+      }
+    }
+    double exact = 1 / (norm(hilbert, NormType::ONE) * norm(inverse(hilbert), NormType::ONE));
+    double estimate = LUFactorization(hilbert).rcond();
+    EXPECT_GE(estimate, exact * (1 - 1e-6));
+    EXPECT_LE(estimate, 3 * exact);
+    EXPECT_NEAR(LUFactorization(IdentityMatrix<double>(5)).rcond(), 1, 1e-15);
+    EXPECT_EQ(LUFactorization(Md{{0,1,2},{0,2,4},{0,3,7}}).rcond(), 0);
+    EXPECT_THROW(LUFactorization(m).rcond(), std::runtime_error);
+}
+
+// many right hand sides against the same A
+
+TEST(EquationSolverTest, MultipleRightHandSides) {
+    Md a {{0,0,2,4,2},{1,2,4,5,3},{-2,-4,-5,-4,3}};
+    // consistent, consistent, and b3 = (0, 0, 1) which is consistent too since rank(A) = 3
+    Md B {{8,0,0},{-9,1,0},{6,0,1}};
+    auto solutions = solve_linear_systems(a, B);
+    ASSERT_EQ(solutions.size(), 3u);
+    for (int j = 0; j < 3; ++j) {
+      Md b (3, 1);
+      for (int i = 0; i < 3; ++i) {
+        b(i, 0) = B(i, j);
+      }
+      auto expected = solve_linear_system(a, b);
+      EXPECT_EQ(solutions[j].type, expected.type);
+      EXPECT_EQ(solutions[j].free_variables, expected.free_variables);
+      EXPECT_EQ(solutions[j].toString(), expected.toString());
+    }
+    EXPECT_EQ(solutions[0].toString(), "x1:-29-2a1+3a2, x2:a1, x3:8-2a2, x4:a2, x5:-4 where a1, a2 are arbitrary parameters");
+}
+
+TEST(EquationSolverTest, MultipleRightHandSidesMixedTypes) {
+    // rank deficient A: one consistent and one inconsistent right hand side
+    Md a {{1,2,1},{2,-2,2},{4,8,4}};
+    std::vector<std::vector<double>> bs {{1,2,4}, {1,2,-4}};
+    auto solutions = solve_linear_systems(a, std::span<const std::vector<double>>(bs));
+    EXPECT_EQ(solutions[0].type, Solution::SolutionType::INFINITELY_MANY_SOLUTIONS);
+    EXPECT_EQ(solutions[0].toString(), solve_linear_system(a, Md{{1},{2},{4}}).toString());
+    EXPECT_EQ(solutions[1].type, Solution::SolutionType::NO_SOLUTION);
+    EXPECT_TRUE(solutions[1].m_solutions.empty());
+}
+
+// sparse systems
+
+TEST(EquationSolverTest, SparseLUMatchesDense) {
+    // 5-point laplacian on a 12 x 12 grid, plus an unsymmetric term
+    int g = 12, n = g * g;
+    std::vector<Triplet<double>> entries;
+    for (int i = 0; i < g; ++i) {
+      for (int j = 0; j < g; ++j) {
+        int k = i * g + j;
+        entries.push_back({k, k, 4});
+        if (i > 0) entries.push_back({k, k - g, -1});
+        if (i < g - 1) entries.push_back({k, k + g, -1.5});
+        if (j > 0) entries.push_back({k, k - 1, -1});
+        if (j < g - 1) entries.push_back({k, k + 1, -0.5});
+      }
+    }
+    SparseMatrix<double> A {n, n, entries};
+    Md b (n, 1);
+    for (int i = 0; i < n; ++i) {
+      b(i, 0) = i % 7 - 3;
+    }
+    auto sparse = solve_linear_system(A, b);
+    auto dense = solve_linear_system(A.to_dense(), b);
+    ASSERT_EQ(sparse.type, Solution::SolutionType::ONE_SOLUTION);
+    for (int i = 0; i < n; ++i) {
+      EXPECT_NEAR(sparse.m_solutions[i].val, dense.m_solutions[i].val, 1e-9);
+    }
+
+    // the ordering keeps fill well below the natural one
+    SparseLUFactorization ordered {A}, by_columns {A, {.ordering = SparseLUOptions::Ordering::COLUMN_MINIMUM_DEGREE}}, natural {A, {.ordering = SparseLUOptions::Ordering::NATURAL}};
+    EXPECT_LT(ordered.nonZerosL() + ordered.nonZerosU(), natural.nonZerosL() + natural.nonZerosU());
+    EXPECT_LT(by_columns.nonZerosL() + by_columns.nonZerosU(), natural.nonZerosL() + natural.nonZerosU());
+    EXPECT_TRUE(by_columns.solve(b.flatten()) == ordered.solve(b.flatten()));
+}
+
+TEST(EquationSolverTest, SparseLUPivotingAndFallback) {
+    // zero diagonal needs row exchanges
+    Md a {{0,2,0,1},{3,0,0,0},{0,0,0,4},{1,0,5,0}};
+    SparseLUFactorization lu {SparseMatrix<double>(a)};
+    EXPECT_TRUE(lu.is_invertible());
+    std::vector<double> x = lu.solve({5, 3, 8, 11});
+    EXPECT_TRUE(x == std::vector<double>({1,1.5,2,2}));
+
+    // singular systems go through the dense solver
+    Md c {{0,2,2,1,-2},{0,0,1,1,1},{0,0,0,0,2}};
+    Md b {{2},{3},{4}};
+    EXPECT_EQ(solve_linear_system(SparseMatrix<double>(c), b).toString(), solve_linear_system(c, b).toString());
+    Md d {{1,2},{2,4}};
+    EXPECT_FALSE(SparseLUFactorization(SparseMatrix<double>(d)).is_invertible());
+    EXPECT_EQ(solve_linear_system(SparseMatrix<double>(d), Md{{1},{3}}).type, Solution::SolutionType::NO_SOLUTION);
+}
+
+// iterative solvers
+
+namespace {
+
+// 2D laplacian on a g x g grid (symmetric positive definite), plus an optional convection term
+SparseMatrix<double> grid_matrix(int g, double convection=0) {
+    std::vector<Triplet<double>> entries;
+    for (int i = 0; i < g; ++i) {
+      for (int j = 0; j < g; ++j) {
+        int k = i * g + j;
+        entries.push_back({k, k, 4});
+        if (i > 0) entries.push_back({k, k - g, -1 - convection});
+        if (i < g - 1) entries.push_back({k, k + g, -1 + convection});
+        if (j > 0) entries.push_back({k, k - 1, -1});
+        if (j < g - 1) entries.push_back({k, k + 1, -1});
+      }
+    }
+    return SparseMatrix<double>{g * g, g * g, entries};
+}
+
+double max_difference(const Solution::SystemSolution& solution, const std::vector<double>& expected) {
+    double diff = 0;
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+      diff = std::max(diff, std::abs(solution.m_solutions[i].val - expected[i]));
+    }
+    return diff;
+}
+
+}
+
+TEST(EquationSolverTest, KrylovSolversMatchDirect) {
+    Md a {{4,1,0,0},{1,5,2,0},{0,2,6,1},{0,0,1,3}};
+    Md b {{1},{2},{3},{4}};
+    auto direct = solve_linear_system(a, b);
+    JacobiPreconditioner jacobi {a};
+    ILU0Preconditioner ilu {a};
+    for (const Preconditioner* m: {static_cast<const Preconditioner*>(nullptr), static_cast<const Preconditioner*>(&jacobi), static_cast<const Preconditioner*>(&ilu)}) {
+      IterativeOptions options {.tolerance = 1e-12, .preconditioner = m};
+      IterativeReport report;
+      for (auto solution: {conjugate_gradient(a, b, options, &report), gmres(a, b, options), bicgstab(a, b, options)}) {
+        EXPECT_EQ(solution.type, Solution::SolutionType::ONE_SOLUTION);
+        for (int i = 0; i < 4; ++i) {
+          EXPECT_NEAR(solution.m_solutions[i].val, direct.m_solutions[i].val, 1e-9);
+        }
+      }
+      EXPECT_TRUE(report.converged);
+      EXPECT_LE(report.iterations, 4);
+      EXPECT_EQ(report.residuals.size(), static_cast<std::size_t>(report.iterations) + 1);
+    }
+    // ilu(0) of a tridiagonal matrix is exact
+    IterativeReport report;
+    gmres(a, b, {.preconditioner = &ilu}, &report);
+    EXPECT_EQ(report.iterations, 1);
+}
+
+TEST(EquationSolverTest, KrylovSolversLargeSparse) {
+    int g = 30, n = g * g;
+    std::vector<double> b (n, 1);
+    SparseMatrix<double> spd = grid_matrix(g), convective = grid_matrix(g, 0.5);
+
+    // matrix-free operator for the laplacian
+    FunctionOperator laplacian {n, [&](const std::vector<double>& x, std::vector<double>& y) {
+      y = spd * x;
+    }};
+    IterativeReport plain, preconditioned;
+    ILU0Preconditioner ilu {spd};
+    auto x = conjugate_gradient(laplacian, b, {}, &plain);
+    conjugate_gradient(SparseMatrixOperator{spd}, b, {.preconditioner = &ilu}, &preconditioned);
+    EXPECT_LT(preconditioned.iterations, plain.iterations);
+    EXPECT_LT(plain.residuals.back(), 1e-10);
+
+    SparseLUFactorization lu {spd};
+    EXPECT_LT(max_difference(x, lu.solve(b)), 1e-8);
+
+    // unsymmetric: gmres with restarts and bicgstab
+    SparseLUFactorization lu_convective {convective};
+    ILU0Preconditioner ilu_convective {convective};
+    for (auto solution: {gmres(SparseMatrixOperator{convective}, b, {.restart = 10}),
+                         bicgstab(SparseMatrixOperator{convective}, b, {.preconditioner = &ilu_convective})}) {
+      EXPECT_LT(max_difference(solution, lu_convective.solve(b)), 1e-8);
+    }
+
+    IterativeReport failed;
+    EXPECT_THROW(conjugate_gradient(laplacian, b, {.max_iterations = 3}, &failed), std::runtime_error);
+    EXPECT_FALSE(failed.converged);
+    EXPECT_EQ(failed.iterations, 3);
+}
+
+// batched small systems
+
+TEST(EquationSolverTest, BatchedSolveMatchesDense) {
+    // 37 systems is not a multiple of the lanes, so the last chunk is padded
+    int n = 5, count = 37;
+    BatchedSystems systems {n, count};
+    for (int s = 0; s < count; ++s) {
+      for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+          // zero diagonal in some systems needs pivoting
+          systems.A(s, i, j) = i == j ? s % 3 : (i * 7 + j * 3 + s) % 11 - 5;
+        }
+        systems.b(s, i) = i - s % 4;
+      }
+    }
+    // rank 1
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < n; ++j) {
+        systems.A(10, i, j) = (i + 1) * (j + 1);
+      }
+    }
+
+    auto solutions = solve_batched(systems);
+    EXPECT_EQ(solutions.status[10], BatchStatus::SINGULAR);
+    for (int s = 0; s < count; ++s) {
+      Md A (n, n), b (n, 1);
+      for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+          A(i, j) = systems.A(s, i, j);
+        }
+        b(i, 0) = systems.b(s, i);
+      }
+      auto dense = solve_linear_system(A, b);
+      if (dense.type != Solution::SolutionType::ONE_SOLUTION) {
+        EXPECT_EQ(solutions.status[s], BatchStatus::SINGULAR);
+        EXPECT_TRUE(std::isnan(solutions(s, 0)));
+        continue;
+      }
+      ASSERT_EQ(solutions.status[s], BatchStatus::OK);
+      for (int i = 0; i < n; ++i) {
+        EXPECT_NEAR(solutions(s, i), dense.m_solutions[i].val, 1e-9);
+      }
+    }
+
+    // every kernel set gives the same answer
+    auto previous = simd::active_kernel_set();
+    simd::set_kernel_set(simd::KernelSet::SCALAR);
+    auto scalar = solve_batched(systems);
+    simd::set_kernel_set(previous);
+    for (int s = 0; s < count; ++s) {
+      for (int i = 0; i < n && solutions.status[s] == BatchStatus::OK; ++i) {
+        EXPECT_NEAR(scalar(s, i), solutions(s, i), 1e-12);
+      }
+    }
+
+    EXPECT_THROW(solve_batched(n, count, systems.A_data(), systems.b_data(), solutions.x, std::span<BatchStatus>{}), std::runtime_error);
+}
+
+TEST(EquationSolverTest, OutOfCoreMatchesInMemory) {
+    const std::string path = (std::filesystem::temp_directory_path() / "linalg_out_of_core_test.mat").string();
+    auto filled = [](int rows, int cols) {
+      Md A (rows, cols);
+      for (int i = 0; i < rows; ++i) {
+        for (int j = 0; j < cols; ++j) {
+          A(i, j) = std::sin(i * 1.3 + j * 0.7) + (i == j ? 2 : 0);
+        }
+      }
+      return A;
+    };
+    // variable j with free variable f set to f + 0.5
+    auto evaluate = [](const Solution::SystemSolution& s, int j) {
+      if (s.free_variables.contains(j)) {
+        return j + 0.5;
+      }
+      double value = s.m_solutions[j].val;
+      for (const auto& [f, coefficient]: s.m_solutions[j].variable_count_map) {
+        value += coefficient * (f + 0.5);
+      }
+      return value;
+    };
+    auto column = [](const std::vector<double>& v) {
+      Md b (static_cast<int>(v.size()), 1);
+      for (std::size_t i = 0; i < v.size(); ++i) {
+        b(i, 0) = v[i];
+      }
+      return b;
+    };
+    // square, tall and rank deficient (repeated and zero columns), in panels of 7 columns
+    Md square = filled(40, 40), tall = filled(50, 30), deficient = filled(35, 45);
+    for (int i = 0; i < 35; ++i) {
+      deficient(i, 10) = deficient(i, 3) - 2 * deficient(i, 20);
+      deficient(i, 11) = 0;
+      deficient(i, 40) = deficient(i, 2);
+    }
+    for (const Md* A: {&square, &tall, &deficient}) {
+      for (auto layout: {Layout::ROW_MAJOR, Layout::COL_MAJOR}) {
+        save_binary(*A, path, {.layout = layout});
+        OutOfCoreLU lu (path, {.panel_cols = 7});
+        LUFactorization in_memory {*A, 7};
+        EXPECT_EQ(lu.rank(), get_rank(*A));
+        EXPECT_EQ(lu.pivot_columns(), in_memory.pivot_columns());
+        EXPECT_EQ(lu.permutation(), in_memory.permutation());
+
+        const int rows = A->getRows(), cols = A->getCols();
+        std::vector<double> x (cols), inconsistent (rows, 1.0);
+        for (int j = 0; j < cols; ++j) {
+          x[j] = std::cos(j);
+        }
+        const std::vector<double> b = (*A * column(x)).flatten();
+        for (const auto& rhs: {b, inconsistent}) {
+          auto expected = solve_linear_system(*A, column(rhs));
+          auto solution = lu.solve(rhs);
+          ASSERT_EQ(solution.type, expected.type);
+          EXPECT_EQ(lu.solution_type(rhs), expected.type);
+          if (expected.type == Solution::SolutionType::NO_SOLUTION) {
+            continue;
+          }
+          EXPECT_EQ(solution.free_variables, expected.free_variables);
+          // the same point of the solution set for the same free values
+          for (int j = 0; j < cols; ++j) {
+            EXPECT_NEAR(evaluate(solution, j), evaluate(expected, j), 1e-8);
+          }
+        }
+        // converted once, every panel written once, and at least read back for the solves
+        const IOStats& stats = lu.io_stats();
+        EXPECT_EQ(stats.panels_written, static_cast<std::uint64_t>((cols + 6) / 7));
+        EXPECT_GE(stats.bytes_written, 2 * sizeof(double) * rows * cols);
+        EXPECT_GE(stats.bytes_read, 2 * sizeof(double) * rows * cols);
+      }
+    }
+    std::filesystem::remove(path);
+}
@@ -1,11 +1,41 @@
 #include <gtest/gtest.h>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory_resource>
+#include <optional>
+#include <random>
+#include <tuple>
 #include <vector>
 
+#include "Arena.h"
+#include "FixedMatrix.h"
+#include "LUFactorization.h"
 #include "Matrix.h"
+#include "MatrixAnalysis.h"
+#include "MatrixIO.h"
+#include "QRCPFactorization.h"
+#include "Simd.h"
+#include "SparseMatrix.h"
+#include "Strassen.h"
+#include "ThreadPool.h"
 
 typedef linalg::Matrix<int> Mint;
 typedef linalg::Matrix<double> Md;
 
+// dense matrix without structure, phase shifts it so two of them differ
+Md filled(int rows, int cols, double phase) {
+  Md M (rows, cols);
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      M(i, j) = std::sin(i * 0.37 + j * 1.1 + phase);
+    }
+  }
+  return M;
+}
+
 // Test fundamental matrix operations
 
 TEST(MatrixTest, AddMatrices) {
@@ -46,6 +76,36 @@ TEST(MatrixTest, TransposeMatrix) {
   EXPECT_EQ(A.transpose(), expected);
 }
 
+TEST(MatrixTest, TransposeLargeAndInPlace) {
+  // sizes straddling the tile size, square and rectangular
+  for (auto [rows, cols]: {std::pair{70, 70}, std::pair{33, 97}, std::pair{100, 1}, std::pair{5, 64}}) {
+    Mint A (rows, cols);
+    for (int i = 0; i < rows; ++i) {
+      for (int j = 0; j < cols; ++j) {
+        A(i, j) = i * 1000 + j;
+      }
+    }
+    Mint T = A.transpose();
+    ASSERT_EQ(T.getRows(), cols);
+    ASSERT_EQ(T.getCols(), rows);
+    for (int i = 0; i < rows; ++i) {
+      for (int j = 0; j < cols; ++j) {
+        ASSERT_EQ(T(j, i), A(i, j));
+      }
+    }
+
+    Mint B = A;
+    B.transpose_inplace();
+    EXPECT_EQ(B, T);
+    EXPECT_EQ(B.transpose_inplace(), A);
+
+    const int* buffer = B.data();
+    Mint C = std::move(B).transpose();
+    EXPECT_EQ(C.data(), buffer);
+    EXPECT_EQ(C, T);
+  }
+}
+
 
 TEST(MatrixTest, GetElementFromMatrix) {
   Md A {{1,2,3},{4,5,6},{7,8,9}};
@@ -85,6 +145,70 @@ TEST(MatrixTest, GaussJordanElimination) {
 TEST(MatrixTest, Rank) {
   Md A {{1,2,1},{-2,-3,1},{3,5,0}};
   EXPECT_EQ(linalg::get_rank(A), 2);
+
+  // the elimination rank is the one inverse and LUFactorization act on, the QRCP rank is
+  // relative to the largest column
+  Md graded {{1,0},{0,1e-12}};
+  EXPECT_EQ(linalg::get_rank(graded), 1);
+  EXPECT_EQ(linalg::LUFactorization(graded).rank(), 1);
+  EXPECT_EQ(linalg::analyze(graded).rank(), 1);
+  EXPECT_THROW(linalg::inverse(graded), std::runtime_error);
+  EXPECT_EQ(linalg::get_rank(graded, linalg::RankMethod::QRCP), 2);
+  Md tiny (2, 2);
+  tiny(0, 0) = tiny(1, 1) = 1e-11;
+  EXPECT_EQ(linalg::get_rank(tiny), linalg::analyze(tiny).rank());
+  EXPECT_EQ(linalg::get_rank(tiny, linalg::RankMethod::QRCP), 2);
+}
+
+TEST(MatrixTest, QRCP) {
+  // 60 x 45 of rank 8, then full rank 45 x 45, factored in blocks of 5
+  auto sampled = [](int rows, int cols, double a, double b, double diagonal) {
+    Md M (rows, cols);
+    for (int i = 0; i < rows; ++i) {
+      for (int j = 0; j < cols; ++j) {
+        M(i, j) = std::sin(i * a + j * b + 0.1 * i * j) + (i == j ? diagonal : 0);
+      }
+    }
+    return M;
+  };
+  Md U = sampled(60, 8, 0.9, 2.1, 0), V = sampled(8, 45, 1.7, 0.4, 0), S = sampled(45, 45, 1.3, 0.7, 3);
+  for (auto [A, rank]: {std::tuple{U * V, 8}, std::tuple{S, 45}}) {
+    linalg::QRCPFactorization qr {A, {.block_size = 5}};
+    EXPECT_EQ(qr.rank(), rank);
+    EXPECT_EQ(linalg::QRCPFactorization(A, {.rank_only = true, .block_size = 5}).rank(), rank);
+    EXPECT_EQ(linalg::get_rank(A, linalg::RankMethod::QRCP), rank);
+    // A P = Q R with orthonormal Q, and the bases rebuild A
+    Md Q = qr.Q(), R = qr.R(), AP (A.getRows(), A.getCols());
+    for (int j = 0; j < A.getCols(); ++j) {
+      for (int i = 0; i < A.getRows(); ++i) {
+        AP(i, j) = A(i, qr.permutation()[j]);
+      }
+    }
+    EXPECT_TRUE(Q * R == AP);
+    EXPECT_TRUE(Q.transpose() * Q == linalg::IdentityMatrix<double>(Q.getCols()));
+    auto cols = qr.column_space(), rows = qr.row_space();
+    ASSERT_EQ(static_cast<int>(cols.size()), rank);
+    Md rebuilt (A.getRows(), A.getCols());
+    for (int k = 0; k < rank; ++k) {
+      rebuilt = rebuilt + Md({cols[k]}).transpose() * Md({rows[k]});
+    }
+    EXPECT_TRUE(rebuilt == A);
+  }
+  // the rank does not depend on the scale, unlike an absolute threshold
+  Md tiny = S;
+  for (int i = 0; i < 45; ++i) {
+    for (int j = 0; j < 45; ++j) {
+      tiny(i, j) *= 1e-12;
+    }
+  }
+  EXPECT_EQ(linalg::get_rank(tiny, linalg::RankMethod::QRCP), 45);
+  EXPECT_EQ(linalg::get_rank(Md(3, 4), linalg::RankMethod::QRCP), 0);
+  EXPECT_TRUE(linalg::QRCPFactorization(Md(3, 4), {.rank_only = true}).column_space().empty());
+  // a looser tolerance drops the small singular directions of a perturbed rank 8 matrix
+  Md perturbed = U * V;
+  perturbed(0, 0) += 1e-9;
+  EXPECT_EQ(linalg::get_rank(perturbed, linalg::RankMethod::QRCP), 9);
+  EXPECT_EQ(linalg::QRCPFactorization(perturbed, {.tolerance = 1e-6}).rank(), 8);
 }
 
 TEST(MatrixTest, RowSpace){
@@ -99,6 +223,27 @@ TEST(MatrixTest, ColSpace){
   EXPECT_TRUE(linalg::get_col_space(A) == expected);
 }
 
+TEST(MatrixTest, Analysis){
+  Md A {{1,2,1,0},{-2,-3,1,1},{3,5,0,-1}};
+  auto analysis = linalg::analyze(A);
+  EXPECT_EQ(analysis.rank(), 2);
+  EXPECT_EQ(analysis.pivot_columns(), (std::vector<int>{0, 1}));
+  EXPECT_TRUE(analysis.rref() == linalg::gauss_jordan_elimination(A));
+  EXPECT_TRUE(analysis.row_space() == linalg::get_row_space(A));
+  EXPECT_TRUE(analysis.col_space() == linalg::get_col_space(A));
+  // [A | b] with b = last column: consistent, with one free variable
+  EXPECT_EQ(analysis.solution_type(), linalg::Solution::SolutionType::INFINITELY_MANY_SOLUTIONS);
+
+  // one null space vector per free column, all mapped to 0
+  auto& kernel = analysis.null_space();
+  ASSERT_EQ(kernel.size(), 2);
+  for (auto& x: kernel) {
+    Md product = A * Md(TwoDVector<double>{x}).transpose();
+    EXPECT_TRUE(product == Md(3, 1));
+  }
+  EXPECT_TRUE(linalg::analyze(Md{{1,2},{3,4}}).null_space().empty());
+}
+
 TEST(MatrixTest, Inverse){
   Md A {{2,-1,0}, {-1,2,-1}, {0,-1,2}};
   Md expected {{0.75,0.5,0.25}, {0.5,1,0.5}, {0.25,0.5,0.75}};
@@ -107,3 +252,490 @@ TEST(MatrixTest, Inverse){
   A = {{2,-1,0},{-1,2,-1}};
   EXPECT_THROW(linalg::inverse(A), std::runtime_error);
 }
+
+TEST(MatrixTest, ConcatMatrices) {
+  Mint A {{1,2},{3,4}};
+  Mint B {{5},{6}};
+  Mint C {{7,8}};
+  Mint horizontal {{1,2,5},{3,4,6}};
+  Mint vertical {{1,2},{3,4},{7,8}};
+  EXPECT_EQ(A.concat(B), horizontal);
+  EXPECT_EQ(A.concat(C, 1), vertical);
+  EXPECT_THROW(A.concat(C), std::runtime_error);
+}
+
+TEST(MatrixTest, ContiguousStorage) {
+  Mint A {{1,2,3},{4,5,6}};
+  EXPECT_EQ(A.stride(), 3);
+  // row r starts at data() + r * stride()
+  EXPECT_EQ(A.data()[1 * A.stride() + 2], 6);
+  A.data()[1] = 10;
+  EXPECT_EQ(A(0, 1), 10);
+}
+
+TEST(MatrixTest, MultiplyLargeMatricesBlocked) {
+  // big enough to go through the packed kernel, with ragged edges in every dimension
+  int m = 131, k = 259, n = 67;
+  Mint A_int (m, k), B_int (k, n);
+  Md A (m, k), B (k, n);
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < k; ++j) {
+      A_int(i, j) = (i * 7 + j * 3) % 11 - 5;
+      A(i, j) = A_int(i, j);
+    }
+  }
+  for (int i = 0; i < k; ++i) {
+    for (int j = 0; j < n; ++j) {
+      B_int(i, j) = (i * 5 + j * 2) % 13 - 6;
+      B(i, j) = B_int(i, j);
+    }
+  }
+  Mint expected = A_int * B_int;
+  Md result = A * B;
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) {
+      EXPECT_EQ(result(i, j), expected(i, j));
+    }
+  }
+}
+
+TEST(MatrixTest, SimdKernelsMatchScalar) {
+  using namespace linalg::simd;
+  // long enough that every unrolled loop runs many times, odd so every tail runs too
+  const std::size_t n = 4099;
+  std::mt19937_64 rng {3};
+  std::uniform_real_distribution<double> dist {-1, 1};
+  std::vector<double> x(n), y(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    x[i] = dist(rng) * std::exp2(std::floor(40 * dist(rng)));
+    y[i] = dist(rng) * std::exp2(std::floor(40 * dist(rng)));
+  }
+  auto run = [&](KernelSet set) {
+    set_kernel_set(set);
+    std::vector<double> result = y;
+    axpy(n, -0.37, x.data(), result.data());
+    scale(n, 1.3, result.data());
+    add(n, x.data(), result.data());
+    sub(n, y.data(), result.data());
+    round_below_threshold(n, result.data());
+    return std::pair{result, dot(n, x.data(), y.data())};
+  };
+  const auto [expected, expected_dot] = run(KernelSet::SCALAR);
+  // dot() reorders the sum, its error is relative to the sum of the magnitudes
+  double magnitude = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    magnitude += std::abs(x[i] * y[i]);
+  }
+  for (auto set: {KernelSet::SSE2, KernelSet::AVX2, KernelSet::AVX512}) {
+    const auto [result, result_dot] = run(set);
+    // the element-wise kernels are bit identical across kernel sets (no fma contraction)
+    int mismatches = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      mismatches += std::memcmp(&result[i], &expected[i], sizeof(double)) != 0;
+    }
+    EXPECT_EQ(mismatches, 0) << kernel_set_name(active_kernel_set());
+    EXPECT_NEAR(result_dot, expected_dot, 1e-12 * magnitude) << kernel_set_name(active_kernel_set());
+  }
+  set_kernel_set(best_kernel_set());
+  EXPECT_EQ(active_kernel_set(), best_kernel_set());
+}
+
+TEST(MatrixTest, ThreadPoolExceptions) {
+  linalg::ThreadPool pool {4};
+  // whichever thread runs a chunk first throws, the exception reaches the caller
+  for (bool static_schedule: {false, true}) {
+    EXPECT_THROW(pool.parallel_for(100, 1, [](int, int) {throw std::runtime_error("chunk failed");}, static_schedule),
+                 std::runtime_error);
+  }
+  std::atomic<int> done {0};
+  EXPECT_THROW(pool.parallel_for(100, 1, [&](int begin, int end) {
+    if (begin <= 50 && 50 < end) {
+      throw std::runtime_error("chunk failed");
+    }
+    done += end - begin;
+  }), std::runtime_error);
+  EXPECT_LT(done, 100);
+  // the pool is usable afterwards and still splits loops into chunks
+  std::atomic<int> largest {0}, total {0};
+  pool.parallel_for(100, 1, [&](int begin, int end) {
+    largest = std::max(largest.load(), end - begin);
+    total += end - begin;
+  });
+  EXPECT_EQ(total, 100);
+  EXPECT_LT(largest, 100);
+}
+
+TEST(MatrixTest, ParallelEliminationMatchesSerial) {
+  int rows = 60, cols = 71;
+  Md A (rows, cols);
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      A(i, j) = std::sin(i * 1.3 + j * 0.7) * ((i + j) % 5);
+    }
+  }
+  linalg::EliminationOptions serial {.parallel_threshold = 1L << 62};
+  Md expected_ref = linalg::gaussian_elimination(A, serial);
+  Md expected_rref = linalg::gauss_jordan_elimination(A, serial);
+
+  linalg::ThreadPool pool {4};
+  for (bool deterministic: {true, false}) {
+    linalg::EliminationOptions parallel {.parallel_threshold = 0, .pool = &pool, .deterministic = deterministic};
+    Md ref = linalg::gaussian_elimination(A, parallel);
+    Md rref = linalg::gauss_jordan_elimination(A, parallel);
+    // bitwise equality, not the tolerance based operator==
+    EXPECT_TRUE(std::equal(ref.data(), ref.data() + rows * cols, expected_ref.data()));
+    EXPECT_TRUE(std::equal(rref.data(), rref.data() + rows * cols, expected_rref.data()));
+  }
+}
+
+TEST(MatrixTest, ParallelMultiplyMatchesSerial) {
+  linalg::ThreadPool pool {4};
+  linalg::kernels::GemmOptions serial {.num_threads = 1};
+  // output tiles only (bit identical), then a small C with a long k that is split over k too
+  for (auto [m, n, k]: {std::tuple{250, 190, 300}, std::tuple{20, 30, 3000}}) {
+    Md A = filled(m, k, 0), B = filled(k, n, 0.5);
+    Md expected = linalg::multiply(A, B, serial);
+    for (int threads: {2, 3, 4}) {
+      Md C = linalg::multiply(A, B, {.num_threads = threads, .pool = &pool, .parallel_threshold = 0});
+      if (m > 100) {
+        EXPECT_TRUE(std::equal(C.data(), C.data() + m * n, expected.data()));
+      } else {
+        EXPECT_TRUE(C == expected);
+      }
+    }
+  }
+}
+
+TEST(MatrixTest, StrassenMatchesClassical) {
+  // even sizes recurse three levels, odd ones need peeling at every level
+  for (auto [m, n, k]: {std::tuple{256, 256, 256}, std::tuple{203, 157, 181}}) {
+    Md A = filled(m, k, 0), B = filled(k, n, 0.5);
+    Md expected = A * B;
+    Md C = linalg::strassen_multiply(A, B, {.crossover = 24});
+    ASSERT_EQ(C.getRows(), m);
+    ASSERT_EQ(C.getCols(), n);
+    double max_error = 0;
+    for (int i = 0; i < m; ++i) {
+      for (int j = 0; j < n; ++j) {
+        max_error = std::max(max_error, std::abs(C(i, j) - expected(i, j)));
+      }
+    }
+    // entries are bounded by 1, far below the worst case bound but above the classical one
+    EXPECT_LT(max_error, 1e-11);
+  }
+  EXPECT_THROW(linalg::strassen_multiply(Md(3, 4), Md(3, 4)), std::runtime_error);
+}
+
+TEST(MatrixTest, LazyExpressions) {
+  Mint A {{1,2},{3,4}};
+  Mint C {{5,6},{7,8}};
+  Mint D {{1,1},{2,2}};
+  auto expr = A + C - D * 2;
+#ifndef LINALG_EAGER_EXPRESSIONS
+  // nothing is computed until the expression is turned into a matrix
+  static_assert(!std::is_same_v<decltype(expr), Mint>);
+#endif
+  Mint expected {{4,6},{6,8}};
+  EXPECT_EQ(expr.eval(), expected);
+  Mint result = expr;
+  EXPECT_EQ(result, expected);
+  EXPECT_EQ(2 * (A - D), Mint({{0,2},{2,4}}));
+
+  // element-wise expressions may alias the matrix they are assigned to
+  A = A + A * 3;
+  EXPECT_EQ(A, Mint({{4,8},{12,16}}));
+  A += C - D;
+  EXPECT_EQ(A, Mint({{8,13},{17,22}}));
+
+  // products evaluate their expression operands first
+  EXPECT_EQ((C - D) * linalg::IdentityMatrix<int>(2), C - D);
+  EXPECT_THROW(A + Mint(3, 2), std::runtime_error);
+}
+
+TEST(MatrixTest, RvalueOperandsAreReused) {
+  Md A {{1,2},{3,4}};
+  Md B {{1,1},{1,1}};
+  const double* storage = A.data();
+  Md sum = std::move(A) + B;
+  EXPECT_EQ(sum.data(), storage);
+  EXPECT_EQ(sum, Md({{2,3},{4,5}}));
+
+  Md difference = B - std::move(sum);
+  EXPECT_EQ(difference.data(), storage);
+  EXPECT_EQ(difference, Md({{-1,-2},{-3,-4}}));
+
+  Md scaled = std::move(difference) * 2;
+  EXPECT_EQ(scaled.data(), storage);
+  EXPECT_EQ((B * B) + (B * B), B * 4);
+
+  Md C {{2,1,-1,8},{-3,-1,2,-11},{-2,1,2,-3}};
+  Md expected = linalg::gauss_jordan_elimination(C);
+  storage = C.data();
+  Md rref = linalg::gauss_jordan_elimination(std::move(C));
+  EXPECT_EQ(rref.data(), storage);
+  EXPECT_EQ(rref, expected);
+
+  Md D {{2,1,-1,8},{-3,-1,2,-11},{-2,1,2,-3}};
+  linalg::gaussian_elimination_inplace(D);
+  EXPECT_EQ(D, linalg::gaussian_elimination(Md({{2,1,-1,8},{-3,-1,2,-11},{-2,1,2,-3}})));
+
+  TwoDVector<double> rows {{1,2},{3,4}};
+  Md from_rows {std::move(rows)};
+  EXPECT_EQ(from_rows, Md({{1,2},{3,4}}));
+}
+
+TEST(MatrixTest, MatrixViews) {
+  Md A {{1,2,3,4},{5,6,7,8},{9,10,11,12}};
+
+  // views share storage with the matrix
+  auto block = A.block(1, 1, 2, 2);
+  EXPECT_EQ(block.data(), &A(1, 1));
+  EXPECT_EQ(block.eval(), Md({{6,7},{10,11}}));
+  EXPECT_EQ(A.row(2).eval(), Md({{9,10,11,12}}));
+  EXPECT_EQ(A.col(3).eval(), Md({{4},{8},{12}}));
+  EXPECT_EQ(A.col(3).flatten(), std::vector<double>({4,8,12}));
+  EXPECT_EQ(A.view().transpose().eval(), A.transpose());
+  EXPECT_EQ(block.transpose()(0, 1), 10);
+  EXPECT_THROW(A.block(2, 0, 2, 2), std::runtime_error);
+
+  // arithmetic and concat accept views
+  Md sum = A.block(0, 0, 2, 2) + A.block(1, 2, 2, 2);
+  EXPECT_EQ(sum, Md({{8,10},{16,18}}));
+  EXPECT_EQ(A.block(0, 0, 2, 2).eval().concat(A.col(0).block(0, 0, 2, 1)), Md({{1,2,1},{5,6,5}}));
+  EXPECT_EQ(Md({{0,0,0,0}}).concat(A.row(1), 1), Md({{0,0,0,0},{5,6,7,8}}));
+
+  // in place updates notice views that read the destination at other positions
+  Md E {{1,2},{3,4}};
+  E = E + E.view().transpose();
+  EXPECT_EQ(E, Md({{2,5},{5,8}}));
+  E -= E.view().transpose() * 2;
+  EXPECT_EQ(E, Md({{-2,-5},{-5,-8}}));
+  Md D {{1,2},{3,4}};
+  EXPECT_EQ(D.view().transpose() - std::move(D), Md({{0,1},{-1,0}}));
+  Md F {{1,2},{3,4}};
+  EXPECT_EQ(std::move(F) + F.view().transpose(), Md({{2,5},{5,8}}));
+  F = Md({{1,2},{3,4}});
+  F.view().assign(F.view().transpose());
+  EXPECT_EQ(F, Md({{1,3},{2,4}}));
+
+  // writing through a view
+  A.col(0).assign(A.col(0) * 2);
+  EXPECT_EQ(A.col(0).eval(), Md({{2},{10},{18}}));
+
+  // elimination of part of a matrix leaves the rest alone
+  Md B {{2,1,-1,8,7},{-3,-1,2,-11,7},{-2,1,2,-3,7}};
+  Md expected = linalg::gauss_jordan_elimination(Md({{2,1,-1,8},{-3,-1,2,-11},{-2,1,2,-3}}));
+  EXPECT_EQ(linalg::gauss_jordan_elimination(B.block(0, 0, 3, 4)), expected);
+  linalg::gauss_jordan_elimination_inplace(B.block(0, 0, 3, 4));
+  EXPECT_EQ(B.block(0, 0, 3, 4).eval(), expected);
+  EXPECT_EQ(B.col(4).eval(), Md({{7},{7},{7}}));
+
+  // non-contiguous rows go through a copy
+  Md C {{2,-3,-2},{1,-1,1},{-1,2,2},{8,-11,-3}};
+  linalg::gauss_jordan_elimination_inplace(C.view().transpose());
+  EXPECT_EQ(C.transpose(), expected);
+}
+
+TEST(MatrixTest, SparseMatrix) {
+  Md A {{1,0,0,2},{0,0,3,0},{0,4,0,0}};
+  linalg::SparseMatrix<double> S {A};
+  EXPECT_EQ(S.nonZeros(), 4);
+  EXPECT_EQ(S.row_offsets(), std::vector<int>({0,2,3,4}));
+  EXPECT_EQ(S.col_indices(), std::vector<int>({0,3,2,1}));
+  EXPECT_EQ(S(1, 2), 3);
+  EXPECT_EQ(S(1, 1), 0);
+  EXPECT_EQ(S.to_dense(), A);
+  EXPECT_EQ(S.transpose().to_dense(), A.transpose());
+
+  // triplets are summed, cancelled entries dropped
+  linalg::SparseMatrix<double> T {3, 4, {{2,1,4}, {0,3,1}, {1,2,3}, {0,0,1}, {0,3,1}, {1,1,1}, {1,1,-1}}};
+  EXPECT_EQ(T.to_dense(), A);
+  EXPECT_EQ(T.nonZeros(), 4);
+
+  Md B {{1,2},{3,4},{5,6},{7,8}};
+  EXPECT_EQ(S * B, A * B);
+  EXPECT_EQ(B.transpose() * S.transpose(), B.transpose() * A.transpose());
+  EXPECT_EQ((S * linalg::SparseMatrix<double>(B)).to_dense(), A * B);
+  EXPECT_EQ(S * std::vector<double>({1,1,1,1}), std::vector<double>({3,3,4}));
+  EXPECT_THROW(S * A, std::runtime_error);
+}
+
+template <class A, class B>
+concept Addable = requires(A a, B b) {a + b;};
+
+template <class A, class B>
+concept Multipliable = requires(A a, B b) {a * b;};
+
+TEST(MatrixTest, FixedMatrix) {
+  using linalg::FixedMatrix;
+  typedef FixedMatrix<double, 3, 3> M3;
+  typedef FixedMatrix<double, 3, 1> V3;
+
+  // sizes are part of the type
+  static_assert(Multipliable<M3, V3>);
+  static_assert(!Multipliable<V3, M3>);
+  static_assert(!Addable<M3, V3>);
+  static_assert(sizeof(M3) == 9 * sizeof(double));
+  static_assert(linalg::determinant(FixedMatrix<int, 2, 2>({{1, 2}, {3, 4}})) == -2);
+
+  M3 A ({{2,1,-1},{-3,-1,2},{-2,1,2}});
+  V3 b ({{8},{-11},{-3}});
+  EXPECT_EQ(linalg::solve(A, b), V3({{2},{3},{-1}}));
+  EXPECT_EQ(A * linalg::inverse(A), M3::identity());
+  EXPECT_NEAR(linalg::determinant(A), -1, 1e-12);
+  EXPECT_EQ((A + A - A) * 2, 2 * A);
+  EXPECT_EQ(A.transpose().transpose(), A);
+
+  // larger sizes go through elimination
+  FixedMatrix<double, 4, 4> a ({{1,0,0,0},{1,1,1,1},{1,3,9,27},{1,4,16,64}});
+  EXPECT_NEAR(linalg::determinant(a), 72, 1e-9);
+  EXPECT_EQ(a * linalg::inverse(a), (FixedMatrix<double, 4, 4>::identity()));
+  EXPECT_THROW(linalg::inverse(M3({{1,2,3},{2,4,6},{0,0,1}})), std::runtime_error);
+  // singularity is judged per pivot like inverse(Matrix), not by the (scale dependent) determinant
+  M3 small ({{1e-4,0,0},{0,1e-4,0},{0,0,1e-4}});
+  EXPECT_EQ(linalg::inverse(small), M3({{1e4,0,0},{0,1e4,0},{0,0,1e4}}));
+  EXPECT_EQ(Md(linalg::inverse(small)), linalg::inverse(Md(small)));
+  EXPECT_EQ(linalg::inverse(FixedMatrix<double, 2, 2>({{1e-4,0},{0,1e-4}}))(1, 1), 1e4);
+
+  // interoperates with Matrix
+  Md dense = A;
+  EXPECT_EQ(dense, Md({{2,1,-1},{-3,-1,2},{-2,1,2}}));
+  EXPECT_EQ(M3(dense), A);
+  EXPECT_EQ(linalg::gaussian_elimination(A), linalg::gaussian_elimination(dense));
+  EXPECT_EQ(linalg::solve_linear_system(A, b).toString(), "x1: 2, x2: 3, x3: -1");
+  EXPECT_THROW(V3 {dense}, std::runtime_error);
+}
+
+TEST(MatrixTest, BinaryFiles) {
+  // published XXH64 values, and the same hash when fed in pieces
+  EXPECT_EQ(linalg::checksum("", 0), 0xEF46DB3751D8E999ULL);
+  EXPECT_EQ(linalg::checksum("abc", 3), 0x44BC2CF5AD770999ULL);
+  std::vector<unsigned char> bytes (1000);
+  for (std::size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = static_cast<unsigned char>(i * 31 + 7);
+  }
+  linalg::Checksum pieces;
+  for (std::size_t i = 0, step = 1; i < bytes.size(); i += step, step = step % 40 + 3) {
+    pieces.update(bytes.data() + i, std::min(step, bytes.size() - i));
+  }
+  EXPECT_EQ(pieces.value(), linalg::checksum(bytes.data(), bytes.size()));
+
+  const std::string path = (std::filesystem::temp_directory_path() / "linalg_binary_test.mat").string();
+  Md A (37, 23);
+  for (int i = 0; i < 37; ++i) {
+    for (int j = 0; j < 23; ++j) {
+      A(i, j) = i * 0.5 - j / 3.0;
+    }
+  }
+  for (auto layout: {linalg::Layout::ROW_MAJOR, linalg::Layout::COL_MAJOR}) {
+    linalg::save_binary(A, path, {.layout = layout, .alignment = 4096});
+    EXPECT_EQ(std::filesystem::file_size(path), 4096 + 37 * 23 * sizeof(double));
+    linalg::MappedMatrix<double> mapped (path, true);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(mapped.data()) % 4096, 0);
+    EXPECT_TRUE(std::equal(A.data(), A.data() + 37 * 23, mapped.view().flatten().begin()));
+    EXPECT_TRUE(std::equal(A.data(), A.data() + 37 * 23, linalg::load_binary<double>(path).data()));
+  }
+  // views and other element types
+  Mint B {{1, 2, 3}, {4, 5, 6}};
+  linalg::save_binary(B.col(1), path);
+  EXPECT_EQ(linalg::load_binary<int>(path), Mint({{2}, {5}}));
+  EXPECT_THROW(linalg::MappedMatrix<double> {path}, std::runtime_error);
+
+  // a flipped element is caught by the checksum, a flipped header field right away
+  auto flip = [&](std::size_t offset) {
+    std::fstream file (path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg(offset);
+    char c = file.get();
+    file.seekp(offset);
+    file.put(static_cast<char>(c ^ 1));
+  };
+  linalg::save_binary(A, path);
+  flip(64 + 100);
+  linalg::MappedMatrix<double> corrupted (path);
+  EXPECT_FALSE(corrupted.verify());
+  EXPECT_THROW(linalg::load_binary<double>(path), std::runtime_error);
+  flip(64 + 100);
+  flip(16);
+  EXPECT_THROW(linalg::MappedMatrix<double> {path}, std::runtime_error);
+
+  // a consistent header whose rows * cols * 8 wraps around to the 64 bytes of data in the file
+  Md C (1, 8);
+  linalg::save_binary(C, path);
+  {
+    std::fstream file (path, std::ios::in | std::ios::out | std::ios::binary);
+    linalg::BinaryHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    header.rows = 1073807362;
+    header.cols = 2147352580;
+    header.header_checksum = linalg::checksum(&header, offsetof(linalg::BinaryHeader, header_checksum));
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  }
+  EXPECT_THROW(linalg::MappedMatrix<double> {path}, std::runtime_error);
+  std::filesystem::resize_file(path, 32);
+  EXPECT_THROW(linalg::MappedMatrix<double> {path}, std::runtime_error);
+  std::filesystem::remove(path);
+}
+
+TEST(MatrixTest, ArenaMatrices) {
+  using linalg::pmr::Matrix;
+  linalg::MonotonicArena arena;
+  Matrix<double> A ({{2,1,-1},{-3,-1,2},{-2,1,2}}, &arena);
+  Matrix<double> B (3, 3, 1, &arena);
+  Md a ({{2,1,-1},{-3,-1,2},{-2,1,2}}), b (3, 3, 1);
+
+  // everything computed from arena matrices lives in the arena. with the default resource
+  // refusing every allocation, anything that fell back to it would throw bad_alloc
+  struct DefaultResource {
+    std::pmr::memory_resource* previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+    ~DefaultResource() {std::pmr::set_default_resource(previous);}
+  };
+  std::optional<DefaultResource> guard {std::in_place};
+  Matrix<double> sum = A + B * 2;
+  Matrix<double> scaled = A * 2;
+  Matrix<double> added {A + B};
+  auto mixed = (A + B) * A;
+  auto copy = A;
+  auto product = A * B;
+  auto transposed = A.transpose();
+  auto joined = A.concat(B, 1);
+  auto ref = linalg::gaussian_elimination(A);
+  auto inv = linalg::inverse(A);
+  for (auto* m: {&sum, &scaled, &added, &mixed, &copy, &product, &transposed, &joined, &ref, &inv}) {
+    EXPECT_EQ(m->get_allocator().resource(), &arena);
+  }
+  guard.reset();
+  EXPECT_TRUE(scaled.flatten() == Md(a * 2).flatten());
+  EXPECT_TRUE(added.flatten() == Md(a + b).flatten());
+  EXPECT_TRUE(mixed.flatten() == ((a + b) * a).flatten());
+  EXPECT_TRUE(copy.flatten() == a.flatten());
+  EXPECT_TRUE(sum.flatten() == Md(a + b * 2).flatten());
+  EXPECT_TRUE(product.flatten() == (a * b).flatten());
+  EXPECT_TRUE(transposed.flatten() == a.transpose().flatten());
+  EXPECT_TRUE(joined.flatten() == a.concat(b, 1).flatten());
+  EXPECT_TRUE(ref.flatten() == linalg::gaussian_elimination(a).flatten());
+  EXPECT_TRUE(inv.flatten() == linalg::inverse(a).flatten());
+  EXPECT_TRUE((A * inv).flatten() == linalg::IdentityMatrix<double>(3).flatten());
+  EXPECT_THROW(linalg::inverse(Matrix<double>({{1,2},{2,4}}, &arena)), std::runtime_error);
+  EXPECT_GT(arena.bytes_allocated(), 0u);
+
+  // release drops everything but keeps the largest block for the next round
+  std::size_t reserved = arena.bytes_reserved();
+  arena.release();
+  EXPECT_EQ(arena.bytes_allocated(), 0u);
+  EXPECT_LE(arena.bytes_reserved(), reserved);
+
+  // a pool reuses freed pieces: after the first round no more memory is taken
+  linalg::PoolArena pool;
+  auto round = [&pool]() {
+    Matrix<double> C (20, 20, 1, &pool);
+    Matrix<double> D = linalg::gauss_jordan_elimination(C * C + C);
+    return D.getRows();
+  };
+  round();
+  reserved = pool.bytes_reserved();
+  for (int i = 0; i < 10; ++i) {
+    round();
+  }
+  EXPECT_EQ(pool.bytes_reserved(), reserved);
+}